@@ -0,0 +1,444 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+/* Documentation for this app is available online.
+ * See https://docs.zentri.com/wifi/sdk/latest/examples/cloud/bluemix
+ */
+
+/*
+ * The sensor readings can be viewed in real-time on the IBM Watson IoT
+ * Platform at https://quickstart.internetofthings.ibmcloud.com
+ */
+
+#include "zos.h"
+#include "platform_common.h"
+#include "common.h"
+#include "sensor.h"
+#include "accelerometer.h"
+#include "gyroscope.h"
+#include "magnetometer.h"
+
+/** @file
+ *
+ * IBM Bluemix Example App using the MQTT protocol
+ *
+ * The application connects to the Bluemix Quickstart broker:
+ * quickstart.messaging.internetofthings.ibmcloud.com
+ *
+ * The following sensors are sampled at the accelerometer's 50Hz output
+ * data rate into a ring buffer (see sampler.c):
+ *   - Accelerometer
+ *   - Magnetometer
+ *   - Gyroscope
+ *
+ * The samples are published in batches, one message per MQTT_BATCH_SAMPLES
+ * samples, delta encoded as JSON or CBOR (see telemetry.c) together with the
+ * RSSI and light sense readings. publisher.c keeps up to MQTT_WINDOW messages
+ * in flight, reconnects to the broker whenever the connection drops and keeps
+ * the readings in a flash queue while it is down.
+ *
+ * The sensor readings can be viewed in real-time on the IBM Watson IoT
+ * Platform at https://quickstart.internetofthings.ibmcloud.com
+ *
+ * The Device ID is zentri_XXXX where XXXX is the least significant
+ * 4 bytes of the WLAN MAC address. The ID is printed to a ZentriOS terminal.
+ *
+ * NOTE:
+ *   The ZAP may not work with a debug build if TLS is enabled on platforms
+ *   with memory footprints less than 128kB
+ *
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+const accelerometer_config_t const accel_config =
+{
+    .fullscale = ACCEL_FULLSCALE_2G,
+    .samp_freq = ACCEL_SAMP_FREQ_50HZ,
+    .axis_en = ACCEL_AXIS_EN_X | ACCEL_AXIS_EN_Y | ACCEL_AXIS_EN_Z,
+    .mode = ACCEL_MODE_NORMAL
+};
+
+const gyroscope_config_t const gyro_config =
+{
+    .fullscale = GYRO_FULLSCALE_250DPS,
+    .axis_en = GYRO_AXIS_EN_X | GYRO_AXIS_EN_Y | GYRO_AXIS_EN_Z,
+};
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static zos_result_t mqtt_connection_event_cb( mqtt_event_info_t *event );
+static zos_result_t connect_broker( void );
+static void disconnect_broker( void );
+static uint16_t publish_message( const uint8_t *data, uint32_t length );
+static uint16_t encode_batch( uint8_t *buffer, uint32_t size, uint32_t *length, uint16_t first, uint16_t count );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+mqtt_settings_t settings;
+mqtt_connection_t* mqtt_connection;
+static mqtt_callback_t callback = mqtt_connection_event_cb;
+
+static const publisher_config_t publisher_config =
+{
+    .window = MQTT_WINDOW,
+    .batch_samples = MQTT_BATCH_SAMPLES,
+    .buffer = settings.message,
+    .buffer_size = sizeof(settings.message),
+    .connect = connect_broker,
+    .disconnect = disconnect_broker,
+    .publish = publish_message,
+    .encode = encode_batch,
+};
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+void zn_app_init(void)
+{
+	ZOS_LOG("\r\n");
+	ZOS_LOG("----------------------");
+	ZOS_LOG("Starting Lab 2 Demo...");
+	ZOS_LOG("----------------------");
+
+    zos_result_t result;
+    char mac_str[32] = {0};
+
+    /* Get device MAC address */
+    zn_network_get_mac(mac_str);
+
+    /* Bring up the network interface */
+    if (!zn_network_is_up(ZOS_WLAN))
+    {
+        ZOS_LOG("Network is down, restarting...");
+        if(ZOS_FAILED(result, zn_network_restart(ZOS_WLAN)))
+        {
+            ZOS_LOG("Failed to restart network: %d\r\n\r\n", result);
+            ZOS_LOG("----------------------------------------------------------------------");
+            ZOS_LOG("This app expects valid network credentials have been configured.      ");
+            ZOS_LOG("Join a network and save credentials to non-volatile memory using the  ");
+            ZOS_LOG("ZentriOS commands shown below                                         ");
+            ZOS_LOG("                                                                      ");
+            ZOS_LOG("> network_up -s                                                       ");
+            ZOS_LOG("> save                                                                ");
+            ZOS_LOG("----------------------------------------------------------------------");
+            ZOS_LOG("\r\n                                                                  ");
+            return;
+        }
+    }
+
+    /* Initialize ADC for the light sensor, its lookup table is compiled in (see light.c) */
+    light_init();
+
+    ZOS_LOG("\r\n");
+    if (sensor_init(SENSOR_ACCELEROMETER, (void*)&accel_config) != ZOS_SUCCESS)
+    {
+        ZOS_LOG("ERROR - Failed to initialize accelerometer!");
+    }
+    else
+    {
+        ZOS_LOG("Accelerometer initialized successfully!");
+    }
+
+    if (sensor_init(SENSOR_MAGNETOMETER, (void*)NULL) != ZOS_SUCCESS)
+    {
+        ZOS_LOG("ERROR - Failed to initialize magnetometer!");
+    }
+    else
+    {
+        ZOS_LOG("Magnetometer initialized successfully!");
+    }
+
+    if (sensor_init(SENSOR_GYROSCOPE, (void*)&gyro_config) != ZOS_SUCCESS)
+    {
+        ZOS_LOG("ERROR - Failed to initialize gyroscope!");
+    }
+    else
+    {
+        ZOS_LOG("Gyroscope Initialized successfully!");
+    }
+
+    if (ZOS_FAILED(result, sampler_start()))
+    {
+        ZOS_LOG("ERROR - Failed to start sensor sampling! Error code %d", result);
+    }
+
+    /* MQTT settings */
+    strcpy((char*)settings.host, MQTT_HOST);
+    strcpy((char*)settings.topic, MQTT_TOPIC);
+    sprintf((char*)settings.client, MQTT_CLIENT_ID, mac_str[12], mac_str[13], mac_str[15], mac_str[16]);
+    strcpy((char*)settings.user, MQTT_USER);
+    strcpy((char*)settings.password, MQTT_PASSWORD);
+    settings.port = MQTT_PORT;
+    settings.keepalive = MQTT_KEEPALIVE;
+    settings.qos = MQTT_QOS;
+    settings.security = MQTT_SECURITY;
+
+    /* Memory allocated for MQTT object*/
+    zn_malloc((uint8_t**)&mqtt_connection, sizeof(mqtt_connection_t));
+    if ( mqtt_connection == NULL )
+    {
+        ZOS_LOG("Failed to allocate MQTT object...\n");
+        return;
+    }
+
+    /* Initialize MQTT library */
+    result = mqtt_init( mqtt_connection );
+    if(result != ZOS_SUCCESS)
+    {
+        ZOS_LOG("Error initializing");
+        zn_free(mqtt_connection);
+        mqtt_connection = NULL;
+        return;
+    }
+
+    ZOS_LOG("\r\nIBM Bluemix MQTT Demo Application Started");
+    ZOS_LOG("  - Broker      : %s",     settings.host);
+    ZOS_LOG("  - Topic/Queue : %s",     settings.topic);
+    ZOS_LOG("  - Client ID   : %s\r\n", settings.client);
+
+    ZOS_LOG("Website  : https://quickstart.internetofthings.ibmcloud.com");
+    ZOS_LOG("Device ID: "DEVICE_ID"\r\n", mac_str[12], mac_str[13], mac_str[15], mac_str[16]);
+
+    /* Connect to IBM Bluemix broker, and stay connected */
+    if (ZOS_FAILED(result, publisher_start(&publisher_config)))
+    {
+        ZOS_LOG("Failed to start publishing! Error code %d", result);
+    }
+}
+
+
+/*************************************************************************************************/
+void zn_app_deinit(void)
+{
+    publisher_stop();
+    sampler_stop();
+
+    /* Free MQTT object and deinit library */
+    mqtt_deinit( mqtt_connection );
+    zn_free(mqtt_connection);
+    mqtt_connection = NULL;
+}
+
+/*************************************************************************************************/
+/*
+ * Connect to broker (sent connect frame)
+ */
+void mqtt_app_connect( void *arg )
+{
+    connect_broker();
+}
+
+/*************************************************************************************************/
+/*
+ * Disconnect from broker (sent disconnect frame)
+ */
+void mqtt_app_disconnect( void *arg )
+{
+    if ( mqtt_disconnect( mqtt_connection ) != ZOS_SUCCESS )
+    {
+        ZOS_LOG("Error disconnecting");
+    }
+}
+
+/*************************************************************************************************/
+/*
+ * Subscribe to topic
+ */
+void mqtt_app_subscribe( void *arg )
+{
+    mqtt_msgid_t pktid;
+    ZOS_LOG("Subscribing to topic '%s'", settings.topic);
+    pktid = mqtt_subscribe( mqtt_connection, settings.topic, settings.qos );
+    if ( pktid == 0 )
+    {
+        ZOS_LOG("Error subscribing: packet ID = 0");
+    }
+}
+
+/*************************************************************************************************/
+/*
+ * Unsubscribe from topic
+ */
+void mqtt_app_unsubscribe( void *arg )
+{
+    mqtt_msgid_t pktid;
+    ZOS_LOG("Unsubscribing from topic '%s'", settings.topic);
+    pktid = mqtt_unsubscribe( mqtt_connection, settings.topic );
+
+    if ( pktid == 0 )
+    {
+        ZOS_LOG("Error unsubscribing: packet ID = 0");
+    }
+}
+
+/*************************************************************************************************/
+/*
+ * Publish (send) message to topic
+ */
+void mqtt_app_publish( void *arg )
+{
+    mqtt_msgid_t pktid;
+    //ZOS_LOG("Publishing to topic: '%s', message: '%s'", settings.topic, settings.message);
+    pktid = mqtt_publish( mqtt_connection, settings.topic, settings.message, (uint32_t)strlen((char*)settings.message), settings.qos );
+
+    if ( pktid == 0 )
+    {
+        ZOS_LOG("Error publishing: packet ID = 0");
+    }
+}
+
+/******************************************************
+ *               Static Function Definitions
+ ******************************************************/
+/*
+ * Call back function to handle connection events.
+ */
+static zos_result_t mqtt_connection_event_cb( mqtt_event_info_t *event )
+{
+    switch ( event->type )
+    {
+        case MQTT_EVENT_TYPE_CONNECTED:
+            ZOS_LOG("CONNECTED" );
+
+            ZOS_LOG("Publishing sensor readings to IBM Bluemix broker..." );
+
+            /* once connected, the publisher sends whatever is waiting, queued readings first */
+            publisher_connected();
+            break;
+        case MQTT_EVENT_TYPE_DISCONNECTED:
+            ZOS_LOG("DISCONNECTED" );
+
+            /* the publisher reconnects after a back off, readings are queued meanwhile */
+            publisher_disconnected();
+            break;
+        case MQTT_EVENT_TYPE_PUBLISHED:
+            //ZOS_LOG("MESSAGE PUBLISHED" );
+
+            /* releases the message's readings and frees its place in the window */
+            publisher_acked(event->data.msgid);
+            break;
+        case MQTT_EVENT_TYPE_SUBCRIBED:
+            ZOS_LOG("TOPIC SUBSCRIBED" );
+            break;
+        case MQTT_EVENT_TYPE_UNSUBSCRIBED:
+            ZOS_LOG("TOPIC UNSUBSCRIBED" );
+            break;
+        case MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED:
+        {
+            ZOS_LOG("MESSAGE RECEIVED");
+        }
+            break;
+        default:
+            break;
+    }
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************
+ * Open the connection with the broker and send the CONNECT frame. The outcome is reported
+ * by the connection callback.
+ */
+static zos_result_t connect_broker( void )
+{
+    mqtt_pkt_connect_t conninfo;
+    zos_result_t ret = ZOS_SUCCESS;
+
+    /* The WLAN may have gone down with the broker connection */
+    if (!zn_network_is_up(ZOS_WLAN) && ZOS_FAILED(ret, zn_network_restart(ZOS_WLAN)))
+    {
+        ZOS_LOG("Failed to restart network: %d", ret);
+        return ret;
+    }
+
+    ZOS_LOG("Opening connection with broker %s:%u", settings.host, settings.port);
+    ret = mqtt_open( mqtt_connection, (const char*)settings.host, settings.port, ZOS_WLAN, callback, settings.security );
+    if ( ret != ZOS_SUCCESS )
+    {
+        ZOS_LOG("Error opening connection (keys and certificates are set properly?)");
+        return ret;
+    }
+
+    ZOS_LOG("Connection established");
+
+    /* Now, after socket is connected we can send the CONNECT frame safely */
+    ZOS_LOG("Connecting...");
+    memset( &conninfo, 0, sizeof( conninfo ) );
+
+    conninfo.mqtt_version = MQTT_PROTOCOL_VER4;
+    conninfo.clean_session = 1;
+    conninfo.client_id = settings.client;
+    conninfo.keep_alive = settings.keepalive;
+    conninfo.password = strlen((char*)settings.password) > 0 ? settings.password : NULL;
+    conninfo.username = strlen((char*)settings.user) > 0 ? settings.user : NULL;
+    ret = mqtt_connect( mqtt_connection, &conninfo );
+    if ( ret != ZOS_SUCCESS )
+    {
+        ZOS_LOG("Error connecting");
+    }
+
+    return ret;
+}
+
+/*************************************************************************************************/
+static void disconnect_broker( void )
+{
+    mqtt_app_disconnect(NULL);
+}
+
+/*************************************************************************************************/
+static uint16_t publish_message( const uint8_t *data, uint32_t length )
+{
+    mqtt_msgid_t pktid = mqtt_publish( mqtt_connection, settings.topic, (uint8_t*)data, length, settings.qos );
+
+    if ( pktid == 0 )
+    {
+        ZOS_LOG("Error publishing: packet ID = 0");
+    }
+
+    return pktid;
+}
+
+/*************************************************************************************************
+ * Encode a batch of the sampled sensor readings, with the current RSSI and light level
+ */
+static uint16_t encode_batch( uint8_t *buffer, uint32_t size, uint32_t *length, uint16_t first, uint16_t count )
+{
+    char rssi_buffer[16];
+    uint32_t bytes_read;
+    zos_result_t result;
+    light_reading_t light;
+
+    zn_issue_command_return_data(rssi_buffer, sizeof(rssi_buffer), &bytes_read, "wlan_get_rssi");
+    rssi_buffer[bytes_read] = 0;
+
+    if (ZOS_FAILED(result, light_read(&light)))
+    {
+        ZOS_LOG("Failed to read converted ADC sample! Error code %d", result);
+    }
+
+    return telemetry_encode(MQTT_FORMAT, buffer, size, length, first, count, rssi_buffer, (result == ZOS_SUCCESS) ? &light : NULL);
+}
@@ -0,0 +1,276 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+
+/** @file
+ *
+ * Bounded store-and-forward queue of MQTT messages in the file system.
+ *
+ * Each message is one file in a fixed set of FLASH_QUEUE_SLOTS slots, starting with a
+ * small header that holds its sequence number. The slot table (sequence numbers only) is
+ * kept in RAM and rebuilt from the headers at start up, so messages queued before a reset
+ * are still sent, oldest first. When every slot is used the oldest message is deleted to
+ * make room, so the queue always holds the most recent FLASH_QUEUE_SLOTS messages.
+ *
+ * Slots are handed out round robin rather than lowest free first, which spreads the file
+ * writes over the whole set.
+ *
+ */
+
+#include "zos.h"
+#include "flash_queue.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define FLASH_QUEUE_MAGIC           0x3151514DUL    // "MQQ1"
+#define FLASH_QUEUE_HEADER_SIZE     12              // magic, sequence number, payload length
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static uint32_t sequences[FLASH_QUEUE_SLOTS];       // 0 for a free slot
+static uint32_t next_sequence;
+static uint8_t next_slot;
+static flash_queue_stats_t stats;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+void flash_queue_init(void)
+{
+    memset(sequences, 0, sizeof(sequences));
+    memset(&stats, 0, sizeof(stats));
+    next_sequence = 1;
+    next_slot = 0;
+
+    for(uint8_t slot = 0; slot < FLASH_QUEUE_SLOTS; ++slot)
+    {
+        uint8_t header[FLASH_QUEUE_HEADER_SIZE];
+        uint32_t handle;
+        uint32_t bytes_read;
+        char name[16];
+
+        get_filename(slot, name);
+        if(zn_file_open(name, &handle) != ZOS_SUCCESS)
+        {
+            continue;
+        }
+        if(zn_file_read(handle, header, sizeof(header), &bytes_read) == ZOS_SUCCESS &&
+           bytes_read == sizeof(header) && get_uint32(&header[0]) == FLASH_QUEUE_MAGIC)
+        {
+            sequences[slot] = get_uint32(&header[4]);
+            ++stats.count;
+            if(sequences[slot] >= next_sequence)
+            {
+                next_sequence = sequences[slot] + 1;
+                next_slot = (slot + 1) % FLASH_QUEUE_SLOTS;
+            }
+        }
+        zn_file_close(handle);
+
+        if(sequences[slot] == 0)
+        {
+            // Left over from a write that never completed
+            zn_file_delete(name);
+        }
+    }
+}
+
+/*************************************************************************************************/
+/*
+ * Append a message, dropping the oldest one when the queue is full. 'slot', when not NULL,
+ * receives the slot it was written to.
+ */
+zos_result_t flash_queue_push(const uint8_t *data, uint32_t length, uint8_t *slot)
+{
+    zos_result_t result;
+    uint32_t handle;
+    uint8_t header[FLASH_QUEUE_HEADER_SIZE];
+    zos_file_t file =
+    {
+        .size = FLASH_QUEUE_HEADER_SIZE + length,
+        .type = ZOS_FILE_TYPE_MISC,
+    };
+
+    if(stats.count == FLASH_QUEUE_SLOTS)
+    {
+        flash_queue_remove(find_slot(0));
+        ++stats.dropped;
+    }
+
+    // The next slot round robin that is free, there is at least one
+    while(sequences[next_slot] != 0)
+    {
+        next_slot = (next_slot + 1) % FLASH_QUEUE_SLOTS;
+    }
+
+    put_uint32(&header[0], FLASH_QUEUE_MAGIC);
+    put_uint32(&header[4], next_sequence);
+    put_uint32(&header[8], length);
+    get_filename(next_slot, file.name);
+    zn_file_delete(file.name);
+
+    if(ZOS_FAILED(result, zn_file_create(&file, &handle)))
+    {
+        ++stats.errors;
+        return result;
+    }
+    else if(!ZOS_FAILED(result, zn_file_write(handle, header, sizeof(header))))
+    {
+        result = zn_file_write(handle, data, length);
+    }
+    zn_file_close(handle);
+
+    if(result != ZOS_SUCCESS)
+    {
+        ++stats.errors;
+        zn_file_delete(file.name);
+        return result;
+    }
+
+    if(slot != NULL)
+    {
+        *slot = next_slot;
+    }
+    sequences[next_slot] = next_sequence++;
+    next_slot = (next_slot + 1) % FLASH_QUEUE_SLOTS;
+    ++stats.count;
+    ++stats.pushed;
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*
+ * Read the message 'index' places from the oldest one. The returned slot identifies it to
+ * flash_queue_remove() once it has been delivered.
+ */
+zos_result_t flash_queue_read(uint8_t index, uint8_t *buffer, uint32_t size, uint32_t *length, uint8_t *slot)
+{
+    zos_result_t result;
+    uint8_t header[FLASH_QUEUE_HEADER_SIZE];
+    uint32_t handle;
+    uint32_t bytes_read;
+    char name[16];
+
+    if(index >= stats.count)
+    {
+        return ZOS_NOT_FOUND;
+    }
+
+    *slot = find_slot(index);
+    get_filename(*slot, name);
+
+    if(ZOS_FAILED(result, zn_file_open(name, &handle)))
+    {
+        ++stats.errors;
+        return result;
+    }
+
+    if(ZOS_FAILED(result, zn_file_read(handle, header, sizeof(header), &bytes_read)))
+    {
+    }
+    else if(bytes_read != sizeof(header) || (*length = get_uint32(&header[8])) > size)
+    {
+        result = ZOS_BUFFER_OVERFLOW;
+    }
+    else if(!ZOS_FAILED(result, zn_file_read(handle, buffer, *length, &bytes_read)) && bytes_read != *length)
+    {
+        result = ZOS_ERROR;
+    }
+    zn_file_close(handle);
+
+    if(result != ZOS_SUCCESS)
+    {
+        // An unreadable message would block the queue forever
+        ++stats.errors;
+        flash_queue_remove(*slot);
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+void flash_queue_remove(uint8_t slot)
+{
+    char name[16];
+
+    if(slot >= FLASH_QUEUE_SLOTS || sequences[slot] == 0)
+    {
+        return;
+    }
+
+    get_filename(slot, name);
+    zn_file_delete(name);
+    sequences[slot] = 0;
+    --stats.count;
+}
+
+/*************************************************************************************************/
+uint8_t flash_queue_count(void)
+{
+    return stats.count;
+}
+
+/*************************************************************************************************/
+const flash_queue_stats_t* flash_queue_get_stats(void)
+{
+    return &stats;
+}
+
+/******************************************************
+ *               Static Function Definitions
+ ******************************************************/
+/*
+ * Slot of the message 'index' places from the oldest one. The queue is at most a few dozen
+ * entries, so a scan beats keeping it sorted.
+ */
+static uint8_t find_slot(uint8_t index)
+{
+    uint32_t floor = 0;
+    uint8_t found = 0;
+
+    for(uint8_t i = 0; i <= index; ++i)
+    {
+        uint32_t lowest = UINT32_MAX;
+
+        for(uint8_t slot = 0; slot < FLASH_QUEUE_SLOTS; ++slot)
+        {
+            if(sequences[slot] > floor && sequences[slot] < lowest)
+            {
+                lowest = sequences[slot];
+                found = slot;
+            }
+        }
+        floor = lowest;
+    }
+
+    return found;
+}
+
+/*************************************************************************************************/
+static void get_filename(uint8_t slot, char *name)
+{
+    sprintf(name, FLASH_QUEUE_FILENAME, slot);
+}
+
+/*************************************************************************************************/
+static uint32_t get_uint32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/*************************************************************************************************/
+static void put_uint32(uint8_t *data, uint32_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
@@ -0,0 +1,39 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+#pragma once
+
+
+#include "zos.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define FLASH_QUEUE_SLOTS           60      // messages kept, a minute of batches at one a second
+#define FLASH_QUEUE_FILENAME        "mqtt_q%02u.bin"
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    uint8_t count;                          // messages queued
+    uint32_t pushed;
+    uint32_t dropped;                       // oldest messages deleted to make room
+    uint32_t errors;                        // failed file operations
+} flash_queue_stats_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+void flash_queue_init(void);
+zos_result_t flash_queue_push(const uint8_t *data, uint32_t length, uint8_t *slot);
+zos_result_t flash_queue_read(uint8_t index, uint8_t *buffer, uint32_t size, uint32_t *length, uint8_t *slot);
+void flash_queue_remove(uint8_t slot);
+uint8_t flash_queue_count(void);
+const flash_queue_stats_t* flash_queue_get_stats(void);
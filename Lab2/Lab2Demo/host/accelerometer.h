@@ -0,0 +1,29 @@
+/*
+ * Host stand-in for the SDK's accelerometer driver interface.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+#define ACCEL_FULLSCALE_2G          0
+#define ACCEL_SAMP_FREQ_50HZ        4
+#define ACCEL_AXIS_EN_X             (1 << 0)
+#define ACCEL_AXIS_EN_Y             (1 << 1)
+#define ACCEL_AXIS_EN_Z             (1 << 2)
+#define ACCEL_MODE_NORMAL           0
+
+typedef struct
+{
+    uint8_t fullscale;
+    uint8_t samp_freq;
+    uint8_t axis_en;
+    uint8_t mode;
+} accelerometer_config_t;
+
+typedef struct
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} accelerometer_data_t;
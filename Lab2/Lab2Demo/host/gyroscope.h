@@ -0,0 +1,25 @@
+/*
+ * Host stand-in for the SDK's gyroscope driver interface.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+#define GYRO_FULLSCALE_250DPS       3
+#define GYRO_AXIS_EN_X              (1 << 0)
+#define GYRO_AXIS_EN_Y              (1 << 1)
+#define GYRO_AXIS_EN_Z              (1 << 2)
+
+typedef struct
+{
+    uint8_t fullscale;
+    uint8_t axis_en;
+} gyroscope_config_t;
+
+typedef struct
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} gyroscope_data_t;
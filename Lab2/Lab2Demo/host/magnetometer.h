@@ -0,0 +1,14 @@
+/*
+ * Host stand-in for the SDK's magnetometer driver interface.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+typedef struct
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} magnetometer_data_t;
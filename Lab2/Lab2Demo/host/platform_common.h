@@ -0,0 +1,6 @@
+/*
+ * Host stand-in for the SDK's platform_common.h, the platform constants are in zos.h.
+ */
+#pragma once
+
+#include "zos.h"
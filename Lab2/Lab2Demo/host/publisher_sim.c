@@ -0,0 +1,177 @@
+/*
+ * Host simulation of the Lab2Demo publish pipeline against the stand-in broker in
+ * zos_host.c.
+ *
+ * Each scenario starts the app from scratch, runs it for a few minutes of simulated time
+ * with the link behaving badly in some way, and checks what reached the broker: every
+ * sample the sensor produced must arrive once and in order, except where the flash queue
+ * had to drop its oldest messages, which must then account for every missing sample.
+ * A last check reads the light sensor, whose stand-in ADC throws in full scale spikes the
+ * filter must reject.
+ *
+ * bluemix.c is included directly so its static publisher configuration can be varied.
+ *
+ *   publisher_sim <write dir>
+ */
+
+#include "../bluemix.c"
+#include "flash_queue.h"
+#include "zos_host.h"
+
+
+typedef struct
+{
+    const char *name;
+    uint8_t qos;
+    uint8_t window;
+    uint32_t latency;               // ms round trip
+    uint32_t settle;                // ms of normal operation first
+    zos_host_link_t outage;
+    uint32_t outage_time;           // ms
+    uint32_t recovery;              // ms of normal operation after the outage
+    zos_bool_t expect_loss;         // the flash queue is expected to overflow, or QoS0 to lose what was in transit
+    zos_bool_t expect_behind;       // the window is too small for the latency, only reported
+} scenario_t;
+
+static const scenario_t scenarios[] =
+{
+    { "steady, QoS0",                   MQTT_QOS_DELIVER_AT_MOST_ONCE,  MQTT_WINDOW, 50,   120000, ZOS_HOST_LINK_UP,     0,      0,      ZOS_FALSE, ZOS_FALSE },
+    { "steady, QoS1",                   MQTT_QOS_DELIVER_AT_LEAST_ONCE, MQTT_WINDOW, 50,   120000, ZOS_HOST_LINK_UP,     0,      0,      ZOS_FALSE, ZOS_FALSE },
+    { "2s round trip, window 1",        MQTT_QOS_DELIVER_AT_LEAST_ONCE, 1,           2000, 180000, ZOS_HOST_LINK_UP,     0,      0,      ZOS_FALSE, ZOS_TRUE  },
+    { "2s round trip, window 4",        MQTT_QOS_DELIVER_AT_LEAST_ONCE, 4,           2000, 180000, ZOS_HOST_LINK_UP,     0,      0,      ZOS_FALSE, ZOS_FALSE },
+    { "30s outage",                     MQTT_QOS_DELIVER_AT_LEAST_ONCE, MQTT_WINDOW, 100,  20000,  ZOS_HOST_LINK_DOWN,   30000,  90000,  ZOS_FALSE, ZOS_FALSE },
+    { "30s outage, QoS0",               MQTT_QOS_DELIVER_AT_MOST_ONCE,  MQTT_WINDOW, 100,  20000,  ZOS_HOST_LINK_DOWN,   30000,  90000,  ZOS_TRUE,  ZOS_FALSE },
+    { "20s silent link loss",           MQTT_QOS_DELIVER_AT_LEAST_ONCE, MQTT_WINDOW, 100,  20000,  ZOS_HOST_LINK_SILENT, 20000,  90000,  ZOS_FALSE, ZOS_FALSE },
+    { "3 minute outage",                MQTT_QOS_DELIVER_AT_LEAST_ONCE, MQTT_WINDOW, 100,  20000,  ZOS_HOST_LINK_DOWN,   180000, 180000, ZOS_TRUE,  ZOS_FALSE },
+};
+
+
+/*************************************************************************************************/
+static zos_bool_t run_scenario(const scenario_t *scenario)
+{
+    publisher_config_t config = publisher_config;
+    zos_bool_t passed = ZOS_TRUE;
+
+    zos_host_delete_files();
+    zos_host_broker_set_link(ZOS_HOST_LINK_UP);
+    zos_host_broker_set_latency(scenario->latency);
+
+    zn_app_init();
+    settings.qos = scenario->qos;
+    config.window = scenario->window;
+    publisher_stop();
+    publisher_start(&config);
+    zos_host_broker_reset();
+
+    zos_host_advance(scenario->settle);
+    if(scenario->outage_time > 0)
+    {
+        zos_host_broker_set_link(scenario->outage);
+        zos_host_advance(scenario->outage_time);
+        zos_host_broker_set_link(ZOS_HOST_LINK_UP);
+        zos_host_advance(scenario->recovery);
+    }
+
+    // Let whatever is on the wire arrive before counting
+    sampler_stop();
+    zos_host_advance(scenario->latency);
+
+    const publisher_context_t *context = publisher_get_context();
+    const zos_host_broker_stats_t *broker = zos_host_broker_stats();
+    const uint32_t queue_dropped = flash_queue_get_stats()->dropped;
+    const uint32_t sampler_dropped = sampler_get_stats()->dropped;
+    const uint32_t produced = sampler_get_stats()->samples + sampler_dropped;
+    const uint32_t backlog = sampler_count() + flash_queue_count() * config.batch_samples;
+
+    printf("\n%s\n", scenario->name);
+    printf("  publisher: %lu sent, %lu acked, %lu requeued, %lu spilled to flash, %lu connects, %lu failed, %lu ack timeouts\n",
+           (unsigned long)context->sent, (unsigned long)context->acked, (unsigned long)context->requeued,
+           (unsigned long)context->spilled, (unsigned long)context->connects, (unsigned long)context->connect_failures,
+           (unsigned long)context->ack_timeouts);
+    printf("  dropped:   %lu samples by the sampler, %lu messages by the flash queue, %lu samples waiting\n",
+           (unsigned long)sampler_dropped, (unsigned long)queue_dropped, (unsigned long)backlog);
+    printf("  broker:    %lu messages, %lu bytes, %lu of %lu samples, %lu lost, %lu duplicated, max lag %lums\n",
+           (unsigned long)broker->messages, (unsigned long)broker->bytes, (unsigned long)broker->samples,
+           (unsigned long)produced, (unsigned long)broker->lost, (unsigned long)broker->duplicates,
+           (unsigned long)broker->max_lag);
+
+    if(scenario->expect_behind)
+    {
+        printf("  (window too small for the latency, not checked)\n");
+    }
+    else
+    {
+        // Whatever has not reached the broker yet must still be waiting in RAM or flash
+        if(broker->duplicates > 0 || broker->samples + broker->lost + backlog < produced)
+        {
+            passed = ZOS_FALSE;
+        }
+        if(!scenario->expect_loss && broker->lost > 0)
+        {
+            passed = ZOS_FALSE;
+        }
+        else if(scenario->qos == MQTT_QOS_DELIVER_AT_MOST_ONCE)
+        {
+            // Messages in transit count as delivered once sent, the link takes them down with it
+            passed &= (broker->lost <= queue_dropped * config.batch_samples + sampler_dropped + config.window * SAMPLER_RING_SIZE);
+        }
+        else
+        {
+            passed &= (broker->lost == queue_dropped * config.batch_samples + sampler_dropped);
+        }
+        printf("  %s\n", passed ? "PASS" : "FAIL");
+    }
+
+    zn_app_deinit();
+    zos_host_run_events();
+
+    return passed;
+}
+
+/*************************************************************************************************/
+static zos_bool_t run_light_check(void)
+{
+    light_reading_t reading;
+    uint32_t outliers = 0;
+    int16_t min_level = INT16_MAX, max_level = INT16_MIN;
+
+    light_init();
+    for(uint32_t i = 0; i < 1000; ++i)
+    {
+        if(light_read(&reading) != ZOS_SUCCESS || reading.raw < (2048 << LIGHT_FRACTION_BITS) || reading.raw > (2111 << LIGHT_FRACTION_BITS))
+        {
+            ++outliers;
+        }
+        min_level = MIN(min_level, reading.level);
+        max_level = MAX(max_level, reading.level);
+    }
+
+    printf("\nlight sense\n");
+    printf("  1000 readings, %lu outside the noise band, level %d to %d\n", (unsigned long)outliers, min_level, max_level);
+    printf("  %s\n", (outliers == 0) ? "PASS" : "FAIL");
+
+    return (outliers == 0);
+}
+
+/*************************************************************************************************/
+int main(int argc, char *argv[])
+{
+    zos_bool_t passed = ZOS_TRUE;
+
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s <write dir>\n", argv[0]);
+        return 2;
+    }
+    zos_host_set_fs_write_root(argv[1]);
+    zos_host_set_log_enabled(getenv("SIM_LOG") != NULL);
+
+    for(uint32_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i)
+    {
+        passed &= run_scenario(&scenarios[i]);
+    }
+    passed &= run_light_check();
+
+    printf("\n%s\n", passed ? "All scenarios passed" : "Some scenarios FAILED");
+    return passed ? 0 : 1;
+}
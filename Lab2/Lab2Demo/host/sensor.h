@@ -0,0 +1,19 @@
+/*
+ * Host stand-in for the SDK's sensor library, see zos_host.c for the simulated readings.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+typedef enum
+{
+    SENSOR_ACCELEROMETER,
+    SENSOR_MAGNETOMETER,
+    SENSOR_GYROSCOPE,
+    SENSOR_COUNT
+} sensor_type_t;
+
+zos_result_t sensor_init(sensor_type_t sensor, void *config);
+zos_result_t sensor_has_new_data(sensor_type_t sensor, zos_bool_t *has_data);
+zos_result_t sensor_get_data(sensor_type_t sensor, void *data);
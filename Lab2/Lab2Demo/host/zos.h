@@ -0,0 +1,141 @@
+/*
+ * Host (Linux) stand-in for the subset of the ZentriOS SDK used by the Lab2Demo app.
+ *
+ * Only the types, macros and zn_* calls the app actually references are declared here.
+ * The behaviour behind them lives in zos_host.c and is deliberately simple: enough for the
+ * app sources to compile unmodified on a PC so the publish pipeline can be exercised
+ * against a stand-in broker. Nothing in this directory is part of the firmware build.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+
+/******************************************************
+ *                 Basic types
+ ******************************************************/
+typedef int zos_result_t;
+typedef uint8_t zos_bool_t;
+
+#define ZOS_TRUE                    1
+#define ZOS_FALSE                   0
+
+#define ZOS_SUCCESS                 0
+#define ZOS_ERROR                   1
+#define ZOS_TIMEOUT                 2
+#define ZOS_BADARG                  5
+#define ZOS_NO_MEM                  6
+#define ZOS_NOT_FOUND               7
+#define ZOS_BUFFER_OVERFLOW         8
+#define ZOS_UNSUPPORTED             9
+
+#define ZOS_FAILED(result, func)    (((result) = (func)) != ZOS_SUCCESS)
+
+#ifndef MIN
+#define MIN(x,y)                    (((x) < (y)) ? (x) : (y))
+#endif
+#ifndef MAX
+#define MAX(x,y)                    (((x) > (y)) ? (x) : (y))
+#endif
+
+#define ZOS_LOG(fmt, ...)           zn_host_log(fmt, ##__VA_ARGS__)
+
+void zn_host_log(const char *fmt, ...);
+
+
+/******************************************************
+ *                 Platform
+ ******************************************************/
+typedef enum
+{
+    ZOS_WLAN,
+    ZOS_SOFTAP,
+    ZOS_ETHERNET
+} zos_interface_t;
+
+typedef int zos_gpio_t;
+
+#define PLATFORM_STD_ADC                2
+#define PLATFORM_ADC_MAX_RESOLUTION     12
+
+
+/******************************************************
+ *                 Event loop / RTOS
+ ******************************************************/
+typedef void (*zos_event_handler_t)(void *arg);
+
+#define RUN_NOW                     (1 << 0)
+#define EVENT_FLAGS1(a)             (a)
+
+zos_result_t zn_event_issue(zos_event_handler_t handler, void *arg, uint32_t flags);
+zos_result_t zn_event_register_periodic(zos_event_handler_t handler, void *arg, uint32_t period_ms, uint32_t flags);
+zos_result_t zn_event_register_timed(zos_event_handler_t handler, void *arg, uint32_t delay_ms, uint32_t flags);
+void zn_event_unregister(zos_event_handler_t handler, void *arg);
+uint32_t zn_rtos_get_time(void);
+
+
+/******************************************************
+ *                 Memory
+ ******************************************************/
+zos_result_t zn_malloc(uint8_t **ptr, uint32_t size);
+void zn_free(void *ptr);
+
+
+/******************************************************
+ *                 File system
+ ******************************************************/
+typedef enum
+{
+    ZOS_FILE_TYPE_MISC = 0xFE
+} zos_file_type_t;
+
+typedef struct
+{
+    char name[96];
+    uint32_t size;
+    zos_file_type_t type;
+    uint32_t version;
+} zos_file_t;
+
+zos_result_t zn_file_open(const char *name, uint32_t *handle);
+zos_result_t zn_file_read(uint32_t handle, void *data, uint32_t size, uint32_t *bytes_read);
+zos_result_t zn_file_close(uint32_t handle);
+zos_result_t zn_file_create(const zos_file_t *file, uint32_t *handle);
+zos_result_t zn_file_write(uint32_t handle, const void *data, uint32_t size);
+zos_result_t zn_file_delete(const char *name);
+
+
+/******************************************************
+ *                 ADC
+ ******************************************************/
+typedef int zos_adc_t;
+
+typedef struct
+{
+    uint8_t resolution;
+    uint8_t sampling_cycle;
+    uint8_t gain;
+} zos_adc_config_t;
+
+zos_result_t zn_adc_gpio_to_peripheral(zos_gpio_t gpio, zos_adc_t *adc);
+zos_result_t zn_adc_direct_init(zos_adc_t adc, const zos_adc_config_t *config);
+zos_result_t zn_adc_direct_sample(zos_adc_t adc, uint16_t *sample);
+
+
+/******************************************************
+ *                 Network / commands
+ ******************************************************/
+zos_bool_t zn_network_is_up(zos_interface_t iface);
+zos_result_t zn_network_restart(zos_interface_t iface);
+zos_result_t zn_network_get_mac(char *mac_str);
+zos_result_t zn_issue_command_return_data(char *buffer, uint32_t size, uint32_t *bytes_read, const char *fmt, ...);
+
+
+/******************************************************
+ *                 Utilities
+ ******************************************************/
+char* int_to_str(int32_t value, char *str);
@@ -0,0 +1,755 @@
+/*
+ * Host (Linux) implementation of the ZentriOS stand-in declared in zos.h, the sensor and
+ * MQTT library stand-ins and a minimal broker on the other end of the connection.
+ *
+ * Time is purely simulated: it only moves with zos_host_advance(), so runs are repeatable
+ * and hours of operation take well under a second.
+ *
+ * The accelerometer reports a sample counter on its X axis, one step per 20ms output. The
+ * broker rebuilds X from the delta encoded "S" array of each JSON message it receives and
+ * checks the counter carries on from the previous message, which catches any sample lost,
+ * duplicated or delivered out of order anywhere between the sensor and the broker.
+ */
+
+#include <dirent.h>
+#include "zos_host.h"
+#include "sensor.h"
+#include "accelerometer.h"
+#include "gyroscope.h"
+#include "magnetometer.h"
+#include "mqtt_api.h"
+
+
+#define HOST_MAX_FILES              8
+#define HOST_MAX_EVENTS             32
+#define HOST_MAX_TIMERS             32
+#define HOST_MAX_FRAMES             16      // PUBLISH frames travelling between client and broker
+#define HOST_FRAME_SIZE             4096
+
+#define SENSOR_PERIOD               20      // ms, the accelerometer's 50Hz output data rate
+#define SENSOR_COUNTER_MASK         0x3FFF  // range of the sample counter carried on accel X
+
+typedef struct
+{
+    zos_event_handler_t handler;
+    void *arg;
+} host_event_t;
+
+typedef struct
+{
+    zos_event_handler_t handler;
+    void *arg;
+    uint32_t period;                // 0 for a one-shot timed event
+    uint32_t due;
+} host_timer_t;
+
+typedef struct
+{
+    zos_bool_t used;
+    mqtt_msgid_t msgid;
+    uint8_t qos;
+    uint32_t length;
+    uint8_t data[HOST_FRAME_SIZE];
+} host_frame_t;
+
+
+static zos_bool_t log_enabled = ZOS_TRUE;
+static const char *fs_write_root = ".";
+static FILE *files[HOST_MAX_FILES];
+static host_event_t events[HOST_MAX_EVENTS];
+static uint32_t event_head, event_tail;
+static host_timer_t timers[HOST_MAX_TIMERS];
+static uint32_t now;
+static uint32_t sensor_read_tick[SENSOR_COUNT];
+
+static struct
+{
+    zos_host_link_t link;
+    uint32_t latency;               // ms round trip
+    mqtt_connection_t *connection;
+    zos_bool_t connected;
+    mqtt_msgid_t next_msgid;
+    host_frame_t frames[HOST_MAX_FRAMES];
+    zos_bool_t synced;              // the next sample counter is known
+    uint32_t next_sample;           // sample counter expected next, unwrapped
+    zos_host_broker_stats_t stats;
+} broker = { .latency = 50 };
+
+
+static void frame_arrived_event_handler(void *arg);
+static void frame_acked_event_handler(void *arg);
+static void connack_event_handler(void *arg);
+
+
+/*************************************************************************************************/
+void zn_host_log(const char *fmt, ...)
+{
+    char buffer[256];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+
+    if(log_enabled)
+    {
+        printf("%7u.%03u %s\n", (unsigned)(now / 1000), (unsigned)(now % 1000), buffer);
+    }
+}
+
+/*************************************************************************************************/
+void zos_host_set_log_enabled(zos_bool_t enabled)
+{
+    log_enabled = enabled;
+}
+
+
+/*************************************************************************************************
+ * Memory
+ */
+zos_result_t zn_malloc(uint8_t **ptr, uint32_t size)
+{
+    *ptr = malloc(size);
+    return (*ptr != NULL) ? ZOS_SUCCESS : ZOS_NO_MEM;
+}
+
+/*************************************************************************************************/
+void zn_free(void *ptr)
+{
+    free(ptr);
+}
+
+
+/*************************************************************************************************
+ * Event loop / RTOS
+ */
+zos_result_t zn_event_issue(zos_event_handler_t handler, void *arg, uint32_t flags)
+{
+    const uint32_t next = (event_tail + 1) % HOST_MAX_EVENTS;
+
+    if(next == event_head)
+    {
+        return ZOS_NO_MEM;
+    }
+    events[event_tail].handler = handler;
+    events[event_tail].arg = arg;
+    event_tail = next;
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+void zos_host_run_events(void)
+{
+    while(event_head != event_tail)
+    {
+        const host_event_t event = events[event_head];
+        event_head = (event_head + 1) % HOST_MAX_EVENTS;
+        event.handler(event.arg);
+    }
+}
+
+/*************************************************************************************************/
+static zos_result_t register_timer(zos_event_handler_t handler, void *arg, uint32_t delay, uint32_t period)
+{
+    host_timer_t *slot = NULL;
+
+    for(host_timer_t *timer = timers; timer < &timers[HOST_MAX_TIMERS]; ++timer)
+    {
+        if(timer->handler == handler && timer->arg == arg)
+        {
+            slot = timer;
+            break;
+        }
+        else if(timer->handler == NULL && slot == NULL)
+        {
+            slot = timer;
+        }
+    }
+
+    if(slot == NULL)
+    {
+        return ZOS_NO_MEM;
+    }
+    slot->handler = handler;
+    slot->arg = arg;
+    slot->period = period;
+    slot->due = now + delay;
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_event_register_periodic(zos_event_handler_t handler, void *arg, uint32_t period_ms, uint32_t flags)
+{
+    return register_timer(handler, arg, (flags & RUN_NOW) ? 0 : period_ms, period_ms);
+}
+
+/*************************************************************************************************/
+zos_result_t zn_event_register_timed(zos_event_handler_t handler, void *arg, uint32_t delay_ms, uint32_t flags)
+{
+    return register_timer(handler, arg, delay_ms, 0);
+}
+
+/*************************************************************************************************/
+void zn_event_unregister(zos_event_handler_t handler, void *arg)
+{
+    for(host_timer_t *timer = timers; timer < &timers[HOST_MAX_TIMERS]; ++timer)
+    {
+        if(timer->handler == handler && timer->arg == arg)
+        {
+            memset(timer, 0, sizeof(host_timer_t));
+        }
+    }
+}
+
+/*************************************************************************************************/
+void zos_host_advance(uint32_t ms)
+{
+    const uint32_t target = now + ms;
+
+    zos_host_run_events();
+
+    for(;;)
+    {
+        host_timer_t *next = NULL;
+
+        for(host_timer_t *timer = timers; timer < &timers[HOST_MAX_TIMERS]; ++timer)
+        {
+            if(timer->handler != NULL && (int32_t)(timer->due - target) <= 0 &&
+              (next == NULL || (int32_t)(timer->due - next->due) < 0))
+            {
+                next = timer;
+            }
+        }
+        if(next == NULL)
+        {
+            break;
+        }
+
+        const host_timer_t fired = *next;
+        now = fired.due;
+        if(fired.period > 0)
+        {
+            next->due += fired.period;
+        }
+        else
+        {
+            memset(next, 0, sizeof(host_timer_t));
+        }
+
+        fired.handler(fired.arg);
+        zos_host_run_events();
+    }
+
+    now = target;
+}
+
+/*************************************************************************************************/
+uint32_t zn_rtos_get_time(void)
+{
+    return now;
+}
+
+
+/*************************************************************************************************
+ * File system
+ *
+ * Every file lives in the write root, by base name.
+ */
+void zos_host_set_fs_write_root(const char *path)
+{
+    fs_write_root = path;
+}
+
+/*************************************************************************************************/
+void zos_host_delete_files(void)
+{
+    DIR *dir = opendir(fs_write_root);
+    char path[512];
+
+    for(struct dirent *entry; dir != NULL && (entry = readdir(dir)) != NULL; )
+    {
+        if(entry->d_name[0] != '.')
+        {
+            snprintf(path, sizeof(path), "%s/%s", fs_write_root, entry->d_name);
+            remove(path);
+        }
+    }
+    if(dir != NULL)
+    {
+        closedir(dir);
+    }
+}
+
+/*************************************************************************************************/
+static void host_file_path(char *path, size_t size, const char *name)
+{
+    const char *base = strrchr(name, '/');
+    snprintf(path, size, "%s/%s", fs_write_root, (base != NULL) ? base + 1 : name);
+}
+
+/*************************************************************************************************/
+static zos_result_t host_file_open(const char *name, const char *mode, uint32_t *handle)
+{
+    char path[512];
+
+    for(uint32_t i = 0; i < HOST_MAX_FILES; ++i)
+    {
+        if(files[i] == NULL)
+        {
+            host_file_path(path, sizeof(path), name);
+            if((files[i] = fopen(path, mode)) == NULL)
+            {
+                return ZOS_NOT_FOUND;
+            }
+            *handle = i + 1;
+            return ZOS_SUCCESS;
+        }
+    }
+
+    return ZOS_NO_MEM;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_open(const char *name, uint32_t *handle)
+{
+    return host_file_open(name, "rb", handle);
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_create(const zos_file_t *file, uint32_t *handle)
+{
+    char path[512];
+    FILE *existing;
+
+    // Like the module's file system, creating a file that already exists fails
+    host_file_path(path, sizeof(path), file->name);
+    if((existing = fopen(path, "rb")) != NULL)
+    {
+        fclose(existing);
+        return ZOS_ERROR;
+    }
+    return host_file_open(file->name, "wb", handle);
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_write(uint32_t handle, const void *data, uint32_t size)
+{
+    if(handle == 0 || handle > HOST_MAX_FILES || files[handle-1] == NULL)
+    {
+        return ZOS_BADARG;
+    }
+    return (fwrite(data, 1, size, files[handle-1]) == size) ? ZOS_SUCCESS : ZOS_ERROR;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_delete(const char *name)
+{
+    char path[512];
+
+    host_file_path(path, sizeof(path), name);
+    return (remove(path) == 0) ? ZOS_SUCCESS : ZOS_NOT_FOUND;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_read(uint32_t handle, void *data, uint32_t size, uint32_t *bytes_read)
+{
+    if(handle == 0 || handle > HOST_MAX_FILES || files[handle-1] == NULL)
+    {
+        return ZOS_BADARG;
+    }
+    *bytes_read = fread(data, 1, size, files[handle-1]);
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_close(uint32_t handle)
+{
+    if(handle == 0 || handle > HOST_MAX_FILES || files[handle-1] == NULL)
+    {
+        return ZOS_BADARG;
+    }
+    fclose(files[handle-1]);
+    files[handle-1] = NULL;
+    return ZOS_SUCCESS;
+}
+
+
+/*************************************************************************************************
+ * ADC
+ */
+zos_result_t zn_adc_gpio_to_peripheral(zos_gpio_t gpio, zos_adc_t *adc)
+{
+    *adc = gpio;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_adc_direct_init(zos_adc_t adc, const zos_adc_config_t *config)
+{
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_adc_direct_sample(zos_adc_t adc, uint16_t *sample)
+{
+    static uint32_t conversions;
+
+    // Noise around mid scale, with a full scale spike now and then for the filter to reject
+    *sample = (++conversions % 37 == 0) ? 4095 : 2048 + (uint16_t)(rand() % 64);
+    return ZOS_SUCCESS;
+}
+
+
+/*************************************************************************************************
+ * Network / commands / utilities
+ */
+zos_bool_t zn_network_is_up(zos_interface_t iface)
+{
+    return ZOS_TRUE;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_network_restart(zos_interface_t iface)
+{
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_network_get_mac(char *mac_str)
+{
+    strcpy(mac_str, "4C:55:CC:10:2A:3B");
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_issue_command_return_data(char *buffer, uint32_t size, uint32_t *bytes_read, const char *fmt, ...)
+{
+    // Only used for wlan_get_rssi
+    *bytes_read = snprintf(buffer, size, "-52");
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+char* int_to_str(int32_t value, char *str)
+{
+    sprintf(str, "%ld", (long)value);
+    return str;
+}
+
+
+/*************************************************************************************************
+ * Sensors
+ *
+ * Each sensor has new data once per SENSOR_PERIOD of simulated time. The accelerometer's
+ * X axis is the output counter, Y and Z and the other sensors wander slowly.
+ */
+zos_result_t sensor_init(sensor_type_t sensor, void *config)
+{
+    sensor_read_tick[sensor] = now / SENSOR_PERIOD;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t sensor_has_new_data(sensor_type_t sensor, zos_bool_t *has_data)
+{
+    *has_data = (now / SENSOR_PERIOD != sensor_read_tick[sensor]);
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t sensor_get_data(sensor_type_t sensor, void *data)
+{
+    const uint32_t tick = now / SENSOR_PERIOD;
+    int16_t *axes = data;
+
+    sensor_read_tick[sensor] = tick;
+    axes[0] = (sensor == SENSOR_ACCELEROMETER) ? (int16_t)(tick & SENSOR_COUNTER_MASK) : (int16_t)(tick % 50);
+    axes[1] = (int16_t)((tick / 10) % 7) - 3;
+    axes[2] = (sensor == SENSOR_ACCELEROMETER) ? 1000 + (int16_t)(tick % 3) : -(int16_t)(tick % 5);
+
+    return ZOS_SUCCESS;
+}
+
+
+/*************************************************************************************************
+ * MQTT client library and broker
+ *
+ * PUBLISH frames take half the round trip latency to reach the broker. A QoS1 message is
+ * reported published when the PUBACK arrives, the other half later; a QoS0 one as soon as
+ * it has been handed to the network, as the SDK does.
+ */
+void zos_host_broker_set_latency(uint32_t ms)
+{
+    broker.latency = ms;
+}
+
+/*************************************************************************************************/
+const zos_host_broker_stats_t* zos_host_broker_stats(void)
+{
+    return &broker.stats;
+}
+
+/*************************************************************************************************/
+void zos_host_broker_reset(void)
+{
+    memset(&broker.stats, 0, sizeof(broker.stats));
+    broker.synced = ZOS_FALSE;
+}
+
+/*************************************************************************************************/
+static void raise_event(mqtt_event_type_t type, mqtt_msgid_t msgid)
+{
+    mqtt_event_info_t event = { .type = type };
+
+    event.data.msgid = msgid;
+    if(broker.connection != NULL && broker.connection->callback != NULL)
+    {
+        broker.connection->callback(&event);
+    }
+}
+
+/*************************************************************************************************/
+static void drop_frames(void)
+{
+    for(host_frame_t *frame = broker.frames; frame < &broker.frames[HOST_MAX_FRAMES]; ++frame)
+    {
+        if(frame->used)
+        {
+            zn_event_unregister(frame_arrived_event_handler, frame);
+            zn_event_unregister(frame_acked_event_handler, frame);
+            frame->used = ZOS_FALSE;
+        }
+    }
+}
+
+/*************************************************************************************************/
+static void connection_lost_event_handler(void *arg)
+{
+    raise_event(MQTT_EVENT_TYPE_DISCONNECTED, 0);
+}
+
+/*************************************************************************************************/
+void zos_host_broker_set_link(zos_host_link_t link)
+{
+    broker.link = link;
+    if(link != ZOS_HOST_LINK_UP)
+    {
+        drop_frames();
+        zn_event_unregister(connack_event_handler, NULL);
+    }
+    if(link == ZOS_HOST_LINK_DOWN && broker.connected)
+    {
+        broker.connected = ZOS_FALSE;
+        zn_event_issue(connection_lost_event_handler, NULL, 0);
+    }
+}
+
+/*************************************************************************************************/
+static void receive_samples(const char *json)
+{
+    const char *p = strstr(json, "\"S\":[");
+    int32_t values[9] = {0};
+    uint32_t index = 0;
+
+    if(p == NULL)
+    {
+        return;
+    }
+
+    for(p += 5; *p != ']' && *p != 0; ++index)
+    {
+        char *end;
+        const long value = strtol(p, &end, 10);
+
+        // First sample absolute, the rest deltas
+        values[index % 9] = (index < 9) ? value : values[index % 9] + value;
+
+        if(index % 9 == 0)
+        {
+            const uint32_t counter = (uint32_t)values[0] & SENSOR_COUNTER_MASK;
+            const int32_t offset = broker.synced ?
+                (int32_t)(((counter - broker.next_sample) & SENSOR_COUNTER_MASK) ^ 0x2000) - 0x2000 : 0;
+
+            if(!broker.synced)
+            {
+                const uint32_t tick = now / SENSOR_PERIOD;
+
+                broker.synced = ZOS_TRUE;
+                broker.next_sample = tick - ((tick - counter) & SENSOR_COUNTER_MASK);
+            }
+
+            if(offset < 0)
+            {
+                ++broker.stats.duplicates;
+            }
+            else
+            {
+                broker.stats.lost += offset;
+                broker.next_sample += offset + 1;
+                ++broker.stats.samples;
+                broker.stats.max_lag = MAX(broker.stats.max_lag, now - (broker.next_sample - 1) * SENSOR_PERIOD);
+            }
+        }
+
+        p = (*end == ',') ? end + 1 : end;
+    }
+}
+
+/*************************************************************************************************/
+static void frame_arrived_event_handler(void *arg)
+{
+    host_frame_t *frame = arg;
+
+    ++broker.stats.messages;
+    broker.stats.bytes += frame->length;
+    frame->data[frame->length] = 0;
+    receive_samples((const char*)frame->data);
+
+    if(frame->qos == MQTT_QOS_DELIVER_AT_LEAST_ONCE)
+    {
+        zn_event_register_timed(frame_acked_event_handler, frame, broker.latency - broker.latency / 2, 0);
+    }
+    else
+    {
+        frame->used = ZOS_FALSE;
+    }
+}
+
+/*************************************************************************************************/
+static void frame_acked_event_handler(void *arg)
+{
+    host_frame_t *frame = arg;
+
+    frame->used = ZOS_FALSE;
+    raise_event(MQTT_EVENT_TYPE_PUBLISHED, frame->msgid);
+}
+
+/*************************************************************************************************/
+static void qos0_sent_event_handler(void *arg)
+{
+    raise_event(MQTT_EVENT_TYPE_PUBLISHED, (mqtt_msgid_t)(uintptr_t)arg);
+}
+
+/*************************************************************************************************/
+static void connack_event_handler(void *arg)
+{
+    broker.connected = ZOS_TRUE;
+    ++broker.stats.connects;
+    raise_event(MQTT_EVENT_TYPE_CONNECTED, 0);
+}
+
+/*************************************************************************************************/
+zos_result_t mqtt_init(mqtt_connection_t *conn)
+{
+    memset(conn, 0, sizeof(mqtt_connection_t));
+    broker.connection = conn;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t mqtt_deinit(mqtt_connection_t *conn)
+{
+    drop_frames();
+    zn_event_unregister(connack_event_handler, NULL);
+    broker.connected = ZOS_FALSE;
+    broker.connection = NULL;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t mqtt_open(mqtt_connection_t *conn, const char *host, uint16_t port, zos_interface_t iface, mqtt_callback_t callback, zos_bool_t security)
+{
+    if(broker.link == ZOS_HOST_LINK_DOWN)
+    {
+        return ZOS_ERROR;
+    }
+    conn->callback = callback;
+    conn->open = ZOS_TRUE;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t mqtt_connect(mqtt_connection_t *conn, const mqtt_pkt_connect_t *conninfo)
+{
+    if(!conn->open)
+    {
+        return ZOS_ERROR;
+    }
+    if(broker.link == ZOS_HOST_LINK_UP)
+    {
+        zn_event_register_timed(connack_event_handler, NULL, broker.latency, 0);
+    }
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t mqtt_disconnect(mqtt_connection_t *conn)
+{
+    const zos_bool_t was_connected = broker.connected;
+
+    drop_frames();
+    zn_event_unregister(connack_event_handler, NULL);
+    broker.connected = ZOS_FALSE;
+    conn->open = ZOS_FALSE;
+    if(was_connected)
+    {
+        zn_event_issue(connection_lost_event_handler, NULL, 0);
+    }
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+mqtt_msgid_t mqtt_publish(mqtt_connection_t *conn, const uint8_t *topic, const uint8_t *data, uint32_t length, uint8_t qos)
+{
+    host_frame_t *frame = broker.frames;
+
+    if(!broker.connected || length >= HOST_FRAME_SIZE)
+    {
+        return 0;
+    }
+    while(frame < &broker.frames[HOST_MAX_FRAMES] && frame->used)
+    {
+        ++frame;
+    }
+    if(frame == &broker.frames[HOST_MAX_FRAMES])
+    {
+        return 0;
+    }
+
+    broker.next_msgid = (broker.next_msgid == UINT16_MAX) ? 1 : broker.next_msgid + 1;
+    frame->used = ZOS_TRUE;
+    frame->msgid = broker.next_msgid;
+    frame->qos = qos;
+    frame->length = length;
+    memcpy(frame->data, data, length);
+
+    if(broker.link == ZOS_HOST_LINK_UP)
+    {
+        zn_event_register_timed(frame_arrived_event_handler, frame, broker.latency / 2, 0);
+    }
+    else
+    {
+        // Swallowed by a link that died silently
+        frame->used = (qos == MQTT_QOS_DELIVER_AT_LEAST_ONCE);
+    }
+    if(qos == MQTT_QOS_DELIVER_AT_MOST_ONCE)
+    {
+        zn_event_issue(qos0_sent_event_handler, (void*)(uintptr_t)frame->msgid, 0);
+    }
+
+    return frame->msgid;
+}
+
+/*************************************************************************************************/
+mqtt_msgid_t mqtt_subscribe(mqtt_connection_t *conn, const uint8_t *topic, uint8_t qos)
+{
+    return broker.connected ? ++broker.next_msgid : 0;
+}
+
+/*************************************************************************************************/
+mqtt_msgid_t mqtt_unsubscribe(mqtt_connection_t *conn, const uint8_t *topic)
+{
+    return broker.connected ? ++broker.next_msgid : 0;
+}
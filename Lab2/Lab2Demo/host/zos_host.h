@@ -0,0 +1,41 @@
+/*
+ * Controls for the host stand-in of the ZentriOS SDK and the MQTT broker.
+ *
+ * These calls have no firmware equivalent; they let host-side tools drive the app the way
+ * the module's event loop, the sensors and a remote broker would.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+typedef struct
+{
+    uint32_t connects;              // CONNECT frames accepted
+    uint32_t messages;              // PUBLISH frames received
+    uint32_t bytes;
+    uint32_t samples;               // samples received in order
+    uint32_t lost;                  // samples skipped over, never received
+    uint32_t duplicates;            // samples received more than once
+    uint32_t max_lag;               // ms between a sample being taken and reaching the broker
+} zos_host_broker_stats_t;
+
+typedef enum
+{
+    ZOS_HOST_LINK_UP,
+    ZOS_HOST_LINK_DOWN,             // the client is told the connection dropped
+    ZOS_HOST_LINK_SILENT            // frames vanish without the client noticing
+} zos_host_link_t;
+
+
+void zos_host_set_log_enabled(zos_bool_t enabled);
+void zos_host_set_fs_write_root(const char *path);
+void zos_host_delete_files(void);
+
+void zos_host_run_events(void);
+void zos_host_advance(uint32_t ms);
+
+void zos_host_broker_set_link(zos_host_link_t link);
+void zos_host_broker_set_latency(uint32_t ms);
+void zos_host_broker_reset(void);
+const zos_host_broker_stats_t* zos_host_broker_stats(void);
@@ -0,0 +1,155 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+
+/** @file
+ *
+ * Light sense ADC stage: one filtered, calibrated reading per published message.
+ *
+ * The ADC peripheral is resolved and configured once by light_init(). Each reading is a
+ * block of LIGHT_BLOCKS x LIGHT_BLOCK_SAMPLES back to back conversions: the conversions of
+ * a block are summed, which averages them with LIGHT_FRACTION_BITS bits of extra
+ * resolution, and the reading is the median of the block sums, so a single disturbed
+ * conversion cannot pull it. Everything stays in integers.
+ *
+ * The filtered reading is converted with the lookup table for the ADC's resolution,
+ * interpolating linearly between its points. The tables are compiled from
+ * resources/lut_*.csv into constant arrays at build time (tools/compile_lut.py), rather
+ * than loaded from the file system and parsed by zn_adc_add_lut() when the app starts.
+ *
+ */
+
+#include "zos.h"
+#include "platform_common.h"
+#include "light.h"
+#include "adc_lut.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#if PLATFORM_ADC_MAX_RESOLUTION == 12
+#define LIGHT_LUT                   adc_lut_12bit
+#else
+#define LIGHT_LUT                   adc_lut_10bit
+#endif
+#define LIGHT_LUT_POINTS            (sizeof(LIGHT_LUT) / sizeof(LIGHT_LUT[0]))
+
+#define LIGHT_FULL_SCALE            ((1 << PLATFORM_ADC_MAX_RESOLUTION) - 1)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+static const zos_adc_config_t adc_config =
+{
+    .resolution = PLATFORM_ADC_MAX_RESOLUTION,
+    .sampling_cycle = 12,
+    .gain = 1
+};
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static zos_adc_t adc;
+static zos_bool_t ready;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+zos_result_t light_init(void)
+{
+    zos_result_t result;
+
+    ready = ZOS_FALSE;
+
+    if(ZOS_FAILED(result, zn_adc_gpio_to_peripheral(PLATFORM_STD_ADC, &adc)))
+    {
+        ZOS_LOG("The specified GPIO: %d does not support ADC!", PLATFORM_STD_ADC);
+    }
+    else if(ZOS_FAILED(result, zn_adc_direct_init(adc, &adc_config)))
+    {
+        ZOS_LOG("Failed to initialize ADC!");
+    }
+    else
+    {
+        ready = ZOS_TRUE;
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+zos_result_t light_read(light_reading_t *reading)
+{
+    zos_result_t result;
+    uint16_t blocks[LIGHT_BLOCKS];
+
+    if(!ready)
+    {
+        return ZOS_ERROR;
+    }
+
+    // Block sums go into 'blocks' in order, insertion sort as they come in
+    for(uint8_t b = 0; b < LIGHT_BLOCKS; ++b)
+    {
+        uint16_t sum = 0;
+        uint8_t i;
+
+        for(uint8_t s = 0; s < LIGHT_BLOCK_SAMPLES; ++s)
+        {
+            uint16_t sample;
+
+            if(ZOS_FAILED(result, zn_adc_direct_sample(adc, &sample)))
+            {
+                return result;
+            }
+            sum += sample;
+        }
+
+        for(i = b; i > 0 && blocks[i-1] > sum; --i)
+        {
+            blocks[i] = blocks[i-1];
+        }
+        blocks[i] = sum;
+    }
+
+    reading->raw = blocks[LIGHT_BLOCKS / 2];
+    reading->sense = LIGHT_FULL_SCALE - ((reading->raw + (1 << (LIGHT_FRACTION_BITS - 1))) >> LIGHT_FRACTION_BITS);
+    reading->level = convert(reading->raw);
+
+    return ZOS_SUCCESS;
+}
+
+/******************************************************
+ *               Static Function Definitions
+ ******************************************************/
+static int16_t convert(uint16_t raw)
+{
+    const light_lut_point_t *point = LIGHT_LUT;
+    const light_lut_point_t *last = &LIGHT_LUT[LIGHT_LUT_POINTS - 1];
+    int32_t span, numerator;
+
+    // Readings outside the table take the value of its nearest end
+    if(raw <= (uint32_t)point->adc << LIGHT_FRACTION_BITS)
+    {
+        return point->value;
+    }
+    while(point < last && raw > (uint32_t)point[1].adc << LIGHT_FRACTION_BITS)
+    {
+        ++point;
+    }
+    if(point == last)
+    {
+        return last->value;
+    }
+
+    span = (int32_t)(point[1].adc - point->adc) << LIGHT_FRACTION_BITS;
+    numerator = (int32_t)(point[1].value - point->value) * (int32_t)(raw - ((uint32_t)point->adc << LIGHT_FRACTION_BITS));
+
+    // Rounded to the nearest whole value, either side of zero
+    return point->value + ((numerator >= 0) ? (numerator + span / 2) / span : -((span / 2 - numerator) / span));
+}
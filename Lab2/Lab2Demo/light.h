@@ -0,0 +1,42 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+#pragma once
+
+
+#include "zos.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define LIGHT_BLOCKS                5       // blocks per reading, the reading is their median
+#define LIGHT_BLOCK_SAMPLES         4       // conversions summed per block
+#define LIGHT_FRACTION_BITS         2       // log2(LIGHT_BLOCK_SAMPLES), fractional bits of a filtered reading
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+/* One point of a lookup table, see tools/compile_lut.py */
+typedef struct
+{
+    uint16_t adc;
+    int16_t value;
+} light_lut_point_t;
+
+typedef struct
+{
+    uint16_t raw;                           // filtered ADC reading, LIGHT_FRACTION_BITS fractional bits
+    uint16_t sense;                         // full scale minus the reading, what Light_Sense has always carried
+    int16_t level;                          // the reading converted with the lookup table
+} light_reading_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+zos_result_t light_init(void);
+zos_result_t light_read(light_reading_t *reading);
@@ -0,0 +1,14 @@
+########################################
+#
+# Pre-build targets for Lab2Demo, listed in PRE_BUILD_TARGETS in Lab2Demo.mk
+#
+########################################
+
+LAB2DEMO_DIR := $(dir $(lastword $(MAKEFILE_LIST)))
+PYTHON ?= python3   # the tools need Python 3; override for a differently named interpreter
+
+.PHONY: compile_lut
+
+# build/generated/adc_lut.h, the light sensor's lookup tables compiled from resources/lut_*.csv
+compile_lut:
+	$(PYTHON) $(LAB2DEMO_DIR)tools/compile_lut.py $(LAB2DEMO_DIR)
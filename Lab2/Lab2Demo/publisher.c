@@ -0,0 +1,397 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+
+/** @file
+ *
+ * MQTT publish pipeline: keeps the connection to the broker up and moves the sampler's
+ * readings to it without losing any.
+ *
+ * Up to 'window' messages are in flight at once, each tracked by its packet ID until the
+ * broker acknowledges it (PUBACK with QoS1, the send completing with QoS0), so throughput
+ * is no longer one message per round trip. Samples stay in the sampler until the message
+ * carrying them is acknowledged; messages in flight when the connection drops are simply
+ * sent again after reconnecting.
+ *
+ * While the link is down, each complete batch is encoded and written to the flash queue
+ * (flash_queue.c). The same happens while connected when the sampler is about to
+ * overflow, starting with the messages in flight, so readings waiting on a slow or dead
+ * link end up in flash rather than being dropped. After reconnecting the queue is drained
+ * first, a window at a time, then publishing carries on with the samples still in RAM, so
+ * the broker sees the readings in order. Connection attempts back off exponentially from
+ * PUBLISHER_MIN_BACKOFF up to PUBLISHER_MAX_BACKOFF, and a message left unacknowledged for
+ * PUBLISHER_ACK_TIMEOUT drops the connection, since it is the only sign of a link that
+ * died silently.
+ *
+ */
+
+#include "zos.h"
+#include "publisher.h"
+#include "sampler.h"
+#include "flash_queue.h"
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static publisher_config_t config;
+static publisher_context_t context;
+static uint16_t live_offset;                // samples in flight, counted from the oldest one in the sampler
+static uint8_t queue_inflight;              // flash queue messages in flight, always the oldest queued ones
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+zos_result_t publisher_start(const publisher_config_t *publisher_config)
+{
+    if(publisher_config->window == 0 || publisher_config->window > PUBLISHER_MAX_WINDOW ||
+       publisher_config->batch_samples == 0 || publisher_config->batch_samples > SAMPLER_RING_SIZE)
+    {
+        return ZOS_BADARG;
+    }
+
+    config = *publisher_config;
+    memset(&context, 0, sizeof(context));
+    live_offset = 0;
+    queue_inflight = 0;
+    flash_queue_init();
+
+    context.state = PUBLISHER_DISCONNECTED;
+    context.backoff = PUBLISHER_MIN_BACKOFF;
+
+    // The first connection attempt is made straight away
+    return zn_event_issue(connect_event_handler, NULL, 0);
+}
+
+/*************************************************************************************************/
+void publisher_stop(void)
+{
+    const publisher_state_t state = context.state;
+
+    zn_event_unregister(connect_event_handler, NULL);
+    zn_event_unregister(connect_timeout_event_handler, NULL);
+    zn_event_unregister(pump_event_handler, NULL);
+
+    context.state = PUBLISHER_STOPPED;
+    if(state == PUBLISHER_CONNECTING || state == PUBLISHER_CONNECTED)
+    {
+        config.disconnect();
+    }
+    clear_inflight();
+}
+
+/*************************************************************************************************/
+void publisher_connected(void)
+{
+    if(context.state != PUBLISHER_CONNECTING)
+    {
+        return;
+    }
+
+    zn_event_unregister(connect_timeout_event_handler, NULL);
+    context.state = PUBLISHER_CONNECTED;
+    context.backoff = PUBLISHER_MIN_BACKOFF;
+    ++context.connects;
+
+    pump();
+}
+
+/*************************************************************************************************/
+void publisher_disconnected(void)
+{
+    if(context.state == PUBLISHER_CONNECTING)
+    {
+        ++context.connect_failures;
+        schedule_reconnect();
+    }
+    else if(context.state == PUBLISHER_CONNECTED)
+    {
+        schedule_reconnect();
+    }
+}
+
+/*************************************************************************************************/
+void publisher_acked(uint16_t msgid)
+{
+    for(uint8_t i = 0; i < context.inflight_count; ++i)
+    {
+        if(context.inflight[i].msgid == msgid && !context.inflight[i].acked)
+        {
+            context.inflight[i].acked = ZOS_TRUE;
+            ++context.acked;
+            break;
+        }
+    }
+
+    // Retire in order, samples can only be released from the oldest end of the sampler
+    while(context.inflight_count > 0 && context.inflight[0].acked)
+    {
+        const publisher_inflight_t *done = &context.inflight[0];
+
+        if(done->slot == PUBLISHER_LIVE)
+        {
+            sampler_consume(done->samples);
+            live_offset -= done->samples;
+        }
+        else
+        {
+            flash_queue_remove(done->slot);
+            --queue_inflight;
+        }
+
+        --context.inflight_count;
+        memmove(&context.inflight[0], &context.inflight[1], context.inflight_count * sizeof(publisher_inflight_t));
+    }
+
+    pump();
+}
+
+/*************************************************************************************************/
+const publisher_context_t* publisher_get_context(void)
+{
+    return &context;
+}
+
+/******************************************************
+ *               Static Function Definitions
+ ******************************************************/
+static void connect_event_handler(void *arg)
+{
+    if(context.state != PUBLISHER_DISCONNECTED)
+    {
+        return;
+    }
+
+    context.state = PUBLISHER_CONNECTING;
+    if(config.connect() != ZOS_SUCCESS)
+    {
+        ++context.connect_failures;
+        schedule_reconnect();
+    }
+    else
+    {
+        zn_event_register_timed(connect_timeout_event_handler, NULL, PUBLISHER_CONNECT_TIMEOUT, 0);
+    }
+}
+
+/*************************************************************************************************/
+static void connect_timeout_event_handler(void *arg)
+{
+    if(context.state == PUBLISHER_CONNECTING)
+    {
+        ++context.connect_failures;
+        drop_connection();
+    }
+}
+
+/*************************************************************************************************/
+static void pump_event_handler(void *arg)
+{
+    pump();
+}
+
+/*************************************************************************************************/
+static void schedule_reconnect(void)
+{
+    zn_event_unregister(connect_timeout_event_handler, NULL);
+    clear_inflight();
+
+    context.state = PUBLISHER_DISCONNECTED;
+    zn_event_register_timed(connect_event_handler, NULL, context.backoff, 0);
+    context.backoff = MIN(context.backoff * 2, PUBLISHER_MAX_BACKOFF);
+
+    pump();
+}
+
+/*************************************************************************************************/
+static void drop_connection(void)
+{
+    // The state changes first, so a disconnected event raised by the disconnect is ignored
+    schedule_reconnect();
+    config.disconnect();
+}
+
+/*************************************************************************************************/
+static void clear_inflight(void)
+{
+    // Nothing is lost: samples are still in the sampler, messages still in the flash queue
+    context.requeued += context.inflight_count;
+    context.inflight_count = 0;
+    live_offset = 0;
+    queue_inflight = 0;
+}
+
+/*************************************************************************************************/
+static void pump(void)
+{
+    uint16_t ready;
+    uint32_t delay;
+
+    if(context.state == PUBLISHER_STOPPED)
+    {
+        return;
+    }
+
+    if(context.state == PUBLISHER_CONNECTED && context.inflight_count > 0 &&
+       zn_rtos_get_time() - context.inflight[0].sent_time >= PUBLISHER_ACK_TIMEOUT)
+    {
+        ++context.ack_timeouts;
+        drop_connection();
+        return;
+    }
+
+    while(context.state == PUBLISHER_CONNECTED && context.inflight_count < config.window && send_next())
+    {
+    }
+
+    // Offline every complete batch goes to flash. Online only when the sampler is about to
+    // overflow, e.g. while the flash queue is being drained or acknowledgements are slow
+    // to come; messages in flight then move to flash first, as they hold the oldest samples.
+    while(sampler_count() >= config.batch_samples &&
+          (context.state != PUBLISHER_CONNECTED || sampler_count() > SAMPLER_RING_SIZE - config.batch_samples) &&
+          ((live_offset > 0) ? evict() : spill()))
+    {
+    }
+
+    // Wake up when the next batch is complete, or to check on the oldest message in flight
+    ready = sampler_count() - live_offset;
+    delay = ((ready < config.batch_samples) ? config.batch_samples - ready : config.batch_samples) * SAMPLER_PERIOD;
+    if(context.state == PUBLISHER_CONNECTED && context.inflight_count > 0)
+    {
+        const uint32_t waited = zn_rtos_get_time() - context.inflight[0].sent_time;
+        delay = MIN(delay, PUBLISHER_ACK_TIMEOUT - MIN(waited, PUBLISHER_ACK_TIMEOUT));
+    }
+
+    zn_event_unregister(pump_event_handler, NULL);
+    zn_event_register_timed(pump_event_handler, NULL, delay, 0);
+}
+
+/*************************************************************************************************/
+static zos_bool_t send_next(void)
+{
+    uint32_t length;
+    uint16_t msgid;
+
+    // Queued messages are older than anything in the sampler, so they go first
+    if(queue_inflight < flash_queue_count())
+    {
+        uint8_t slot;
+
+        if(flash_queue_read(queue_inflight, config.buffer, config.buffer_size, &length, &slot) != ZOS_SUCCESS)
+        {
+            // The unreadable message was removed, carry on with the next one
+            return ZOS_TRUE;
+        }
+        else if((msgid = config.publish(config.buffer, length)) == 0)
+        {
+            return ZOS_FALSE;
+        }
+
+        add_inflight(msgid, slot, 0);
+        ++queue_inflight;
+    }
+    else
+    {
+        const uint16_t ready = sampler_count() - live_offset;
+        uint16_t samples;
+
+        if(ready < config.batch_samples)
+        {
+            return ZOS_FALSE;
+        }
+        else if((samples = config.encode(config.buffer, config.buffer_size, &length, live_offset, ready)) == 0)
+        {
+            return ZOS_FALSE;
+        }
+        else if((msgid = config.publish(config.buffer, length)) == 0)
+        {
+            return ZOS_FALSE;
+        }
+
+        add_inflight(msgid, PUBLISHER_LIVE, samples);
+        live_offset += samples;
+    }
+
+    return ZOS_TRUE;
+}
+
+/*************************************************************************************************/
+static void add_inflight(uint16_t msgid, uint8_t slot, uint16_t samples)
+{
+    publisher_inflight_t *entry = &context.inflight[context.inflight_count++];
+
+    entry->msgid = msgid;
+    entry->slot = slot;
+    entry->samples = samples;
+    entry->acked = ZOS_FALSE;
+    entry->sent_time = zn_rtos_get_time();
+    ++context.sent;
+}
+
+/*************************************************************************************************/
+static zos_bool_t spill(void)
+{
+    uint32_t length;
+    uint16_t samples;
+
+    // A full queue drops its oldest message, which must not be one in flight
+    if(flash_queue_count() == FLASH_QUEUE_SLOTS && queue_inflight > 0)
+    {
+        return ZOS_FALSE;
+    }
+    else if((samples = config.encode(config.buffer, config.buffer_size, &length, 0, config.batch_samples)) == 0)
+    {
+        return ZOS_FALSE;
+    }
+    else if(flash_queue_push(config.buffer, length, NULL) != ZOS_SUCCESS)
+    {
+        return ZOS_FALSE;
+    }
+
+    sampler_consume(samples);
+    ++context.spilled;
+
+    return ZOS_TRUE;
+}
+
+/*************************************************************************************************/
+static zos_bool_t evict(void)
+{
+    publisher_inflight_t *entry = context.inflight;
+    uint32_t length;
+    uint8_t slot;
+
+    // The oldest message in flight still holding samples in the sampler. Every queued
+    // message is already in flight ahead of it, so it becomes the newest queued one and
+    // keeps its place in the window: the order the broker sees does not change.
+    while(entry->slot != PUBLISHER_LIVE)
+    {
+        ++entry;
+    }
+
+    if(flash_queue_count() == FLASH_QUEUE_SLOTS && queue_inflight > 0)
+    {
+        return ZOS_FALSE;
+    }
+    else if(config.encode(config.buffer, config.buffer_size, &length, 0, entry->samples) != entry->samples)
+    {
+        return ZOS_FALSE;
+    }
+    else if(flash_queue_push(config.buffer, length, &slot) != ZOS_SUCCESS)
+    {
+        return ZOS_FALSE;
+    }
+
+    sampler_consume(entry->samples);
+    live_offset -= entry->samples;
+    entry->slot = slot;
+    entry->samples = 0;
+    ++queue_inflight;
+    ++context.spilled;
+
+    return ZOS_TRUE;
+}
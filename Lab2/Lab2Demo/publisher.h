@@ -0,0 +1,93 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+#pragma once
+
+
+#include "zos.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define PUBLISHER_MAX_WINDOW        8       // messages in flight at most
+#define PUBLISHER_CONNECT_TIMEOUT   15000   // ms for the broker to accept a connection
+#define PUBLISHER_ACK_TIMEOUT       10000   // ms for a message to be acknowledged before the link is considered dead
+#define PUBLISHER_MIN_BACKOFF       1000    // ms before the first reconnect attempt, doubled on each failure
+#define PUBLISHER_MAX_BACKOFF       60000   // ms
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+typedef enum
+{
+    PUBLISHER_STOPPED,
+    PUBLISHER_DISCONNECTED,                 // waiting to reconnect
+    PUBLISHER_CONNECTING,
+    PUBLISHER_CONNECTED
+} publisher_state_t;
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+/* Encode up to 'count' samples, starting 'first' samples past the oldest one in the sampler,
+ * into one message. Returns the number of samples encoded. */
+typedef uint16_t (*publisher_encode_t)(uint8_t *buffer, uint32_t size, uint32_t *length, uint16_t first, uint16_t count);
+
+/* Returns the message's packet ID, 0 if it could not be sent */
+typedef uint16_t (*publisher_publish_t)(const uint8_t *data, uint32_t length);
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    uint8_t window;                         // messages in flight at once, 1 to PUBLISHER_MAX_WINDOW
+    uint16_t batch_samples;                 // samples per message
+    uint8_t *buffer;                        // message buffer
+    uint32_t buffer_size;
+    zos_result_t (*connect)(void);          // start connecting, report the outcome with publisher_connected()/_disconnected()
+    void (*disconnect)(void);
+    publisher_publish_t publish;
+    publisher_encode_t encode;
+} publisher_config_t;
+
+typedef struct
+{
+    uint16_t msgid;
+    uint8_t slot;                           // flash queue slot, or PUBLISHER_LIVE for samples still in the sampler
+    uint16_t samples;                       // samples sent from the sampler
+    zos_bool_t acked;
+    uint32_t sent_time;
+} publisher_inflight_t;
+
+#define PUBLISHER_LIVE              0xFF
+
+typedef struct
+{
+    publisher_state_t state;
+    uint32_t backoff;                       // ms before the next reconnect attempt
+    publisher_inflight_t inflight[PUBLISHER_MAX_WINDOW];
+    uint8_t inflight_count;
+    uint32_t sent;                          // messages
+    uint32_t acked;
+    uint32_t requeued;                      // in flight when the connection dropped, sent again later
+    uint32_t spilled;                       // messages written to the flash queue
+    uint32_t connects;                      // successful connections
+    uint32_t connect_failures;
+    uint32_t ack_timeouts;
+} publisher_context_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+zos_result_t publisher_start(const publisher_config_t *config);
+void publisher_stop(void);
+void publisher_connected(void);
+void publisher_disconnected(void);
+void publisher_acked(uint16_t msgid);
+const publisher_context_t* publisher_get_context(void);
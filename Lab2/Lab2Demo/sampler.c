@@ -0,0 +1,170 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+
+/** @file
+ *
+ * Samples the accelerometer, magnetometer and gyroscope at the accelerometer's output
+ * data rate into a ring buffer, independently of when the readings are published.
+ *
+ * The sensors are polled at twice their rate and a sample is only taken when the
+ * accelerometer reports new data, so every output of the sensor is kept exactly once.
+ * The publisher reads the oldest samples with sampler_peek() and releases them with
+ * sampler_consume() once they are delivered. When it falls behind by more than the ring
+ * holds, new samples are discarded and counted as dropped: the ones already handed out
+ * stay where they are until consumed.
+ *
+ */
+
+#include "zos.h"
+#include "sampler.h"
+#include "sensor.h"
+#include "accelerometer.h"
+#include "gyroscope.h"
+#include "magnetometer.h"
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static sampler_sample_t ring[SAMPLER_RING_SIZE];
+static uint16_t head;                       // index of the oldest sample
+static uint16_t count;
+static sampler_sample_t latest;             // readings as of the last poll
+static sampler_stats_t stats;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+zos_result_t sampler_start(void)
+{
+    head = 0;
+    count = 0;
+    memset(&latest, 0, sizeof(latest));
+    memset(&stats, 0, sizeof(stats));
+
+    return zn_event_register_periodic(poll_event_handler, NULL, SAMPLER_POLL_PERIOD, 0);
+}
+
+/*************************************************************************************************/
+void sampler_stop(void)
+{
+    zn_event_unregister(poll_event_handler, NULL);
+}
+
+/*************************************************************************************************/
+uint16_t sampler_count(void)
+{
+    return count;
+}
+
+/*************************************************************************************************/
+/*
+ * Sample 'index' counting from the oldest one not yet consumed
+ */
+const sampler_sample_t* sampler_peek(uint16_t index)
+{
+    return (index < count) ? &ring[(head + index) % SAMPLER_RING_SIZE] : NULL;
+}
+
+/*************************************************************************************************/
+void sampler_consume(uint16_t consumed)
+{
+    consumed = MIN(consumed, count);
+    head = (head + consumed) % SAMPLER_RING_SIZE;
+    count -= consumed;
+}
+
+/*************************************************************************************************/
+const sampler_stats_t* sampler_get_stats(void)
+{
+    return &stats;
+}
+
+/******************************************************
+ *               Static Function Definitions
+ ******************************************************/
+static void poll_event_handler(void *arg)
+{
+    // The magnetometer and gyroscope are only read when they have something new, their
+    // previous values are carried into the sample otherwise
+    if(read_sensor(SENSOR_MAGNETOMETER))
+    {
+        magnetometer_data_t data;
+        if(sensor_get_data(SENSOR_MAGNETOMETER, &data) == ZOS_SUCCESS)
+        {
+            set_axes(latest.magn, data.x, data.y, data.z);
+        }
+        else
+        {
+            ++stats.errors;
+        }
+    }
+
+    if(read_sensor(SENSOR_GYROSCOPE))
+    {
+        gyroscope_data_t data;
+        if(sensor_get_data(SENSOR_GYROSCOPE, &data) == ZOS_SUCCESS)
+        {
+            set_axes(latest.gyro, data.x, data.y, data.z);
+        }
+        else
+        {
+            ++stats.errors;
+        }
+    }
+
+    if(read_sensor(SENSOR_ACCELEROMETER))
+    {
+        accelerometer_data_t data;
+        if(sensor_get_data(SENSOR_ACCELEROMETER, &data) == ZOS_SUCCESS)
+        {
+            set_axes(latest.accel, data.x, data.y, data.z);
+            push_sample(&latest);
+        }
+        else
+        {
+            ++stats.errors;
+        }
+    }
+}
+
+/*************************************************************************************************/
+static zos_bool_t read_sensor(sensor_type_t sensor)
+{
+    zos_bool_t has_data = ZOS_FALSE;
+
+    if(sensor_has_new_data(sensor, &has_data) != ZOS_SUCCESS)
+    {
+        ++stats.errors;
+        return ZOS_FALSE;
+    }
+
+    return has_data;
+}
+
+/*************************************************************************************************/
+static void set_axes(int16_t *axes, int32_t x, int32_t y, int32_t z)
+{
+    axes[0] = (int16_t)x;
+    axes[1] = (int16_t)y;
+    axes[2] = (int16_t)z;
+}
+
+/*************************************************************************************************/
+static void push_sample(const sampler_sample_t *sample)
+{
+    if(count == SAMPLER_RING_SIZE)
+    {
+        ++stats.dropped;
+        return;
+    }
+
+    ring[(head + count) % SAMPLER_RING_SIZE] = *sample;
+    ++count;
+    ++stats.samples;
+}
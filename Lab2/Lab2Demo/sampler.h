@@ -0,0 +1,48 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+#pragma once
+
+
+#include "zos.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define SAMPLER_PERIOD              20      // ms between samples, the accelerometer's 50Hz output data rate
+#define SAMPLER_POLL_PERIOD         10      // ms, sensors are polled at twice their rate so no sample is missed
+#define SAMPLER_RING_SIZE           256     // samples kept while waiting to be published, ~5s
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+/* One reading of all three sensors, taken each time the accelerometer has new data.
+ * Magnetometer and gyroscope hold their last value between their own updates. */
+typedef struct
+{
+    int16_t accel[3];                       // mG
+    int16_t magn[3];                        // uT
+    int16_t gyro[3];                        // deg/sec
+} sampler_sample_t;
+
+typedef struct
+{
+    uint32_t samples;                       // taken since sampler_start()
+    uint32_t dropped;                       // discarded because the ring was full
+    uint32_t errors;                        // failed sensor reads
+} sampler_stats_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+zos_result_t sampler_start(void);
+void sampler_stop(void);
+uint16_t sampler_count(void);
+const sampler_sample_t* sampler_peek(uint16_t index);
+void sampler_consume(uint16_t count);
+const sampler_stats_t* sampler_get_stats(void);
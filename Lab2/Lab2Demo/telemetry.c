@@ -0,0 +1,298 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+
+/** @file
+ *
+ * Encodes a batch of samples from the sampler into one MQTT message.
+ *
+ * The samples go into a single flat array "S", nine values per sample (AX AY AZ MX MY MZ
+ * GX GY GZ). The first sample is absolute, every following one holds the difference to
+ * the sample before it, which keeps the numbers short since the sensors move little
+ * between two readings 20ms apart. "n" is the sample count and "dt" the sample period
+ * in ms. The latest absolute readings, RSSI and light level follow under the keys the
+ * single reading messages used, so the Quickstart charts keep working. "Light_Level" is
+ * the light reading converted with the lookup table (see light.c), null when the ADC
+ * could not be read:
+ *
+ *   {"d":{"dt":20,"S":[12,-3,1016,...,0,1,-2,...],"n":50,"AX":14,...,"GZ":-1,"RSSI":"-52","Light_Sense":"1234","Light_Level":27}}
+ *
+ * TELEMETRY_FORMAT_CBOR carries the same map as CBOR (RFC 7049), with "S" as an indefinite
+ * length array, at roughly half the size of the JSON.
+ *
+ * Values are written straight into the message buffer, without sprintf(). As many samples
+ * are taken as are guaranteed to fit, the rest stay in the sampler for the next message.
+ *
+ */
+
+#include "zos.h"
+#include "telemetry.h"
+#include "sampler.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define JSON_SAMPLE_SIZE            (9 * 7) // worst case, 9 x "-65535,"
+#define CBOR_SAMPLE_SIZE            (9 * 3) // worst case, 9 x a 16 bit integer
+
+#define CBOR_UNSIGNED               (0 << 5)
+#define CBOR_NEGATIVE               (1 << 5)
+#define CBOR_TEXT                   (3 << 5)
+#define CBOR_MAP                    (5 << 5)
+#define CBOR_ARRAY_INDEFINITE       0x9F
+#define CBOR_NULL                   0xF6
+#define CBOR_BREAK                  0xFF
+
+#define CBOR_DATA_MAP_SIZE          15      // dt, S, n, the 9 latest readings, RSSI, Light_Sense and Light_Level
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static const char* const reading_keys[9] =
+{
+    "AX", "AY", "AZ", "MX", "MY", "MZ", "GX", "GY", "GZ"
+};
+
+static uint8_t format;
+static uint8_t *out;
+static uint32_t out_length;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/*
+ * Encodes up to 'max_samples' samples, starting 'first' samples past the oldest one in the
+ * sampler. Returns the number of samples encoded, and the message size in 'length'.
+ */
+uint16_t telemetry_encode(uint8_t encode_format, uint8_t *buffer, uint32_t size, uint32_t *length,
+                          uint16_t first, uint16_t max_samples, const char *rssi, const light_reading_t *light)
+{
+    const uint32_t sample_size = (encode_format == TELEMETRY_FORMAT_CBOR) ? CBOR_SAMPLE_SIZE : JSON_SAMPLE_SIZE;
+    char light_sense[12];
+    int16_t previous[9];
+    uint16_t n = 0;
+
+    *length = 0;
+    if(size < 32 + TELEMETRY_TRAILER_SIZE)
+    {
+        return 0;
+    }
+
+    format = encode_format;
+    out = buffer;
+    out_length = 0;
+
+    if(format == TELEMETRY_FORMAT_CBOR)
+    {
+        put_byte(CBOR_MAP | 1);
+        put_key("d");
+        put_byte(CBOR_MAP | CBOR_DATA_MAP_SIZE);
+    }
+    else
+    {
+        put_raw("{\"d\":{", 6);
+    }
+
+    put_key("dt");
+    put_int(SAMPLER_PERIOD);
+    put_key("S");
+    put_byte((format == TELEMETRY_FORMAT_CBOR) ? CBOR_ARRAY_INDEFINITE : '[');
+
+    for(; n < max_samples && out_length + sample_size + TELEMETRY_TRAILER_SIZE <= size; ++n)
+    {
+        const sampler_sample_t *sample = sampler_peek(first + n);
+        int16_t values[9];
+
+        if(sample == NULL)
+        {
+            break;
+        }
+
+        get_values(sample, values);
+        for(uint8_t i = 0; i < 9; ++i)
+        {
+            if(format == TELEMETRY_FORMAT_JSON && (n > 0 || i > 0))
+            {
+                put_byte(',');
+            }
+            put_int((n > 0) ? (int32_t)values[i] - previous[i] : values[i]);
+        }
+        memcpy(previous, values, sizeof(previous));
+    }
+
+    put_byte((format == TELEMETRY_FORMAT_CBOR) ? CBOR_BREAK : ']');
+    put_key("n");
+    put_int(n);
+
+    for(uint8_t i = 0; i < 9; ++i)
+    {
+        put_key(reading_keys[i]);
+        put_int((n > 0) ? previous[i] : 0);
+    }
+
+    put_key("RSSI");
+    put_string(rssi);
+    put_key("Light_Sense");
+    put_string((light != NULL) ? int_to_str(light->sense, light_sense) : NULL);
+    put_key("Light_Level");
+    if(light != NULL)
+    {
+        put_int(light->level);
+    }
+    else if(format == TELEMETRY_FORMAT_CBOR)
+    {
+        put_byte(CBOR_NULL);
+    }
+    else
+    {
+        put_raw("null", 4);
+    }
+
+    if(format == TELEMETRY_FORMAT_JSON)
+    {
+        put_raw("}}", 2);
+    }
+
+    *length = out_length;
+
+    return n;
+}
+
+/******************************************************
+ *               Static Function Definitions
+ ******************************************************/
+static void get_values(const sampler_sample_t *sample, int16_t *values)
+{
+    memcpy(&values[0], sample->accel, sizeof(sample->accel));
+    memcpy(&values[3], sample->magn, sizeof(sample->magn));
+    memcpy(&values[6], sample->gyro, sizeof(sample->gyro));
+}
+
+/*************************************************************************************************/
+static void put_byte(uint8_t byte)
+{
+    out[out_length++] = byte;
+}
+
+/*************************************************************************************************/
+static void put_raw(const void *data, uint32_t size)
+{
+    memcpy(&out[out_length], data, size);
+    out_length += size;
+}
+
+/*************************************************************************************************/
+static void put_cbor_head(uint8_t major, uint32_t value)
+{
+    if(value < 24)
+    {
+        put_byte(major | value);
+    }
+    else if(value <= 0xFF)
+    {
+        put_byte(major | 24);
+        put_byte(value);
+    }
+    else if(value <= 0xFFFF)
+    {
+        put_byte(major | 25);
+        put_byte(value >> 8);
+        put_byte(value);
+    }
+    else
+    {
+        put_byte(major | 26);
+        put_byte(value >> 24);
+        put_byte(value >> 16);
+        put_byte(value >> 8);
+        put_byte(value);
+    }
+}
+
+/*************************************************************************************************/
+static void put_int(int32_t value)
+{
+    if(format == TELEMETRY_FORMAT_CBOR)
+    {
+        // CBOR negative integers store -1 - value
+        put_cbor_head((value < 0) ? CBOR_NEGATIVE : CBOR_UNSIGNED, (value < 0) ? (uint32_t)(-1 - value) : (uint32_t)value);
+    }
+    else
+    {
+        char digits[10];
+        uint8_t count = 0;
+        uint32_t magnitude = (value < 0) ? (uint32_t)0 - (uint32_t)value : (uint32_t)value;
+
+        if(value < 0)
+        {
+            put_byte('-');
+        }
+        do
+        {
+            digits[count++] = '0' + (magnitude % 10);
+            magnitude /= 10;
+        } while(magnitude > 0);
+
+        while(count > 0)
+        {
+            put_byte(digits[--count]);
+        }
+    }
+}
+
+/*************************************************************************************************/
+static void put_string(const char *str)
+{
+    // RSSI and light sense are numbers as text (e.g. command output with a trailing line
+    // break), anything but the number is dropped rather than escaped
+    char text[TELEMETRY_MAX_STRING];
+    uint32_t len = 0;
+
+    for(; str != NULL && *str != 0 && len < sizeof(text); ++str)
+    {
+        if((*str >= '0' && *str <= '9') || *str == '-' || *str == '.')
+        {
+            text[len++] = *str;
+        }
+    }
+
+    if(format == TELEMETRY_FORMAT_CBOR)
+    {
+        put_cbor_head(CBOR_TEXT, len);
+        put_raw(text, len);
+    }
+    else
+    {
+        put_byte('"');
+        put_raw(text, len);
+        put_byte('"');
+    }
+}
+
+/*************************************************************************************************/
+static void put_key(const char *key)
+{
+    const uint32_t len = strlen(key);
+
+    if(format == TELEMETRY_FORMAT_CBOR)
+    {
+        put_cbor_head(CBOR_TEXT, len);
+        put_raw(key, len);
+    }
+    else
+    {
+        // Every key but the first in a map follows a value
+        if(out[out_length - 1] != '{')
+        {
+            put_byte(',');
+        }
+        put_byte('"');
+        put_raw(key, len);
+        put_raw("\":", 2);
+    }
+}
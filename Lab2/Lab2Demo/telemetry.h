@@ -0,0 +1,28 @@
+/*
+ * ZentriOS SDK LICENSE AGREEMENT | Zentri.com, 2016.
+ *
+ * Use of source code and/or libraries contained in the ZentriOS SDK is
+ * subject to the Zentri Operating System SDK license agreement and
+ * applicable open source license agreements.
+ *
+ */
+#pragma once
+
+
+#include "zos.h"
+#include "light.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define TELEMETRY_FORMAT_JSON       0
+#define TELEMETRY_FORMAT_CBOR       1
+
+#define TELEMETRY_TRAILER_SIZE      224     // worst case bytes after the sample array: latest readings, RSSI, light
+#define TELEMETRY_MAX_STRING        15      // longest RSSI string kept
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+uint16_t telemetry_encode(uint8_t format, uint8_t *buffer, uint32_t size, uint32_t *length,
+                          uint16_t first, uint16_t max_samples, const char *rssi, const light_reading_t *light);
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+Pre-build step for the Lab2Demo app (see PRE_BUILD_TARGETS in Lab2Demo.mk).
+
+Compiles the ADC lookup tables resources/lut_<name>.csv into build/generated/adc_lut.h,
+one constant array adc_lut_<name>[] of light_lut_point_t (see light.h) per file, so the
+firmware converts readings from flash without loading and parsing the CSV at run time.
+
+The CSV is the one zn_adc_add_lut() takes: one 'adc,value' pair per line, ADC readings in
+increasing order. light.c interpolates linearly between consecutive points.
+
+The header is only rewritten when its content changes, so an unchanged table does not
+trigger a rebuild.
+
+    python3 tools/compile_lut.py [project_dir]
+"""
+
+import glob
+import os
+import re
+import sys
+
+
+GENERATED_HEADER = 'build/generated/adc_lut.h'
+
+
+def load_csv(path):
+    points = []
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            try:
+                adc, value = (int(field) for field in line.split(','))
+            except ValueError:
+                sys.exit('%s:%d: expected "adc,value", got "%s"' % (path, number, line))
+            if not 0 <= adc <= 0xFFFF or not -0x8000 <= value <= 0x7FFF:
+                sys.exit('%s:%d: point out of range' % (path, number))
+            if points and adc <= points[-1][0]:
+                sys.exit('%s:%d: ADC readings must increase' % (path, number))
+            points.append((adc, value))
+
+    if len(points) < 2:
+        sys.exit('%s: at least two points are needed' % path)
+    return points
+
+
+def generate(project_dir):
+    lines = [
+        '/*',
+        ' * Generated by tools/compile_lut.py from resources/lut_*.csv, do not edit.',
+        ' */',
+        '#pragma once',
+        '',
+        '#include "light.h"',
+    ]
+
+    for path in sorted(glob.glob(os.path.join(project_dir, 'resources', 'lut_*.csv'))):
+        name = re.sub(r'\W', '_', os.path.basename(path)[:-len('.csv')])
+        points = load_csv(path)
+        lines += ['', '', 'static const light_lut_point_t adc_%s[%d] =' % (name, len(points)), '{']
+        lines += ['    { %4d, %4d },' % point for point in points]
+        lines += ['};']
+
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    project_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    header = os.path.join(project_dir, GENERATED_HEADER)
+    content = generate(project_dir)
+
+    if os.path.exists(header):
+        with open(header) as f:
+            if f.read() == content:
+                return
+
+    if not os.path.isdir(os.path.dirname(header)):
+        os.makedirs(os.path.dirname(header))
+    with open(header, 'w') as f:
+        f.write(content)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,303 @@
+/*
+ * Streamed playback of pre-compiled animations (.anim files, see tools/compile_animations.py).
+ *
+ * Frames are decoded straight from the file system a chunk at a time: the only RAM held is
+ * the current frame's columns and one read buffer, however long the animation. Each frame
+ * is either a PackBits compressed key frame, a list of column runs that changed since the
+ * previous frame, or a repeat of it, so a frame tick usually reads a few bytes and the
+ * display then writes only the panels and rows that changed.
+ *
+ * Playback runs off a periodic event at the animation's frame time and hands each frame to
+ * display_draw(). It stops by itself when the display is given new text.
+ */
+
+#include "zos.h"
+#include "animation.h"
+#include "stats.h"
+
+
+#define ANIMATION_MAGIC             "LMA1"
+#define ANIMATION_HEADER_SIZE       16
+#define ANIMATION_FLAG_LOOP         (1 << 0)
+
+#define ANIMATION_FRAME_KEY         0
+#define ANIMATION_FRAME_DELTA       1
+#define ANIMATION_FRAME_REPEAT      2
+
+
+static animation_context_t context;
+static uint8_t image[ANIMATION_MAX_WIDTH];
+static uint32_t text_version;           // display text version when playback started
+
+STATS_EVENT_HANDLER(frame_event_handler)
+
+static struct
+{
+    uint32_t handle;
+    uint8_t buffer[ANIMATION_READ_CHUNK];
+    uint8_t length;
+    uint8_t position;
+} reader;
+
+
+/*************************************************************************************************/
+zos_result_t animation_play(const char *name)
+{
+    zos_result_t result;
+
+    animation_stop();
+
+    // With no file open, the next frame is the first one
+    strncpy(context.file, name, sizeof(context.file) - 1);
+    if(!ZOS_FAILED(result, show_next_frame()))
+    {
+        text_version = display_get_context()->modified.text;
+        result = zn_event_register_periodic(frame_event_handler_counted, NULL, context.frame_time, 0);
+    }
+
+    if(result != ZOS_SUCCESS)
+    {
+        animation_stop();
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+void animation_stop(void)
+{
+    zn_event_unregister(frame_event_handler_counted, NULL);
+    close_animation();
+    memset(&context, 0, sizeof(context));
+}
+
+/*************************************************************************************************/
+/*
+ * Stop playback and give the panel back to the message the animation was covering
+ */
+void animation_cancel(void)
+{
+    // The snapshot the message comes from is left as it is, the update publishes a new one
+    const display_context_t *display = display_get_context();
+
+    animation_stop();
+    if(display->file[0] != 0)
+    {
+        display_set_file(display->file);
+    }
+    else
+    {
+        display_set_text(display->text);
+    }
+}
+
+/*************************************************************************************************/
+const animation_context_t* animation_get_context(void)
+{
+    return &context;
+}
+
+/*************************************************************************************************/
+static void frame_event_handler(void *arg)
+{
+    // New text on the display supersedes the animation
+    if(display_get_context()->modified.text != text_version)
+    {
+        animation_stop();
+    }
+    else if(context.frame + 1 == context.frame_count && !context.loop)
+    {
+        // Leave the last frame on the panel
+        zn_event_unregister(frame_event_handler_counted, NULL);
+        close_animation();
+    }
+    else if(show_next_frame() != ZOS_SUCCESS)
+    {
+        ZOS_LOG("Animation %s is corrupt", context.file);
+        animation_cancel();
+    }
+}
+
+/*************************************************************************************************/
+static zos_result_t show_next_frame(void)
+{
+    zos_result_t result;
+
+    if(reader.handle != 0 && context.frame + 1 < context.frame_count)
+    {
+        ++context.frame;
+    }
+    else if(ZOS_FAILED(result, open_animation()))
+    {
+        return result;
+    }
+    else
+    {
+        // Back to the first frame, which is always a key frame. There is no seek, so the
+        // file is opened again.
+        if(context.frame != 0)
+        {
+            ++context.loops;
+        }
+        context.frame = 0;
+    }
+
+    if(ZOS_FAILED(result, decode_frame()))
+    {
+        return result;
+    }
+
+    return display_draw(image, context.width);
+}
+
+/*************************************************************************************************/
+static zos_result_t open_animation(void)
+{
+    zos_result_t result;
+    uint8_t header[ANIMATION_HEADER_SIZE];
+
+    close_animation();
+
+    if(ZOS_FAILED(result, zn_file_open(context.file, &reader.handle)))
+    {
+        reader.handle = 0;
+        return result;
+    }
+    else if(!read_bytes(header, sizeof(header)) || memcmp(header, ANIMATION_MAGIC, 4) != 0 ||
+            header[6] != DISPLAY_HEIGHT)
+    {
+        return ZOS_ERROR;
+    }
+
+    context.width = header[4] | (header[5] << 8);
+    context.loop = (header[7] & ANIMATION_FLAG_LOOP) ? ZOS_TRUE : ZOS_FALSE;
+    context.frame_count = header[8] | (header[9] << 8);
+    context.frame_time = header[10] | (header[11] << 8);
+
+    if(context.width == 0 || context.width > ANIMATION_MAX_WIDTH || context.frame_count == 0 || context.frame_time == 0)
+    {
+        return ZOS_ERROR;
+    }
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+static void close_animation(void)
+{
+    if(reader.handle != 0)
+    {
+        zn_file_close(reader.handle);
+    }
+    memset(&reader, 0, sizeof(reader));
+}
+
+/*************************************************************************************************/
+static zos_result_t decode_frame(void)
+{
+    uint8_t header[3];
+    uint16_t length;
+    uint16_t x = 0;
+
+    if(!read_bytes(header, sizeof(header)))
+    {
+        return ZOS_ERROR;
+    }
+    length = header[1] | (header[2] << 8);
+
+    // Every run is checked against the frame width, so a corrupt file can not write past image[]
+    if(header[0] == ANIMATION_FRAME_KEY)
+    {
+        while(length > 0)
+        {
+            uint8_t control[2];
+
+            if(!read_bytes(control, 1))
+            {
+                return ZOS_ERROR;
+            }
+            else if(control[0] < 128)
+            {
+                const uint8_t count = control[0] + 1;
+
+                if(length < 1 + count || x + count > context.width || !read_bytes(&image[x], count))
+                {
+                    return ZOS_ERROR;
+                }
+                x += count;
+                length -= 1 + count;
+            }
+            else
+            {
+                const uint8_t count = control[0] - 125;
+
+                if(length < 2 || x + count > context.width || !read_bytes(&control[1], 1))
+                {
+                    return ZOS_ERROR;
+                }
+                memset(&image[x], control[1], count);
+                x += count;
+                length -= 2;
+            }
+        }
+
+        return (x == context.width) ? ZOS_SUCCESS : ZOS_ERROR;
+    }
+    else if(header[0] == ANIMATION_FRAME_DELTA)
+    {
+        while(length > 0)
+        {
+            uint8_t run[2];                 // columns skipped, columns changed
+
+            if(length < 2 || !read_bytes(run, sizeof(run)))
+            {
+                return ZOS_ERROR;
+            }
+            x += run[0];
+            if(length < 2 + run[1] || x + run[1] > context.width || !read_bytes(&image[x], run[1]))
+            {
+                return ZOS_ERROR;
+            }
+            x += run[1];
+            length -= 2 + run[1];
+        }
+
+        return ZOS_SUCCESS;
+    }
+    else if(header[0] == ANIMATION_FRAME_REPEAT)
+    {
+        return (length == 0) ? ZOS_SUCCESS : ZOS_ERROR;
+    }
+
+    return ZOS_ERROR;
+}
+
+/*************************************************************************************************/
+static zos_bool_t read_bytes(uint8_t *data, uint16_t count)
+{
+    while(count > 0)
+    {
+        uint8_t available = reader.length - reader.position;
+
+        if(available == 0)
+        {
+            uint32_t bytes_read;
+
+            if(zn_file_read(reader.handle, reader.buffer, sizeof(reader.buffer), &bytes_read) != ZOS_SUCCESS || bytes_read == 0)
+            {
+                return ZOS_FALSE;
+            }
+            reader.length = bytes_read;
+            reader.position = 0;
+            available = bytes_read;
+        }
+
+        available = MIN(available, count);
+        memcpy(data, &reader.buffer[reader.position], available);
+        reader.position += available;
+        data += available;
+        count -= available;
+    }
+
+    return ZOS_TRUE;
+}
@@ -0,0 +1,28 @@
+/*
+ * Streamed playback of pre-compiled animations (.anim files, see tools/compile_animations.py).
+ */
+#pragma once
+
+#include "zos.h"
+#include "display.h"
+
+
+#define ANIMATION_MAX_WIDTH         255     // columns per frame, the format stores it in a byte wide field
+#define ANIMATION_READ_CHUNK        64      // bytes read from the file at a time
+
+typedef struct
+{
+    char file[DISPLAY_MAX_FILENAME];        // animation on the panel, empty when stopped
+    uint16_t width;                         // columns per frame
+    uint16_t frame_count;
+    uint16_t frame_time;                    // ms per frame
+    zos_bool_t loop;
+    uint16_t frame;                         // index of the frame on the panel
+    uint32_t loops;                         // times playback wrapped back to the first frame
+} animation_context_t;
+
+
+zos_result_t animation_play(const char *name);
+void animation_stop(void);
+void animation_cancel(void);
+const animation_context_t* animation_get_context(void);
@@ -0,0 +1,91 @@
+/*
+ * Boot phase timing.
+ *
+ * zn_app_init() brings the app up in phases, ordered so the panel shows something useful
+ * first: the display, then the persisted or cached message, then the settings and pages,
+ * and the network last, which joins in the background and finishes long after init has
+ * returned. Each phase records when it started, counted from power-on (zn_rtos_get_time()
+ * starts with the RTOS), and how long it took, to the microsecond for the short ones.
+ * The 'boot' console command prints them, and they are logged once the network is up.
+ */
+
+#include "zos.h"
+#include "boot.h"
+#include "stats.h"
+
+
+static boot_context_t context;
+
+static const char* const phase_names[BOOT_PHASE_COUNT] =
+{
+    [BOOT_PHASE_DISPLAY]        = "display",
+    [BOOT_PHASE_FIRST_FRAME]    = "first_frame",
+    [BOOT_PHASE_SERVICES]       = "services",
+    [BOOT_PHASE_NETWORK]        = "network",
+};
+
+
+/*************************************************************************************************/
+void boot_begin(boot_phase_t phase)
+{
+    boot_phase_record_t *record = &context.phases[phase];
+
+    memset(record, 0, sizeof(boot_phase_record_t));
+    record->state = BOOT_STATE_RUNNING;
+    record->start = zn_rtos_get_time();
+    record->start_us = stats_time_us();
+}
+
+/*************************************************************************************************/
+void boot_end(boot_phase_t phase, zos_result_t result)
+{
+    boot_phase_record_t *record = &context.phases[phase];
+
+    if(record->state == BOOT_STATE_RUNNING)
+    {
+        // A phase spanning more than a tick or two (the network) is timed in whole ms, the
+        // cycle counter only resolves the short ones
+        const uint32_t elapsed = zn_rtos_get_time() - record->start;
+
+        record->duration_us = (elapsed > 2) ? elapsed * 1000 : stats_time_us() - record->start_us;
+        record->result = result;
+        record->state = BOOT_STATE_DONE;
+    }
+}
+
+/*************************************************************************************************/
+void boot_print(void)
+{
+    const boot_phase_record_t *first_frame = &context.phases[BOOT_PHASE_FIRST_FRAME];
+
+    for(uint8_t i = 0; i < BOOT_PHASE_COUNT; ++i)
+    {
+        const boot_phase_record_t *record = &context.phases[i];
+
+        if(record->state == BOOT_STATE_DONE)
+        {
+            ZOS_LOG("%-12s start %7lums  took %10luus  result %d", phase_names[i], (unsigned long)record->start,
+                    (unsigned long)record->duration_us, record->result);
+        }
+        else if(record->state == BOOT_STATE_RUNNING)
+        {
+            ZOS_LOG("%-12s start %7lums  running", phase_names[i], (unsigned long)record->start);
+        }
+        else
+        {
+            ZOS_LOG("%-12s not started", phase_names[i]);
+        }
+    }
+
+    if(first_frame->state == BOOT_STATE_DONE)
+    {
+        ZOS_LOG("First frame on the panel %lums after power-on",
+                (unsigned long)(first_frame->start + first_frame->duration_us / 1000));
+    }
+}
+
+/*************************************************************************************************/
+const boot_context_t* boot_get_context(void)
+{
+    return &context;
+}
@@ -0,0 +1,43 @@
+/*
+ * Boot phase timing, printed by the 'boot' console command.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+typedef enum
+{
+    BOOT_PHASE_DISPLAY,                     // panels initialised
+    BOOT_PHASE_FIRST_FRAME,                 // persisted or cached message on the panel
+    BOOT_PHASE_SERVICES,                    // settings loaded, HTTP pages and commands registered
+    BOOT_PHASE_NETWORK,                     // from the join starting until the link is up
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+typedef enum
+{
+    BOOT_STATE_PENDING,
+    BOOT_STATE_RUNNING,
+    BOOT_STATE_DONE
+} boot_state_t;
+
+typedef struct
+{
+    boot_state_t state;
+    uint32_t start;                         // ms since power-on
+    uint32_t start_us;                      // stats_time_us() at the start
+    uint32_t duration_us;
+    zos_result_t result;
+} boot_phase_record_t;
+
+typedef struct
+{
+    boot_phase_record_t phases[BOOT_PHASE_COUNT];
+} boot_context_t;
+
+
+void boot_begin(boot_phase_t phase);
+void boot_end(boot_phase_t phase, zos_result_t result);
+void boot_print(void);
+const boot_context_t* boot_get_context(void);
@@ -0,0 +1,791 @@
+/*
+ * Scrolling text display engine for a row of 8x8 LED matrix panels.
+ *
+ * The panels form one virtual framebuffer, 8 columns per panel, each panel at its own I2C
+ * address (and bus, if the 8 HT16K33 addresses are not enough). display_set_text() renders
+ * the whole message once into a packed column bitmap (one byte per column). Each scroll
+ * tick then only slides the window over that bitmap: the rows of the previous frame are
+ * shifted by one column across all panels and the single new column is shifted in on the
+ * right. Frames are double-buffered per panel, and each tick writes only the panels whose
+ * content changed, and only the span of their rows that did.
+ *
+ * Messages longer than the column cache (display_set_file()) are streamed: the cache becomes
+ * a ring that is refilled a chunk at a time from the file, just ahead of the scroll window,
+ * and the file is read again from the start when the message wraps around.
+ *
+ * display_draw() shows a still image instead (e.g. an animation frame, see animation.c) and
+ * holds the scroll until the next text update takes the panel back.
+ *
+ * display_update() only records the new target state; the panel is brought in line by a
+ * single commit at the next frame tick. A burst of updates (e.g. a dragged slider) thus
+ * costs one render and one set of I2C writes per frame, and superseded values never reach
+ * the panel at all.
+ *
+ * The display runs tickless on a single one-shot timer, armed for whichever comes first of
+ * the pending commit and the next scroll step; a commit due within a frame of a step is made
+ * by that step's wakeup. Nothing is armed while nothing moves: a message that fits the
+ * panel is shown still and centred, a display_draw() image holds the scroll, and a scroll
+ * rate of 0 stops it. Blinking is done by the HT16K33s themselves and costs no wakeups.
+ *
+ * The state is published as snapshots: display_update() composes the next one from the
+ * current one, then makes it current with a single atomic pointer store, so a reader sees
+ * text, brightness, blink and scroll rate of one version together. Every change is made on
+ * the app's event thread, so a snapshot taken there with display_get_context() stays as it
+ * is until the handler at hand returns. Snapshots are recycled round robin, and a reader on
+ * another thread (the HTTP server) could see its snapshot being reused under it: it takes a
+ * copy with display_copy_context() instead, which checks the snapshot's sequence number
+ * around the copy and retries if the slot was recomposed meanwhile. Neither side locks.
+ */
+
+#include "zos.h"
+#include "display.h"
+#include "ht16k33.h"
+#include "font5x7.h"
+#include "stats.h"
+
+
+#define DISPLAY_CACHE_COLUMNS   (DISPLAY_MAX_TEXT_LENGTH * FONT5X7_ADVANCE)
+#define DISPLAY_STREAM_CHUNK    16      // characters read from a streamed message at a time
+#define DISPLAY_FRAME_TIME      20      // ms, at most one commit per frame
+#define DISPLAY_SNAPSHOTS       3
+
+
+static display_context_t snapshots[DISPLAY_SNAPSHOTS];
+static uint32_t sequences[DISPLAY_SNAPSHOTS];   // per snapshot, odd while it is being recomposed
+static display_context_t *published;    // current snapshot, only ever replaced as a whole
+static uint8_t next_snapshot;
+static ht16k33_t panels[DISPLAY_MAX_PANELS];
+static uint8_t panel_count;
+static uint16_t width;                  // columns across all panels
+static uint16_t position;               // column cache index of the leftmost column on the panel
+
+// Rendered message, bit 0 of each byte is the top row. Holds the whole message when it fits,
+// otherwise it is a ring of DISPLAY_CACHE_COLUMNS columns fed from the streamed file.
+static uint8_t columns[DISPLAY_CACHE_COLUMNS];
+static uint16_t column_count;
+
+static struct
+{
+    uint32_t handle;        // open message file, 0 when not streaming
+    uint16_t head;          // cache index the next chunk is rendered to
+    uint16_t ahead;         // rendered columns from the scroll position up to head
+} stream;
+
+// One byte per panel row, bit x is column x of the panel. frames[front] is what the panels
+// currently show, the other buffer is where the next frame is composed.
+static uint8_t frames[2][DISPLAY_MAX_PANELS][DISPLAY_HEIGHT];
+static uint8_t front;
+
+// DISPLAY_UPDATE_* fields changed in the context but not yet applied to the panel
+static uint8_t pending;
+
+// The panel shows a display_draw() image rather than the message
+static zos_bool_t drawing;
+
+// The whole message fits the panel, so it is shown still rather than scrolled
+static zos_bool_t still;
+
+// The display's one timer, see schedule_tick()
+static struct
+{
+    zos_bool_t armed;
+    zos_bool_t scrolling;   // a scroll step was scheduled last time round
+    uint32_t due;           // zn_rtos_get_time() the armed tick is for
+    uint32_t commit;        // when the pending changes are due on the panel
+    uint32_t step;          // when the next scroll step is due, while scrolling
+} tick;
+
+STATS_EVENT_HANDLER(tick_event_handler)
+
+
+/*************************************************************************************************/
+zos_result_t display_init(const display_panel_config_t *configs, uint8_t count)
+{
+    zos_result_t result = ZOS_SUCCESS;
+
+    if(count == 0 || count > DISPLAY_MAX_PANELS)
+    {
+        return ZOS_BADARG;
+    }
+
+    memset(snapshots, 0, sizeof(snapshots));
+    memset(sequences, 0, sizeof(sequences));
+    published = &snapshots[0];
+    next_snapshot = 1;
+    panel_count = 0;
+    position = 0;
+    memset(frames, 0, sizeof(frames));
+    front = 0;
+    pending = 0;
+    drawing = ZOS_FALSE;
+    still = ZOS_TRUE;
+    memset(&tick, 0, sizeof(tick));
+
+    for(uint8_t i = 0; i < count && result == ZOS_SUCCESS; ++i)
+    {
+        result = ht16k33_init(&panels[i], configs[i].port, configs[i].address);
+    }
+
+    if(result == ZOS_SUCCESS)
+    {
+        // Nothing reads the state before display_init() returns, so the first snapshot is
+        // filled in place
+        panel_count = count;
+        published->panel_count = count;
+        published->brightness = panels[0].brightness;
+        published->blink_rate = panels[0].blink_rate;
+        width = count * DISPLAY_PANEL_WIDTH;
+        column_count = width;
+        memset(columns, 0, width);
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+void display_deinit(void)
+{
+    zn_event_unregister(tick_event_handler_counted, NULL);
+    memset(&tick, 0, sizeof(tick));
+    pending = 0;
+    drawing = ZOS_FALSE;
+    stop_stream();
+    for(uint8_t i = 0; i < panel_count; ++i)
+    {
+        ht16k33_deinit(&panels[i]);
+    }
+}
+
+/*************************************************************************************************/
+zos_result_t display_update(const display_update_t *update)
+{
+    // The new snapshot is published straight away, so the state version and replies
+    // reflect the request, while the panel catches up at the next commit. Values that are
+    // already current are skipped and do not bump the state version; an update that
+    // changes nothing publishes nothing. Only ever called on the event thread.
+    zos_result_t result = ZOS_SUCCESS;
+    const uint8_t was_pending = pending;
+    const display_context_t *current = published;
+    display_context_t *next = &snapshots[next_snapshot];
+    uint32_t *sequence = &sequences[next_snapshot];
+    const uint32_t version = current->version + 1;
+
+    // A reader still copying the slot's previous snapshot sees the odd sequence and retries
+    __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    *next = *current;
+
+    if(update->flags & DISPLAY_UPDATE_FILE)
+    {
+        if(!ZOS_FAILED(result, load_file(update->file, next)))
+        {
+            next->modified.text = version;
+            pending |= DISPLAY_UPDATE_TEXT;
+        }
+        else
+        {
+            // A failed read may have left part of the file in the new snapshot
+            strcpy(next->text, current->text);
+        }
+    }
+    else if((update->flags & DISPLAY_UPDATE_TEXT) &&
+            (current->file[0] != 0 || drawing || strncmp(current->text, update->text, sizeof(current->text) - 1) != 0))
+    {
+        stop_stream();
+        next->file[0] = 0;
+        strncpy(next->text, update->text, sizeof(next->text) - 1);
+        next->text[sizeof(next->text) - 1] = 0;
+        next->modified.text = version;
+        pending |= DISPLAY_UPDATE_TEXT;
+    }
+
+    if((update->flags & DISPLAY_UPDATE_BRIGHTNESS) && MIN(update->brightness, HT16K33_MAX_BRIGHTNESS) != current->brightness)
+    {
+        next->brightness = MIN(update->brightness, HT16K33_MAX_BRIGHTNESS);
+        next->modified.brightness = version;
+        pending |= DISPLAY_UPDATE_BRIGHTNESS;
+    }
+
+    if((update->flags & DISPLAY_UPDATE_BLINK) && MIN(update->blink_rate, HT16K33_MAX_BLINK_RATE) != current->blink_rate)
+    {
+        next->blink_rate = MIN(update->blink_rate, HT16K33_MAX_BLINK_RATE);
+        next->modified.blink = version;
+        pending |= DISPLAY_UPDATE_BLINK;
+    }
+
+    if((update->flags & DISPLAY_UPDATE_SCROLL) && update->scroll_rate != current->scroll_rate)
+    {
+        next->scroll_rate = update->scroll_rate;
+        next->modified.scroll = version;
+        pending |= DISPLAY_UPDATE_SCROLL;
+    }
+
+    if(next->modified.text == version || next->modified.brightness == version ||
+       next->modified.blink == version || next->modified.scroll == version)
+    {
+        next->version = version;
+        __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&published, next, __ATOMIC_RELEASE);
+        next_snapshot = (next_snapshot + 1) % DISPLAY_SNAPSHOTS;
+    }
+    else
+    {
+        __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELEASE);
+    }
+
+    if(pending != 0 && was_pending == 0)
+    {
+        zos_result_t status;
+
+        tick.commit = zn_rtos_get_time() + DISPLAY_FRAME_TIME;
+        if(ZOS_FAILED(status, schedule_tick()))
+        {
+            result = status;
+        }
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+zos_result_t display_set_text(const char *text)
+{
+    const display_update_t update = { .flags = DISPLAY_UPDATE_TEXT, .text = text };
+    return display_update(&update);
+}
+
+/*************************************************************************************************/
+zos_result_t display_set_file(const char *name)
+{
+    const display_update_t update = { .flags = DISPLAY_UPDATE_FILE, .file = name };
+    return display_update(&update);
+}
+
+/*************************************************************************************************/
+zos_result_t display_set_brightness(uint8_t brightness)
+{
+    const display_update_t update = { .flags = DISPLAY_UPDATE_BRIGHTNESS, .brightness = brightness };
+    return display_update(&update);
+}
+
+/*************************************************************************************************/
+zos_result_t display_set_blink_rate(uint8_t rate)
+{
+    const display_update_t update = { .flags = DISPLAY_UPDATE_BLINK, .blink_rate = rate };
+    return display_update(&update);
+}
+
+/*************************************************************************************************/
+zos_result_t display_set_scroll_rate(uint16_t rate)
+{
+    const display_update_t update = { .flags = DISPLAY_UPDATE_SCROLL, .scroll_rate = rate };
+    return display_update(&update);
+}
+
+/*************************************************************************************************/
+/*
+ * Bring the panel in line with the state now rather than at the next frame tick, e.g. for
+ * the first frame at boot, before the event loop runs
+ */
+zos_result_t display_commit(void)
+{
+    zos_result_t result = ZOS_SUCCESS;
+
+    if(pending != 0)
+    {
+        result = commit();
+        schedule_tick();
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+zos_result_t display_draw(const uint8_t *image, uint16_t count)
+{
+    // An image narrower than the row is centred, a wider one is cropped to its middle
+    uint8_t (*back)[DISPLAY_HEIGHT] = frames[front ^ 1];
+    uint16_t x = (count < width) ? (width - count) / 2 : 0;
+    uint16_t i = (count > width) ? (count - width) / 2 : 0;
+
+    memset(back, 0, sizeof(frames[0]));
+    for(; x < width && i < count; ++x, ++i)
+    {
+        put_column(back, x, image[i]);
+    }
+
+    // Drawn straight away: the caller paces its own frames, and the scroll stops waking up
+    // until the message is back
+    if(!drawing)
+    {
+        drawing = ZOS_TRUE;
+        schedule_tick();
+    }
+
+    return flush_frame();
+}
+
+/*************************************************************************************************/
+/*
+ * The current state snapshot, consistent as a whole. It is not updated in place: a change
+ * publishes a new snapshot, and this one stays valid while the event at hand is handled.
+ * Event thread only, other threads use display_copy_context().
+ */
+const display_context_t* display_get_context(void)
+{
+    return __atomic_load_n(&published, __ATOMIC_ACQUIRE);
+}
+
+/*************************************************************************************************/
+/*
+ * A copy of the current state snapshot, for threads other than the event thread. The copy
+ * is taken again if the event thread recomposed the snapshot's slot while it was made.
+ */
+void display_copy_context(display_context_t *copy)
+{
+    for(;;)
+    {
+        const display_context_t *current = __atomic_load_n(&published, __ATOMIC_ACQUIRE);
+        const uint32_t *sequence = &sequences[current - snapshots];
+        const uint32_t before = __atomic_load_n(sequence, __ATOMIC_ACQUIRE);
+
+        if((before & 1) == 0)
+        {
+            memcpy(copy, current, sizeof(display_context_t));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if(__atomic_load_n(sequence, __ATOMIC_RELAXED) == before)
+            {
+                return;
+            }
+        }
+    }
+}
+
+/*************************************************************************************************/
+static void tick_event_handler(void *arg)
+{
+    // Decided before the commit, which may change what moves and when
+    const zos_bool_t step = is_moving() && (int32_t)(tick.step - tick.due) <= 0;
+    const uint8_t changes = pending;
+
+    tick.armed = ZOS_FALSE;
+    stats_record_lag(tick.due);
+
+    if(changes != 0)
+    {
+        commit();
+    }
+
+    // A new message starts from its first column rather than being scrolled straight away,
+    // and a new rate starts counting from now
+    if(step && !(changes & (DISPLAY_UPDATE_TEXT | DISPLAY_UPDATE_SCROLL)))
+    {
+        scroll_step();
+    }
+
+    schedule_tick();
+}
+
+/*************************************************************************************************/
+static zos_result_t schedule_tick(void)
+{
+    // One wakeup serves both the pending commit and the next scroll step when the step is due
+    // no later than a frame after the commit. With neither, the timer is left unarmed.
+    const zos_bool_t moving = is_moving();
+    zos_result_t result;
+    uint32_t due;
+    int32_t delay;
+
+    if(tick.scrolling && !moving)
+    {
+        // Jitter is measured between consecutive steps, not across a pause
+        stats_record_scroll_tick(0);
+    }
+    tick.scrolling = moving;
+
+    if(pending != 0)
+    {
+        due = (moving && (int32_t)(tick.step - tick.commit) <= DISPLAY_FRAME_TIME) ? tick.step : tick.commit;
+    }
+    else if(moving)
+    {
+        due = tick.step;
+    }
+    else
+    {
+        if(tick.armed)
+        {
+            zn_event_unregister(tick_event_handler_counted, NULL);
+            tick.armed = ZOS_FALSE;
+        }
+        return ZOS_SUCCESS;
+    }
+
+    if(tick.armed && due == tick.due)
+    {
+        return ZOS_SUCCESS;
+    }
+
+    delay = (int32_t)(due - zn_rtos_get_time());
+    zn_event_unregister(tick_event_handler_counted, NULL);
+    tick.armed = !ZOS_FAILED(result, zn_event_register_timed(tick_event_handler_counted, NULL, (delay > 0) ? (uint32_t)delay : 0, 0));
+    tick.due = due;
+
+    return result;
+}
+
+/*************************************************************************************************/
+static zos_bool_t is_moving(void)
+{
+    return display_get_context()->scroll_rate > 0 && !drawing && !still;
+}
+
+/*************************************************************************************************/
+static zos_result_t commit(void)
+{
+    // Apply everything that changed since the last commit in one go, so the panel never
+    // shows a mix of old and new settings
+    zos_result_t result = ZOS_SUCCESS;
+    zos_result_t status;
+    const uint8_t changes = pending;
+    const display_context_t *context = display_get_context();
+
+    pending = 0;
+
+    if(changes & DISPLAY_UPDATE_TEXT)
+    {
+        drawing = ZOS_FALSE;
+
+        if(stream.handle != 0)
+        {
+            stream.ahead = render_chars(context->text, strlen(context->text), 0);
+            stream.head = stream.ahead % DISPLAY_CACHE_COLUMNS;
+            column_count = DISPLAY_CACHE_COLUMNS;
+            still = ZOS_FALSE;
+        }
+        else
+        {
+            load_text(context->text);
+        }
+
+        position = 0;
+        compose_frame();
+
+        if(ZOS_FAILED(status, flush_frame()))
+        {
+            result = status;
+        }
+    }
+
+    for(uint8_t i = 0; i < panel_count; ++i)
+    {
+        if((changes & DISPLAY_UPDATE_BRIGHTNESS) && ZOS_FAILED(status, ht16k33_set_brightness(&panels[i], context->brightness)))
+        {
+            result = status;
+        }
+
+        if((changes & DISPLAY_UPDATE_BLINK) && ZOS_FAILED(status, ht16k33_set_blink_rate(&panels[i], context->blink_rate)))
+        {
+            result = status;
+        }
+    }
+
+    if(changes & (DISPLAY_UPDATE_TEXT | DISPLAY_UPDATE_SCROLL))
+    {
+        tick.step = zn_rtos_get_time() + context->scroll_rate;
+    }
+
+    if(result != ZOS_SUCCESS)
+    {
+        ZOS_LOG("Display commit failed: %d", result);
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+static void scroll_step(void)
+{
+    const uint16_t rate = display_get_context()->scroll_rate;
+    const uint32_t now = zn_rtos_get_time();
+
+    stats_record_scroll_tick(rate);
+
+    // Steps keep to their own schedule, but one that fell behind by a whole step is not
+    // caught up with a burst of wakeups
+    tick.step += rate;
+    if((int32_t)(now - tick.step) >= 0)
+    {
+        tick.step = now + rate;
+    }
+
+    if(++position >= column_count)
+    {
+        position = 0;
+    }
+
+    if(stream.handle != 0)
+    {
+        --stream.ahead;
+        refill_stream();
+    }
+
+    scroll_frame();
+    flush_frame();
+}
+
+/*************************************************************************************************/
+static void load_text(const char *text)
+{
+    const uint16_t count = render_chars(text, strlen(text), 0);
+    const uint16_t used = (count > 0) ? count - 1 : 0;     // without the last glyph's spacing column
+
+    // A message that fits is centred and shown still: there is nothing to scroll, and so
+    // nothing to wake up for
+    still = (used <= width);
+    if(still)
+    {
+        const uint16_t x = (width - used) / 2;
+
+        memmove(&columns[x], columns, used);
+        memset(columns, 0, x);
+        memset(&columns[x + used], 0, width - x - used);
+        column_count = width;
+    }
+    else
+    {
+        column_count = count;
+    }
+}
+
+/*************************************************************************************************/
+/*
+ * Load the start of a file into the snapshot being composed, and keep the file open to
+ * stream the rest if it does not all fit
+ */
+static zos_result_t load_file(const char *name, display_context_t *context)
+{
+    zos_result_t result;
+    uint32_t handle;
+    uint32_t bytes_read;
+
+    if(ZOS_FAILED(result, zn_file_open(name, &handle)))
+    {
+        return result;
+    }
+    else if(ZOS_FAILED(result, zn_file_read(handle, context->text, sizeof(context->text) - 1, &bytes_read)))
+    {
+        zn_file_close(handle);
+        return result;
+    }
+
+    // Rendering waits for the commit, see commit()
+    stop_stream();
+    context->file[0] = 0;
+    context->text[bytes_read] = 0;
+    for(char *c = context->text; c < &context->text[bytes_read]; ++c)
+    {
+        // Keep the preview's length equal to the bytes read, the stream carries on from there
+        if(*c == 0)
+        {
+            *c = ' ';
+        }
+    }
+
+    if(bytes_read < sizeof(context->text) - 1)
+    {
+        // The whole message fits, no need to keep the file around
+        zn_file_close(handle);
+    }
+    else
+    {
+        strncpy(context->file, name, sizeof(context->file) - 1);
+        stream.handle = handle;
+    }
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+static void stop_stream(void)
+{
+    if(stream.handle != 0)
+    {
+        zn_file_close(stream.handle);
+    }
+    memset(&stream, 0, sizeof(stream));
+}
+
+/*************************************************************************************************/
+static void refill_stream(void)
+{
+    char chunk[DISPLAY_STREAM_CHUNK];
+    uint32_t bytes_read;
+
+    // Only read once a whole chunk fits in the free part of the ring, which keeps file reads
+    // to one every DISPLAY_STREAM_CHUNK characters of scrolling
+    if(DISPLAY_CACHE_COLUMNS - stream.ahead < DISPLAY_STREAM_CHUNK * FONT5X7_ADVANCE)
+    {
+        return;
+    }
+
+    if(zn_file_read(stream.handle, chunk, sizeof(chunk), &bytes_read) != ZOS_SUCCESS || bytes_read == 0)
+    {
+        // End of the message, start over from the beginning of the file
+        zn_file_close(stream.handle);
+        if(zn_file_open(display_get_context()->file, &stream.handle) != ZOS_SUCCESS)
+        {
+            stream.handle = 0;
+        }
+        if(stream.handle == 0 || zn_file_read(stream.handle, chunk, sizeof(chunk), &bytes_read) != ZOS_SUCCESS || bytes_read == 0)
+        {
+            // The file went away: keep the ring fed with blanks rather than stale columns
+            memset(chunk, ' ', sizeof(chunk));
+            bytes_read = sizeof(chunk);
+        }
+    }
+
+    render_chars(chunk, bytes_read, stream.head);
+    stream.head = (stream.head + bytes_read * FONT5X7_ADVANCE) % DISPLAY_CACHE_COLUMNS;
+    stream.ahead += bytes_read * FONT5X7_ADVANCE;
+}
+
+/*************************************************************************************************/
+static uint16_t render_chars(const char *chars, uint32_t count, uint16_t at)
+{
+    // 'at' is always a multiple of FONT5X7_ADVANCE, and so is the cache size, so a glyph is
+    // never split across the end of the ring
+    for(const char *end = chars + count; chars < end; ++chars)
+    {
+        const uint8_t ch = (uint8_t)*chars;
+        const uint8_t *glyph = font5x7[((ch < FONT5X7_FIRST_CHAR) ? ' ' : (ch > FONT5X7_LAST_CHAR) ? '?' : ch) - FONT5X7_FIRST_CHAR];
+        uint8_t *ptr;
+
+        if(at >= DISPLAY_CACHE_COLUMNS)
+        {
+            at = 0;
+        }
+        ptr = &columns[at];
+        memcpy(ptr, glyph, FONT5X7_WIDTH);
+        ptr[FONT5X7_WIDTH] = 0;
+        at += FONT5X7_ADVANCE;
+    }
+
+    return count * FONT5X7_ADVANCE;
+}
+
+/*************************************************************************************************/
+static void compose_frame(void)
+{
+    uint8_t (*back)[DISPLAY_HEIGHT] = frames[front ^ 1];
+    uint16_t col = position;
+
+    memset(back, 0, sizeof(frames[0]));
+
+    for(uint16_t x = 0; x < width; ++x)
+    {
+        put_column(back, x, columns[col]);
+        if(++col == column_count)
+        {
+            col = 0;
+        }
+    }
+}
+
+/*************************************************************************************************/
+static void put_column(uint8_t (*frame)[DISPLAY_HEIGHT], uint16_t x, uint8_t bits)
+{
+    // 'frame' must be clear at column x
+    uint8_t *rows = frame[x / DISPLAY_PANEL_WIDTH];
+    const uint8_t shift = x % DISPLAY_PANEL_WIDTH;
+
+    for(uint8_t y = 0; y < DISPLAY_HEIGHT; ++y)
+    {
+        rows[y] |= ((bits >> y) & 1) << shift;
+    }
+}
+
+/*************************************************************************************************/
+static void scroll_frame(void)
+{
+    // Moving the window one column to the right shifts every row left across the panels:
+    // each panel takes in the column leaving its right hand neighbour, and the last panel
+    // takes in the single new column from the cache
+    uint8_t (*shown)[DISPLAY_HEIGHT] = frames[front];
+    uint8_t (*back)[DISPLAY_HEIGHT] = frames[front ^ 1];
+    const uint8_t last = panel_count - 1;
+    uint16_t col = position + width - 1;
+    uint8_t bits;
+
+    if(col >= column_count)
+    {
+        col -= column_count;
+    }
+    bits = columns[col];
+
+    for(uint8_t y = 0; y < DISPLAY_HEIGHT; ++y)
+    {
+        for(uint8_t p = 0; p < last; ++p)
+        {
+            back[p][y] = (uint8_t)((shown[p][y] >> 1) | ((shown[p + 1][y] & 1) << (DISPLAY_PANEL_WIDTH - 1)));
+        }
+        back[last][y] = (uint8_t)((shown[last][y] >> 1) | (((bits >> y) & 1) << (DISPLAY_PANEL_WIDTH - 1)));
+    }
+}
+
+/*************************************************************************************************/
+static zos_result_t flush_frame(void)
+{
+    zos_result_t result = ZOS_SUCCESS;
+    zos_result_t status;
+
+    // Panels whose content did not change are skipped entirely, so a mostly static row
+    // (e.g. an animation frame that changes in part) costs little per frame
+    for(uint8_t p = 0; p < panel_count; ++p)
+    {
+        if(ZOS_FAILED(status, flush_panel(p)))
+        {
+            result = status;
+        }
+    }
+
+    front ^= 1;
+
+    return result;
+}
+
+/*************************************************************************************************/
+static zos_result_t flush_panel(uint8_t p)
+{
+    zos_result_t result;
+    const uint8_t *shown = frames[front][p];
+    uint8_t *back = frames[front ^ 1][p];
+    int8_t first = -1, last = -1;
+
+    for(uint8_t y = 0; y < DISPLAY_HEIGHT; ++y)
+    {
+        if(back[y] != shown[y])
+        {
+            if(first < 0)
+            {
+                first = y;
+            }
+            last = y;
+        }
+    }
+
+    // Rows in between are resent rather than split into several transactions: one I2C
+    // start/address phase costs about as much as a couple of row bytes
+    if(first < 0)
+    {
+        return ZOS_SUCCESS;
+    }
+
+    if(ZOS_FAILED(result, ht16k33_write_rows(&panels[p], first, &back[first], last - first + 1)))
+    {
+        // Keep the panel's front buffer what it really shows, the next flush retries the rows
+        memcpy(back, shown, DISPLAY_HEIGHT);
+    }
+
+    return result;
+}
@@ -0,0 +1,72 @@
+/*
+ * Scrolling text display engine for a row of 8x8 LED matrix panels.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+#define DISPLAY_PANEL_WIDTH         8
+#define DISPLAY_HEIGHT              8
+#define DISPLAY_MAX_PANELS          16
+#define DISPLAY_MAX_TEXT_LENGTH     128     // including the terminating null
+#define DISPLAY_MAX_FILENAME        32
+
+// One panel of the row, panels are given left to right
+typedef struct
+{
+    zos_i2c_t port;
+    uint8_t address;
+} display_panel_config_t;
+
+// A snapshot of the display state, see display_get_context(). Never modified while it is
+// current; its slot is reused some updates later. Every display_* call that changes the
+// state must be made on the app's event thread: another thread hands its changes over
+// (see led_matrix.c) and reads the state with display_copy_context().
+typedef struct
+{
+    uint8_t panel_count;
+    uint8_t brightness;
+    uint8_t blink_rate;
+    uint16_t scroll_rate;                   // ms per column, 0 stops scrolling
+    char text[DISPLAY_MAX_TEXT_LENGTH];     // the message, or its beginning when streamed from file
+    char file[DISPLAY_MAX_FILENAME];        // file the message is streamed from, empty if all of it is in text
+    uint32_t version;                       // incremented by every display_update() that changes something
+    struct
+    {
+        uint32_t text;
+        uint32_t brightness;
+        uint32_t blink;
+        uint32_t scroll;
+    } modified;                             // version in which each field last changed
+} display_context_t;
+
+#define DISPLAY_UPDATE_TEXT         (1 << 0)
+#define DISPLAY_UPDATE_BRIGHTNESS   (1 << 1)
+#define DISPLAY_UPDATE_BLINK        (1 << 2)
+#define DISPLAY_UPDATE_SCROLL       (1 << 3)
+#define DISPLAY_UPDATE_FILE         (1 << 4)    // show the contents of a file, overrides DISPLAY_UPDATE_TEXT
+
+typedef struct
+{
+    uint8_t flags;                          // DISPLAY_UPDATE_*, only flagged fields are applied
+    uint8_t brightness;
+    uint8_t blink_rate;
+    uint16_t scroll_rate;
+    const char *text;
+    const char *file;
+} display_update_t;
+
+
+zos_result_t display_init(const display_panel_config_t *panels, uint8_t panel_count);
+void display_deinit(void);
+zos_result_t display_update(const display_update_t *update);
+zos_result_t display_set_text(const char *text);
+zos_result_t display_set_file(const char *name);
+zos_result_t display_set_brightness(uint8_t brightness);
+zos_result_t display_set_blink_rate(uint8_t rate);
+zos_result_t display_set_scroll_rate(uint16_t rate);
+zos_result_t display_commit(void);
+zos_result_t display_draw(const uint8_t *image, uint16_t count);
+const display_context_t* display_get_context(void);
+void display_copy_context(display_context_t *copy);
@@ -0,0 +1,15 @@
+/*
+ * Fixed width 5x7 ASCII font used by the display engine.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+#define FONT5X7_FIRST_CHAR      ' '
+#define FONT5X7_LAST_CHAR       '~'
+#define FONT5X7_WIDTH           5
+#define FONT5X7_ADVANCE         (FONT5X7_WIDTH + 1)     // glyph plus one blank spacing column
+
+// One byte per column, bit 0 is the top row
+extern const uint8_t font5x7[FONT5X7_LAST_CHAR - FONT5X7_FIRST_CHAR + 1][FONT5X7_WIDTH];
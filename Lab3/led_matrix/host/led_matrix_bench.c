@@ -0,0 +1,500 @@
+/*
+ * Host microbenchmarks for the led_matrix app.
+ *
+ * The app source is compiled into this translation unit so its static handlers can be
+ * called directly, as the module's event loop would call them. Pages run on the stand-in's
+ * HTTP server thread (zos_host_http_serve()), so their times include the hand-over of
+ * display changes to the event thread, as on the module.
+ * Each benchmark reports wall time, allocations and the I2C traffic generated by the display
+ * engine per operation, the files created, each of which costs a flash erase on the
+ * module, and the timer wakeups, each of which takes the CPU out of its idle state.
+ * Output is one line per benchmark so results can be diffed between commits.
+ *
+ * The app's clock (zn_rtos_get_time()) only moves with zos_host_advance(), so everything
+ * but the wall time is the same from run to run.
+ */
+
+#include <time.h>
+#include "zos_host.h"
+#include "led_matrix.c"
+
+
+#define BENCH_MIN_TIME_NS       200000000ULL    // run each benchmark for at least 200ms
+#define BENCH_MIN_ITERATIONS    100
+
+typedef void (*bench_func_t)(uint32_t iterations);
+
+typedef struct
+{
+    const char *name;
+    bench_func_t func;
+} bench_t;
+
+
+static zos_host_http_reply_t reply;
+
+
+/*************************************************************************************************/
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/*************************************************************************************************/
+static void run_processor(const char *url, const char *if_none_match, uint32_t iterations)
+{
+    const http_server_request_t *request = zos_host_http_prepare(url, &reply);
+
+    if(if_none_match != NULL)
+    {
+        zos_host_http_add_header(request, "If-None-Match", if_none_match);
+    }
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        reply.body_length = 0;
+        reply.headers[0] = 0;
+        zos_host_http_serve(request);
+    }
+}
+
+/*************************************************************************************************/
+static void bench_update_text(uint32_t iterations)
+{
+    run_processor("/led_matrix/update/text?data=Hello%20from%20the%20bench%20...%20", NULL, iterations);
+}
+
+/*************************************************************************************************/
+static void bench_update_batch(uint32_t iterations)
+{
+    run_processor("/led_matrix/update?text=Hello%20from%20the%20bench%20...%20&brightness=8&blink=0&scroll=35", NULL, iterations);
+}
+
+/*************************************************************************************************/
+static void bench_brightness_drag(uint32_t iterations)
+{
+    // A range input being dragged: a new value every couple of milliseconds
+    char url[64];
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        sprintf(url, "/led_matrix/update/brightness?data=%lu", (unsigned long)(i % 16));
+        zos_host_http_get(url, &reply);
+        zos_host_advance(2);
+    }
+}
+
+/*************************************************************************************************/
+static void bench_journal_restore(uint32_t iterations)
+{
+    // Boot time replay of the saved display settings, left in the journal by the benches above
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        journal_restore();
+    }
+}
+
+/*************************************************************************************************/
+static void bench_index_page(uint32_t iterations)
+{
+    run_processor("/led_matrix/index.html", NULL, iterations);
+}
+
+/*************************************************************************************************/
+static void bench_index_page_not_modified(uint32_t iterations)
+{
+    run_processor("/led_matrix/index.html", index_page.etag, iterations);
+}
+
+/*************************************************************************************************/
+static void bench_retrieve_all(uint32_t iterations)
+{
+    run_processor("/led_matrix/retrieve/all", NULL, iterations);
+}
+
+/*************************************************************************************************/
+static void bench_retrieve_all_not_modified(uint32_t iterations)
+{
+    run_processor("/led_matrix/retrieve/all", state_etag(display_get_context()), iterations);
+}
+
+/*************************************************************************************************/
+static void bench_retrieve_changes_idle(uint32_t iterations)
+{
+    char url[64];
+
+    sprintf(url, "/led_matrix/retrieve/changes?since=%08lX-%lu", (unsigned long)boot_nonce, (unsigned long)display_get_context()->version);
+    run_processor(url, NULL, iterations);
+}
+
+/*************************************************************************************************/
+static void run_scan_sweep(void)
+{
+    scanner_start(NULL);
+    while(scanner_get_context()->channel != 0)
+    {
+        zos_host_run_events();
+        zos_host_advance(10);
+    }
+}
+
+/*************************************************************************************************/
+static void bench_print_scan_result(uint32_t iterations)
+{
+    const scanner_context_t *scan = scanner_get_context();
+
+    run_scan_sweep();
+
+    for(uint32_t i = 0; i < iterations; )
+    {
+        for(uint8_t j = 0; j < scan->count && i < iterations; ++j, ++i)
+        {
+            print_scan_result(i, &scan->records[j]);
+        }
+    }
+}
+
+/*************************************************************************************************/
+static void bench_retrieve_scan(uint32_t iterations)
+{
+    run_scan_sweep();
+    run_processor("/led_matrix/retrieve/scan?offset=0&limit=16", NULL, iterations);
+}
+
+/*************************************************************************************************/
+static void bench_scan_sweep(uint32_t iterations)
+{
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        run_scan_sweep();
+    }
+}
+
+/*************************************************************************************************/
+static void bench_boot(uint32_t iterations)
+{
+    // Power-on to the first frame, with the network join still under way
+    zos_host_set_network_up(ZOS_FALSE);
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        zn_app_deinit();
+        zn_app_init();
+    }
+
+    // The join completing, as a network event
+    zos_host_set_network_up(ZOS_TRUE);
+    zos_host_run_events();
+}
+
+/*************************************************************************************************/
+static void bench_load_file_message(uint32_t iterations)
+{
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        load_file_message();
+    }
+}
+
+/*************************************************************************************************/
+static void bench_scroll_step(uint32_t iterations)
+{
+    const uint16_t rate = display_get_context()->scroll_rate;
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        zos_host_advance(rate);
+    }
+}
+
+/*************************************************************************************************/
+static void bench_scroll_step_streamed(uint32_t iterations)
+{
+    // A message far larger than the column cache, POSTed the way the web page would
+    static char message[16*1024];
+    const uint16_t rate = display_get_context()->scroll_rate;
+    const http_server_request_t *request = zos_host_http_prepare("/led_matrix/update/text", &reply);
+
+    for(uint32_t i = 0; i < sizeof(message); ++i)
+    {
+        message[i] = ' ' + (i % 95);
+    }
+    zos_host_http_set_body(request, message, sizeof(message));
+    zos_host_http_serve(request);
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        zos_host_advance(rate);
+    }
+}
+
+/*************************************************************************************************/
+static void bench_scroll_step_8_panels(uint32_t iterations)
+{
+    // A row of eight panels on one bus, the most one set of HT16K33 addresses allows
+    display_panel_config_t row[8];
+    const uint16_t rate = display_get_context()->scroll_rate;
+
+    for(uint8_t i = 0; i < 8; ++i)
+    {
+        row[i].port = PLATFORM_STD_I2C;
+        row[i].address = HT16K33_DEFAULT_ADDRESS + i;
+    }
+    display_deinit();
+    display_init(row, 8);
+    display_set_text("Hello from the bench ... ");
+    display_set_scroll_rate(rate);
+    zos_host_advance(rate);
+    zos_host_reset_counters();
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        zos_host_advance(rate);
+    }
+
+    display_deinit();
+    display_init(panels, sizeof(panels)/sizeof(panels[0]));
+    display_set_text("Hello from the bench ... ");
+    display_set_scroll_rate(rate);
+}
+
+/*************************************************************************************************/
+static void bench_idle_second(uint32_t iterations)
+{
+    // A message that fits the panel stands still: a second of it should cost no wakeups
+    const display_context_t *context = display_get_context();
+    char text[DISPLAY_MAX_TEXT_LENGTH];
+
+    strcpy(text, context->text);
+    display_set_text("8");
+    zos_host_advance(context->scroll_rate);
+    zos_host_reset_counters();
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        zos_host_advance(1000);
+    }
+
+    display_set_text(text);
+    zos_host_advance(context->scroll_rate);
+}
+
+/*************************************************************************************************/
+static void send_stream_frame(uint32_t sequence)
+{
+    // A bar sweeping across the row of panels
+    uint8_t frame[STREAM_HEADER_SIZE + DISPLAY_MAX_PANELS * DISPLAY_PANEL_WIDTH] = { 'L', 'F', 0, 0 };
+    const uint16_t columns = sizeof(panels)/sizeof(panels[0]) * DISPLAY_PANEL_WIDTH;
+
+    frame[4] = sequence;
+    frame[5] = sequence >> 8;
+    frame[6] = sequence >> 16;
+    frame[7] = sequence >> 24;
+    frame[STREAM_HEADER_SIZE + sequence % columns] = 0xFF;
+    zos_host_udp_send(STREAM_UDP_PORT, frame, STREAM_HEADER_SIZE + columns);
+}
+
+/*************************************************************************************************/
+static void end_stream(void)
+{
+    // Let the stream time out so the message is back for the next benchmark
+    zos_host_advance(STREAM_IDLE_TIMEOUT + STREAM_IDLE_TIMEOUT / 4);
+}
+
+/*************************************************************************************************/
+static void bench_stream_frame(uint32_t iterations)
+{
+    // A 30 fps stream, each op is one frame received and drawn
+    static uint32_t sequence;
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        send_stream_frame(++sequence);
+        zos_host_advance(33);
+    }
+    end_stream();
+}
+
+/*************************************************************************************************/
+static void bench_stream_backlog(uint32_t iterations)
+{
+    // Four frames waiting at once, one of them a late duplicate: only the newest is drawn
+    static uint32_t sequence = 1UL << 20;
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        sequence += 3;
+        send_stream_frame(sequence - 2);
+        send_stream_frame(sequence);
+        send_stream_frame(sequence - 1);
+        send_stream_frame(sequence - 3);
+        zos_host_run_events();
+    }
+    end_stream();
+}
+
+/*************************************************************************************************/
+static void bench_remote_command(uint32_t iterations)
+{
+    // A controller pushing brightness commands through the stand-in broker, each op is one
+    // command delivered, applied and its status published back
+    const remote_context_t *remote = remote_get_context();
+    char command[32];
+
+    start_remote("localhost", MQTT_BROKER_PORT);
+    zos_host_run_events();
+
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        const uint32_t length = sprintf(command, "brightness=%lu", (unsigned long)(i % 16));
+
+        zos_host_broker_publish(remote->command_topic, command, length);
+        zos_host_advance(2);
+    }
+
+    if(zos_host_broker_last_message(remote->status_topic) == NULL || remote->commands < iterations)
+    {
+        fprintf(stderr, "remote_command: %lu of %lu commands applied\n", (unsigned long)remote->commands, (unsigned long)iterations);
+    }
+    remote_stop();
+}
+
+/*************************************************************************************************/
+static void bench_playlist_burst(uint32_t iterations)
+{
+    // A burst filling the queue from the HTTP server, then the playlist played out. Each op
+    // is one message submitted, dequeued and shown for its 1s dwell.
+    static const char *urls[PLAYLIST_QUEUE_SIZE] =
+    {
+        "/led_matrix/update/playlist?priority=1&dwell=1000",
+        "/led_matrix/update/playlist?priority=1&dwell=1000",
+        "/led_matrix/update/playlist?priority=2&dwell=1000",
+        "/led_matrix/update/playlist?priority=2&dwell=1000",
+        "/led_matrix/update/playlist?priority=2&dwell=1000",
+        "/led_matrix/update/playlist?priority=0&dwell=1000",
+        "/led_matrix/update/playlist?priority=3&dwell=1000",
+        "/led_matrix/update/playlist?priority=1&dwell=1000",
+    };
+    static const char message[] = "Playlist message from the bench ... ";
+
+    for(uint32_t i = 0; i < iterations; i += PLAYLIST_QUEUE_SIZE)
+    {
+        for(uint32_t j = 0; j < PLAYLIST_QUEUE_SIZE; ++j)
+        {
+            const http_server_request_t *request = zos_host_http_prepare(urls[j], &reply);
+
+            zos_host_http_set_body(request, message, sizeof(message) - 1);
+            zos_host_http_serve(request);
+        }
+        zos_host_run_events();
+        while(playlist_get_context()->current != NULL)
+        {
+            zos_host_advance(1000);
+        }
+    }
+}
+
+/*************************************************************************************************/
+static void bench_animation_frame(uint32_t iterations)
+{
+    // heart.anim is compiled from resources/animations/ by 'make bench'
+    const http_server_request_t *request = zos_host_http_prepare("/led_matrix/update/animation?data=heart.anim", &reply);
+    uint16_t frame_time;
+
+    zos_host_http_serve(request);
+    frame_time = animation_get_context()->frame_time;
+
+    for(uint32_t i = 0; i < iterations && frame_time > 0; ++i)
+    {
+        zos_host_advance(frame_time);
+    }
+
+    request = zos_host_http_prepare("/led_matrix/update/animation", &reply);
+    zos_host_http_serve(request);
+}
+
+/*************************************************************************************************/
+static void run_bench(const bench_t *bench)
+{
+    uint32_t iterations = BENCH_MIN_ITERATIONS;
+    uint64_t elapsed;
+    zos_host_counters_t *counters = zos_host_counters();
+
+    for(;;)
+    {
+        zos_host_reset_counters();
+        const uint64_t start = now_ns();
+        bench->func(iterations);
+        elapsed = now_ns() - start;
+
+        if(elapsed >= BENCH_MIN_TIME_NS || iterations >= (1UL << 30))
+        {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    printf("%-28s %10lu %12.1f ns/op %8.2f allocs/op %8.2f i2c-B/op %6.2f i2c-tx/op %8.5f files/op %6.2f wakeups/op\n",
+            bench->name,
+            (unsigned long)iterations,
+            (double)elapsed / iterations,
+            (double)(counters->zn_mallocs + counters->heap_mallocs) / iterations,
+            (double)counters->i2c_bytes / iterations,
+            (double)counters->i2c_transactions / iterations,
+            (double)counters->file_creates / iterations,
+            (double)counters->timer_wakeups / iterations);
+}
+
+/*************************************************************************************************/
+int main(int argc, char **argv)
+{
+    static const bench_t benches[] =
+    {
+        { "update_text_processor",      bench_update_text },
+        { "update_processor",           bench_update_batch },
+        { "brightness_drag",            bench_brightness_drag },
+        { "journal_restore",            bench_journal_restore },
+        { "boot",                       bench_boot },
+        { "index_page",                 bench_index_page },
+        { "index_page_304",             bench_index_page_not_modified },
+        { "retrieve_all_processor",     bench_retrieve_all },
+        { "retrieve_all_304",           bench_retrieve_all_not_modified },
+        { "retrieve_changes_idle",      bench_retrieve_changes_idle },
+        { "print_scan_result",          bench_print_scan_result },
+        { "retrieve_scan_processor",    bench_retrieve_scan },
+        { "scan_sweep",                 bench_scan_sweep },
+        { "load_file_message",          bench_load_file_message },
+        { "scroll_step",                bench_scroll_step },
+        { "scroll_step_streamed",       bench_scroll_step_streamed },
+        { "scroll_step_8_panels",       bench_scroll_step_8_panels },
+        { "idle_second",                bench_idle_second },
+        { "animation_frame",            bench_animation_frame },
+        { "playlist_burst",             bench_playlist_burst },
+        { "stream_frame",               bench_stream_frame },
+        { "stream_backlog",             bench_stream_backlog },
+        { "remote_command",             bench_remote_command },
+    };
+
+    if(argc > 1)
+    {
+        zos_host_set_fs_root(argv[1]);
+    }
+    if(argc > 2)
+    {
+        zos_host_set_fs_write_root(argv[2]);
+    }
+
+    zos_host_set_log_enabled(ZOS_FALSE);
+    zn_app_init();
+
+    for(uint32_t i = 0; i < sizeof(benches)/sizeof(benches[0]); ++i)
+    {
+        run_bench(&benches[i]);
+    }
+
+    zn_app_deinit();
+
+    return 0;
+}
@@ -0,0 +1,784 @@
+/*
+ * Host checks of the led_matrix app's behaviour, against the stand-in SDK.
+ *
+ * Where the bench measures how fast the app is, these check that it is right. Each check
+ * starts the app from scratch on an empty write directory, prints what it saw and PASS or
+ * FAIL, and the exit status is non-zero when any of them failed.
+ *
+ * The app source is compiled into this translation unit, as for the bench, so the checks
+ * can reach its static state (the boot nonce) and call its modules directly.
+ *
+ *   led_matrix_check <fs roots> <write dir>
+ */
+
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include "zos_host.h"
+#include "led_matrix.c"
+
+
+#define CHECK_MAX_OUTPUT        1024
+
+// The on-flash formats, written out here rather than taken from the modules under test
+#define CHECK_JOURNAL_FILENAME      "journal_%u.bin"    // see journal.c
+#define CHECK_ANIMATION_HEADER_SIZE 16                  // see animation.c
+#define CHECK_ANIMATION_FLAG_LOOP   (1 << 0)
+#define CHECK_ANIMATION_KEY         0
+#define CHECK_ANIMATION_DELTA       1
+
+
+static const char *write_dir;
+static zos_host_http_reply_t reply;
+static char output[CHECK_MAX_OUTPUT];
+static uint32_t output_length;
+
+
+/*************************************************************************************************/
+static zos_bool_t expect(zos_bool_t condition, const char *description)
+{
+    printf("  %-4s %s\n", condition ? "ok" : "FAIL", description);
+    return condition;
+}
+
+/*************************************************************************************************/
+static zos_bool_t report(zos_bool_t passed)
+{
+    printf("  %s\n", passed ? "PASS" : "FAIL");
+    return passed;
+}
+
+/*************************************************************************************************/
+/*
+ * Start the app on an empty write directory, with the network up
+ */
+static void restart_app(const char *name)
+{
+    DIR *dir;
+    struct dirent *entry;
+    char path[512];
+
+    printf("\n%s\n", name);
+
+    zn_app_deinit();
+    zos_host_run_events();
+    if((dir = opendir(write_dir)) != NULL)
+    {
+        while((entry = readdir(dir)) != NULL)
+        {
+            if(entry->d_name[0] != '.')
+            {
+                snprintf(path, sizeof(path), "%s/%s", write_dir, entry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(dir);
+    }
+    zos_host_set_network_up(ZOS_TRUE);
+    zn_app_init();
+    zos_host_run_events();
+}
+
+/*************************************************************************************************/
+static void write_file(const char *name, const void *data, uint32_t length)
+{
+    char path[256];
+    FILE *file;
+
+    snprintf(path, sizeof(path), "%s/%s", write_dir, name);
+    if((file = fopen(path, "wb")) != NULL)
+    {
+        fwrite(data, 1, length, file);
+        fclose(file);
+    }
+}
+
+/*************************************************************************************************/
+static uint32_t read_file(const char *name, void *data, uint32_t size)
+{
+    char path[256];
+    FILE *file;
+    uint32_t length = 0;
+
+    snprintf(path, sizeof(path), "%s/%s", write_dir, name);
+    if((file = fopen(path, "rb")) != NULL)
+    {
+        length = fread(data, 1, size, file);
+        fclose(file);
+    }
+    return length;
+}
+
+/*************************************************************************************************/
+static zos_result_t http_get(const char *url, const char *if_none_match)
+{
+    const http_server_request_t *request = zos_host_http_prepare(url, &reply);
+
+    if(if_none_match != NULL)
+    {
+        zos_host_http_add_header(request, "If-None-Match", if_none_match);
+    }
+    reply.body[0] = 0;
+
+    return zos_host_http_serve(request);
+}
+
+/*************************************************************************************************/
+static zos_result_t http_post(const char *url, const char *body)
+{
+    const http_server_request_t *request = zos_host_http_prepare(url, &reply);
+
+    zos_host_http_set_body(request, body, strlen(body));
+
+    return zos_host_http_serve(request);
+}
+
+/*************************************************************************************************/
+/*
+ * The value of header 'name' in the last reply, empty when there is none
+ */
+static const char* reply_header(const char *name)
+{
+    static char value[64];
+    const char *header = strstr(reply.headers, name);
+
+    value[0] = 0;
+    if(header != NULL)
+    {
+        header += strlen(name) + 2;
+        snprintf(value, sizeof(value), "%.*s", (int)strcspn(header, "\r\n"), header);
+    }
+    return value;
+}
+
+/*************************************************************************************************/
+static zos_result_t output_flush(void *arg, const char *data, uint32_t length, zos_bool_t is_final)
+{
+    if(output_length + length >= sizeof(output))
+    {
+        return ZOS_BUFFER_OVERFLOW;
+    }
+    memcpy(&output[output_length], data, length);
+    output_length += length;
+    output[output_length] = 0;
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_display(void)
+{
+    static const uint8_t image[DISPLAY_PANEL_WIDTH] = { 0x81, 0x42, 0x24, 0x18, 0x18, 0x24, 0x42, 0x81 };
+    const zos_host_counters_t *counters = zos_host_counters();
+    zos_bool_t passed = ZOS_TRUE;
+    uint8_t changed[DISPLAY_PANEL_WIDTH];
+
+    restart_app("display column cache and row flush");
+
+    display_draw(image, sizeof(image));
+    zos_host_reset_counters();
+    display_draw(image, sizeof(image));
+    passed &= expect(counters->i2c_transactions == 0, "the same frame again writes nothing");
+
+    // Column 3 changes in rows 2 to 4: one write of the register address and those three rows
+    memcpy(changed, image, sizeof(changed));
+    changed[3] ^= 0x1C;
+    zos_host_reset_counters();
+    display_draw(changed, sizeof(changed));
+    printf("       %lu transaction, %lu bytes\n", (unsigned long)counters->i2c_transactions, (unsigned long)counters->i2c_bytes);
+    passed &= expect(counters->i2c_transactions == 1 && counters->i2c_bytes == 1 + 1 + 3 * 2,
+                     "a single column change writes only the rows it touches");
+
+    // Dashes only light row 3, so every scroll step writes that one row and no other
+    display_set_text("--- --- --- ---");
+    display_set_scroll_rate(50);
+    zos_host_advance(100);
+    zos_host_reset_counters();
+    zos_host_advance(50 * 20);
+    printf("       %lu transactions, %lu bytes over 20 steps\n", (unsigned long)counters->i2c_transactions, (unsigned long)counters->i2c_bytes);
+    passed &= expect(counters->i2c_transactions > 0 && counters->i2c_bytes == counters->i2c_transactions * (1 + 1 + 2),
+                     "scrolling writes only the row that changes");
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_retrieve_changes(void)
+{
+    zos_bool_t passed = ZOS_TRUE;
+    char token[24];
+    char etag[32];
+    char url[96];
+
+    restart_app("retrieve/changes delta and 304");
+
+    http_get("/led_matrix/update?text=hello&brightness=5&scroll=40", NULL);
+    snprintf(token, sizeof(token), "%.*s", (int)strcspn(&reply.body[12], "\""), &reply.body[12]);
+
+    sprintf(url, "/led_matrix/retrieve/changes?since=%s", token);
+    http_get(url, NULL);
+    passed &= expect(reply.status == 304 && reply.body_length == 0, "the current version gets an empty 304");
+
+    http_get("/led_matrix/update/scroll?data=60", NULL);
+    http_get(url, NULL);
+    passed &= expect(reply.status == 200 && strstr(reply.body, "\"scroll\":60") != NULL &&
+                     strstr(reply.body, "\"brightness\"") == NULL && strstr(reply.body, "\"msg\"") == NULL,
+                     "an older version gets only the changed field");
+    printf("       %.*s\n", (int)reply.body_length, reply.body);
+
+    sprintf(url, "/led_matrix/retrieve/changes?since=%08lX-%lu", (unsigned long)(boot_nonce ^ 1), (unsigned long)display_get_context()->version);
+    http_get(url, NULL);
+    passed &= expect(reply.status == 200 && strstr(reply.body, "\"msg\":\"hello\"") != NULL, "a version from another boot gets the full state");
+    http_get("/led_matrix/retrieve/changes?since=2", NULL);
+    passed &= expect(reply.status == 200 && strstr(reply.body, "\"brightness\":5") != NULL, "a bare number gets the full state");
+    http_get("/led_matrix/retrieve/changes", NULL);
+    passed &= expect(reply.status == 200 && strstr(reply.body, "\"msg\":\"hello\"") != NULL, "no version gets the full state");
+
+    // The same state after a reboot is another ETag, as its version token differs
+    http_get("/led_matrix/retrieve/all", NULL);
+    snprintf(etag, sizeof(etag), "%s", reply_header("ETag"));
+    http_get("/led_matrix/retrieve/all", etag);
+    passed &= expect(reply.status == 304, "retrieve/all revalidates with its ETag");
+    zn_app_deinit();
+    zn_app_init();
+    http_get("/led_matrix/retrieve/all", etag);
+    passed &= expect(reply.status == 200 && strcmp(reply_header("ETag"), etag) != 0, "a reboot changes the ETag");
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_writer(void)
+{
+    static const char expected[] = "\"say \\\"hi\\\" \\\\ to\\n\\tall\\r \\u0007\\u001F caf\xc3\xa9\"";
+    zos_bool_t passed = ZOS_TRUE;
+    writer_t writer;
+    uint32_t pairs = 0;
+    char quotes[201];
+
+    printf("\nwriter JSON escaping\n");
+
+    output_length = 0;
+    writer_init(&writer, output_flush, NULL);
+    writer_json_str(&writer, "say \"hi\" \\ to\n\tall\r \x07\x1f caf\xc3\xa9");
+    writer_finish(&writer);
+    passed &= expect(strcmp(output, expected) == 0, "quotes, backslashes and control characters escaped, UTF-8 untouched");
+
+    // A string written in pieces, as a streamed message is, escapes the same as in one go
+    output_length = 0;
+    writer_init(&writer, output_flush, NULL);
+    writer_char(&writer, '"');
+    writer_json_data(&writer, "say \"hi\" \\ to\n\tall\r", strlen("say \"hi\" \\ to\n\tall\r"));
+    writer_json_data(&writer, " \x07\x1f caf\xc3\xa9", strlen(" \x07\x1f caf\xc3\xa9"));
+    writer_char(&writer, '"');
+    writer_finish(&writer);
+    passed &= expect(strcmp(output, expected) == 0, "the same string written in two pieces");
+
+    // Every escape of a run longer than the buffer survives the flushes in between
+    memset(quotes, '"', sizeof(quotes) - 1);
+    quotes[sizeof(quotes) - 1] = 0;
+    output_length = 0;
+    writer_init(&writer, output_flush, NULL);
+    writer_json_str(&writer, quotes);
+    writer_finish(&writer);
+    for(const char *c = &output[1]; c[0] == '\\' && c[1] == '"'; c += 2)
+    {
+        ++pairs;
+    }
+    passed &= expect(output_length == 2 + 2 * 200 && pairs == 200, "200 escaped quotes across two buffer flushes");
+
+    // A line writer (no flush) latches the overflow and keeps its line terminated
+    writer_init(&writer, NULL, NULL);
+    writer_json_str(&writer, quotes);
+    passed &= expect(writer.result == ZOS_BUFFER_OVERFLOW && strlen(writer_line(&writer)) == WRITER_BUFFER_SIZE - 1,
+                     "a line longer than the buffer fails, terminated");
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+/*
+ * An animation file with one frame of the given type and payload, and 'width' and 'frames'
+ * in its header
+ */
+static void write_animation(const char *name, uint16_t width, uint16_t frames, uint8_t type, const uint8_t *payload, uint16_t length)
+{
+    uint8_t data[CHECK_ANIMATION_HEADER_SIZE + 3 + 512] = { 'L', 'M', 'A', '1' };
+
+    data[4] = width & 0xFF;
+    data[5] = width >> 8;
+    data[6] = DISPLAY_HEIGHT;
+    data[7] = CHECK_ANIMATION_FLAG_LOOP;
+    data[8] = frames & 0xFF;
+    data[9] = frames >> 8;
+    data[10] = 100;
+    data[CHECK_ANIMATION_HEADER_SIZE] = type;
+    data[CHECK_ANIMATION_HEADER_SIZE + 1] = length & 0xFF;
+    data[CHECK_ANIMATION_HEADER_SIZE + 2] = length >> 8;
+    memcpy(&data[CHECK_ANIMATION_HEADER_SIZE + 3], payload, length);
+    write_file(name, data, CHECK_ANIMATION_HEADER_SIZE + 3 + length);
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_animation(void)
+{
+    static const uint8_t literal[] = { 7, 1, 2, 3, 4, 5, 6, 7, 8 };             // 8 columns
+    static const uint8_t too_long[] = { 8, 1, 2, 3, 4, 5, 6, 7, 8, 9 };         // 9 columns
+    static const uint8_t too_short[] = { 6, 1, 2, 3, 4, 5, 6, 7 };              // 7 columns
+    static const uint8_t repeat_over[] = { 4, 1, 2, 3, 4, 5, 4 + 125, 0xFF };  // 5 + 4 columns
+    static const uint8_t length_short[] = { 7, 1, 2, 3 };                      // literal cut off by the frame length
+    static const uint8_t delta_over[] = { 6, 3, 1, 2, 3 };                      // columns 6 to 8
+    uint8_t wide[2 * (1 + 128)];                                                // 256 columns
+    char message[sizeof(display_get_context()->text)];
+    uint32_t text_version;
+    zos_bool_t passed = ZOS_TRUE;
+
+    restart_app("animation decoder bounds");
+
+    memset(wide, 0x55, sizeof(wide));
+    wide[0] = wide[1 + 128] = 127;
+
+    write_animation("good.anim", 8, 1, CHECK_ANIMATION_KEY, literal, sizeof(literal));
+    passed &= expect(animation_play("good.anim") == ZOS_SUCCESS && animation_get_context()->width == 8, "a well formed key frame plays");
+
+    // Frames that decode cleanly to the width in their header, so only the header check refuses them
+    write_animation("wide.anim", ANIMATION_MAX_WIDTH + 1, 1, CHECK_ANIMATION_KEY, wide, sizeof(wide));
+    passed &= expect(animation_play("wide.anim") != ZOS_SUCCESS, "a frame wider than ANIMATION_MAX_WIDTH is refused");
+    write_animation("empty.anim", 0, 1, CHECK_ANIMATION_KEY, literal, 0);
+    passed &= expect(animation_play("empty.anim") != ZOS_SUCCESS, "a zero width is refused");
+    write_animation("long.anim", 8, 1, CHECK_ANIMATION_KEY, too_long, sizeof(too_long));
+    passed &= expect(animation_play("long.anim") != ZOS_SUCCESS, "a literal run past the width is refused");
+    write_animation("short.anim", 8, 1, CHECK_ANIMATION_KEY, too_short, sizeof(too_short));
+    passed &= expect(animation_play("short.anim") != ZOS_SUCCESS, "a key frame short of the width is refused");
+    write_animation("repeat.anim", 8, 1, CHECK_ANIMATION_KEY, repeat_over, sizeof(repeat_over));
+    passed &= expect(animation_play("repeat.anim") != ZOS_SUCCESS, "a repeated run past the width is refused");
+    write_animation("cut.anim", 8, 1, CHECK_ANIMATION_KEY, length_short, sizeof(length_short));
+    passed &= expect(animation_play("cut.anim") != ZOS_SUCCESS, "a run longer than its frame is refused");
+    write_animation("type.anim", 8, 1, 7, literal, sizeof(literal));
+    passed &= expect(animation_play("type.anim") != ZOS_SUCCESS, "an unknown frame type is refused");
+    passed &= expect(animation_get_context()->file[0] == 0, "nothing left playing after a refusal");
+
+    // A delta frame past the width, after a good key frame: found at the tick, playback stops
+    {
+        uint8_t data[CHECK_ANIMATION_HEADER_SIZE + 3 + sizeof(literal) + 3 + sizeof(delta_over)] = { 'L', 'M', 'A', '1', 8, 0, DISPLAY_HEIGHT, 0, 2, 0, 100 };
+        uint8_t *frame = &data[CHECK_ANIMATION_HEADER_SIZE];
+
+        frame[0] = CHECK_ANIMATION_KEY;
+        frame[1] = sizeof(literal);
+        memcpy(&frame[3], literal, sizeof(literal));
+        frame += 3 + sizeof(literal);
+        frame[0] = CHECK_ANIMATION_DELTA;
+        frame[1] = sizeof(delta_over);
+        memcpy(&frame[3], delta_over, sizeof(delta_over));
+        write_file("delta.anim", data, sizeof(data));
+
+        passed &= expect(animation_play("delta.anim") == ZOS_SUCCESS, "the key frame before a bad delta plays");
+        zos_host_advance(100);
+        passed &= expect(animation_get_context()->file[0] == 0, "a delta run past the width stops playback");
+    }
+
+    // A file cut off after its header promised two frames stops at the missing one, and the
+    // message it covered comes back
+    zos_host_advance(100);
+    snprintf(message, sizeof(message), "%s", display_get_context()->text);
+    text_version = display_get_context()->modified.text;
+    write_animation("truncated.anim", 8, 2, CHECK_ANIMATION_KEY, literal, sizeof(literal));
+    passed &= expect(animation_play("truncated.anim") == ZOS_SUCCESS, "the first frame of a truncated file plays");
+    zos_host_advance(100);
+    passed &= expect(animation_get_context()->file[0] == 0, "the missing frame stops playback");
+    passed &= expect(strcmp(display_get_context()->text, message) == 0 && display_get_context()->modified.text != text_version,
+                     "the missing frame gives the panel back to the message");
+    zos_host_reset_counters();
+    zos_host_advance(1000);
+    passed &= expect(zos_host_counters()->i2c_transactions > 0, "the message scrolls again after a missing frame");
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+static uint16_t crc16(const uint8_t *data, uint32_t length)
+{
+    // CRC-16/CCITT, as the journal checks its records with
+    uint16_t crc = 0xFFFF;
+
+    while(length-- > 0)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+        for(uint8_t bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/*************************************************************************************************/
+/*
+ * A journal record with a valid checksum holding a text message of 'length' characters,
+ * the text repeated as needed
+ */
+static void write_journal_record(uint8_t slot, uint32_t sequence, const char *text, uint16_t length)
+{
+    uint8_t data[JOURNAL_HEADER_SIZE + 5 + 512] = { 'L', 'M', 'J', '1' };
+    const uint16_t payload_length = 5 + length;
+    char filename[32];
+    uint16_t crc;
+
+    for(uint8_t i = 0; i < 4; ++i)
+    {
+        data[4 + i] = sequence >> (i * 8);
+    }
+    data[8] = payload_length & 0xFF;
+    data[9] = payload_length >> 8;
+    data[JOURNAL_HEADER_SIZE + 0] = 1;          // brightness
+    data[JOURNAL_HEADER_SIZE + 2] = 50;         // scroll rate
+    for(uint16_t i = 0; i < length; ++i)
+    {
+        data[JOURNAL_HEADER_SIZE + 5 + i] = text[i % strlen(text)];
+    }
+    crc = crc16(data, JOURNAL_HEADER_SIZE + payload_length);
+    data[10] = crc & 0xFF;
+    data[11] = crc >> 8;
+
+    sprintf(filename, CHECK_JOURNAL_FILENAME, (unsigned)slot);
+    write_file(filename, data, JOURNAL_HEADER_SIZE + payload_length);
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_journal(void)
+{
+    zos_bool_t passed = ZOS_TRUE;
+    uint8_t data[JOURNAL_HEADER_SIZE + JOURNAL_PAYLOAD_SIZE];
+    char filename[32];
+    uint32_t length;
+    uint8_t latest;
+
+    restart_app("journal fallback");
+
+    http_get("/led_matrix/update?text=first&brightness=4", NULL);
+    journal_flush();
+    http_get("/led_matrix/update?text=second&brightness=9", NULL);
+    journal_flush();
+    passed &= expect(journal_get_context()->writes == 2, "two records written");
+
+    // The latest record torn by a reset: its last bytes never reached the flash
+    latest = journal_get_context()->slot;
+    sprintf(filename, CHECK_JOURNAL_FILENAME, (unsigned)latest);
+    length = read_file(filename, data, sizeof(data));
+    write_file(filename, data, length - 3);
+    display_set_text("neither");
+    journal_restore();
+    passed &= expect(strcmp(display_get_context()->text, "first") == 0 && display_get_context()->brightness == 4,
+                     "a torn latest record falls back to the one before");
+
+    // Whole again but with a flipped bit, it fails its checksum
+    data[JOURNAL_HEADER_SIZE + 6] ^= 0x01;
+    write_file(filename, data, length);
+    display_set_text("neither");
+    journal_restore();
+    passed &= expect(strcmp(display_get_context()->text, "first") == 0, "a record failing its checksum falls back");
+
+    // A newer record written here is replayed, so the next one is refused for its length alone
+    write_journal_record(latest, 1000, "valid", 5);
+    journal_restore();
+    passed &= expect(strcmp(display_get_context()->text, "valid") == 0, "a record written by the check itself is replayed");
+    write_journal_record(latest, 1000, "long ", JOURNAL_PAYLOAD_SIZE - 5 + 1);
+    display_set_text("neither");
+    journal_restore();
+    passed &= expect(strcmp(display_get_context()->text, "first") == 0, "a valid record too long for the display is skipped");
+
+    // With every record gone bad there is nothing to restore
+    for(uint8_t slot = 0; slot < JOURNAL_SLOTS; ++slot)
+    {
+        sprintf(filename, CHECK_JOURNAL_FILENAME, (unsigned)slot);
+        write_file(filename, "LMJ1", 4);
+    }
+    passed &= expect(journal_restore() == ZOS_NOT_FOUND, "no valid record, nothing restored");
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_playlist(void)
+{
+    zos_bool_t passed = ZOS_TRUE;
+    char shown[128] = "";
+
+    restart_app("playlist priority, repeat and restore");
+
+    http_get("/led_matrix/update?text=base", NULL);
+
+    // Equal priorities take turns until each has used its repeats, then the message comes back
+    http_post("/led_matrix/update/playlist?repeat=2&dwell=1000", "A");
+    http_post("/led_matrix/update/playlist?repeat=1&dwell=1000", "B");
+    zos_host_run_events();
+    for(uint8_t i = 0; i < 4; ++i)
+    {
+        strcat(shown, display_get_context()->text);
+        strcat(shown, " ");
+        zos_host_advance(1000);
+    }
+    passed &= expect(strcmp(shown, "A B A base ") == 0, "A B A, then the message it interrupted");
+    printf("       shown: %s\n", shown);
+
+    // A higher priority interrupts at once and hands back when it is done
+    http_post("/led_matrix/update/playlist?repeat=0&dwell=1000", "forever");
+    zos_host_run_events();
+    zos_host_advance(500);
+    http_post("/led_matrix/update/playlist?priority=2&repeat=1&dwell=1000", "urgent");
+    zos_host_run_events();
+    passed &= expect(strcmp(display_get_context()->text, "urgent") == 0, "a higher priority message preempts");
+    zos_host_advance(1000);
+    passed &= expect(strcmp(display_get_context()->text, "forever") == 0, "and gives the display back when done");
+
+    // Clearing stops the playlist and restores the message
+    http_get("/led_matrix/update/playlist?clear=1", NULL);
+    zos_host_run_events();
+    passed &= expect(strcmp(display_get_context()->text, "base") == 0 && playlist_get_context()->count == 0,
+                     "clear empties it and restores the message");
+
+    // Values that do not fit the message's fields are refused, nothing is queued
+    http_post("/led_matrix/update/playlist?priority=256", "over");
+    passed &= expect(reply.status == 400, "a priority over 255 is refused");
+    http_post("/led_matrix/update/playlist?repeat=4294967297", "wraps");
+    passed &= expect(reply.status == 400, "a repeat that wraps a 32 bit number is refused");
+    http_post("/led_matrix/update/playlist?repeat=", "empty");
+    passed &= expect(reply.status == 400, "an empty repeat is refused");
+    http_post("/led_matrix/update/playlist?priority=high", "word");
+    passed &= expect(reply.status == 400, "a priority that is not a number is refused");
+    http_post("/led_matrix/update/playlist?dwell=-1", "negative");
+    passed &= expect(reply.status == 400, "a negative dwell is refused");
+    zos_host_run_events();
+    passed &= expect(playlist_get_context()->count == 0 && strcmp(display_get_context()->text, "base") == 0, "none of them is queued");
+    http_post("/led_matrix/update/playlist?priority=255&repeat=255&dwell=1000", "edge");
+    zos_host_run_events();
+    passed &= expect(reply.status == 200 && strcmp(display_get_context()->text, "edge") == 0 &&
+                     playlist_get_context()->current->message.priority == 255, "255 is accepted");
+    http_get("/led_matrix/update/playlist?clear=1", NULL);
+    zos_host_run_events();
+
+    // New text from anywhere else stops it and is not overwritten
+    http_post("/led_matrix/update/playlist?repeat=0&dwell=1000", "again");
+    zos_host_run_events();
+    http_get("/led_matrix/update?text=user", NULL);
+    zos_host_advance(3000);
+    passed &= expect(strcmp(display_get_context()->text, "user") == 0 && playlist_get_context()->current == NULL,
+                     "new text stops the playlist");
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+static void send_frame(uint32_t sequence, uint8_t flags, uint8_t column)
+{
+    uint8_t frame[STREAM_HEADER_SIZE + DISPLAY_PANEL_WIDTH] = { 'L', 'F', flags, 0 };
+
+    frame[4] = sequence & 0xFF;
+    frame[5] = (sequence >> 8) & 0xFF;
+    frame[6] = (sequence >> 16) & 0xFF;
+    frame[7] = sequence >> 24;
+    memset(&frame[STREAM_HEADER_SIZE], column, DISPLAY_PANEL_WIDTH);
+    zos_host_udp_send(STREAM_UDP_PORT, frame, sizeof(frame));
+    zos_host_run_events();
+    zos_host_advance(33);
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_stream(void)
+{
+    const stream_context_t *stream = stream_get_context();
+    zos_bool_t passed = ZOS_TRUE;
+
+    restart_app("stream sequence wrap and restart");
+
+    http_get("/led_matrix/update?text=message", NULL);
+    zos_host_advance(100);
+
+    // Across the 2^32 wrap each frame is newer than the last
+    send_frame(0xFFFFFFFE, 0, 0x01);
+    send_frame(0xFFFFFFFF, 0, 0x02);
+    send_frame(0, 0, 0x03);
+    send_frame(1, 0, 0x04);
+    passed &= expect(stream->frames == 4 && stream->sequence == 1 && stream->late == 0, "frames across the wrap are all shown");
+
+    // Behind the wrap is late
+    send_frame(0xFFFFFFFF, 0, 0x05);
+    send_frame(1, 0, 0x05);
+    passed &= expect(stream->frames == 4 && stream->late == 2, "a pre-wrap and a duplicate frame are dropped");
+
+    // A sender that starts over flags its first frame
+    send_frame(0x100, 0, 0x06);
+    send_frame(7, STREAM_FLAG_RESTART, 0x07);
+    send_frame(8, 0, 0x08);
+    passed &= expect(stream->frames == 7 && stream->sequence == 8, "a restart frame resets the sequence");
+
+    // After the idle timeout the message comes back and any sequence starts a new stream
+    zos_host_advance(STREAM_IDLE_TIMEOUT + 500);
+    passed &= expect(!stream->active && strcmp(display_get_context()->text, "message") == 0, "the message comes back when the stream stops");
+    send_frame(3, 0, 0x09);
+    passed &= expect(stream->active && stream->sequence == 3 && stream->sessions == 2, "a new stream starts at any sequence number");
+
+    // Malformed datagrams are counted and otherwise ignored
+    zos_host_udp_send(STREAM_UDP_PORT, "LF\0\0\4\0\0\0", 8);
+    zos_host_udp_send(STREAM_UDP_PORT, "XX\0\0\4\0\0\0\1", 9);
+    zos_host_run_events();
+    passed &= expect(stream->invalid == 2 && stream->sequence == 3, "header-only and unknown datagrams are invalid");
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_event_thread(void)
+{
+    const http_server_request_t *request;
+    zos_bool_t passed = ZOS_TRUE;
+    struct timespec start, end;
+    uint32_t waited;
+
+    restart_app("hand-over to the event thread");
+
+    http_get("/led_matrix/update?text=first", NULL);
+    passed &= expect(reply.status == 200 && strcmp(display_get_context()->text, "first") == 0,
+                     "a page on the HTTP server thread has its change made by the event thread");
+
+    // Called on the event thread itself, nothing runs the hand-over: the page gives up
+    request = zos_host_http_prepare("/led_matrix/update?text=stalled", &reply);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    zos_host_http_find("/led_matrix/update")(request, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    waited = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    printf("       %lu after %lums\n", (unsigned long)reply.status, (unsigned long)waited);
+    passed &= expect(reply.status == 503 && waited >= EVENT_CALL_TIMEOUT, "a page the event thread does not answer gets a 503");
+
+    // The abandoned event comes round later and finds the call taken back
+    zos_host_run_events();
+    passed &= expect(strcmp(display_get_context()->text, "first") == 0, "the change given up on is not made later");
+
+    http_get("/led_matrix/update?text=second", NULL);
+    passed &= expect(reply.status == 200 && strcmp(display_get_context()->text, "second") == 0, "the next page hands over as before");
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+static zos_bool_t scan_completed;
+
+/*************************************************************************************************/
+static void scan_completed_handler(void *arg)
+{
+    scan_completed = ZOS_TRUE;
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_scan(void)
+{
+    zos_bool_t passed = ZOS_TRUE;
+    uint32_t records = 0;
+    char total[16];
+
+    restart_app("scan page");
+
+    http_get("/led_matrix/retrieve/scan?refresh=1", NULL);
+    passed &= expect(reply.status == 200 && strstr(reply.body, "\"scanning\":true") != NULL && scanner_get_context()->channel != 0,
+                     "refresh=1 starts a sweep");
+
+    zos_host_advance(1000);
+    http_get("/led_matrix/retrieve/scan?limit=4", NULL);
+    sprintf(total, "\"total\":%u", (unsigned)scanner_get_context()->count);
+    for(const char *record = strstr(reply.body, "\"bssid\""); record != NULL; record = strstr(record + 1, "\"bssid\""))
+    {
+        ++records;
+    }
+    passed &= expect(scanner_get_context()->sweeps == 1 && strstr(reply.body, total) != NULL && records == 4,
+                     "the page lists the swept cache, a page at a time");
+
+    // A refresh joining a sweep started with a completion handler leaves the handler be
+    scan_completed = ZOS_FALSE;
+    scanner_start(scan_completed_handler);
+    http_get("/led_matrix/retrieve/scan?refresh=1", NULL);
+    zos_host_advance(1000);
+    passed &= expect(scan_completed && scanner_get_context()->sweeps == 2, "a refresh during a sweep keeps the sweep's completion handler");
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+/*
+ * Serve 'resource' to a request with the given Accept-Encoding, NULL for none
+ */
+static zos_result_t serve_resource(static_resource_t *resource, const char *accept_encoding)
+{
+    const http_server_request_t *request = zos_host_http_prepare("/check.html", &reply);
+
+    if(accept_encoding != NULL)
+    {
+        zos_host_http_add_header(request, "Accept-Encoding", accept_encoding);
+    }
+    reply.body[0] = 0;
+
+    return static_resource_write(request, resource);
+}
+
+/*************************************************************************************************/
+static zos_bool_t check_static_resource(void)
+{
+    static const char * const accepted[] = { "gzip", "gzip, deflate, br", "deflate;q=1.0, GZIP;q=0.5", "*", "identity;q=0.5, *", "gzip;q=0.001" };
+    static const char * const refused[] = { "identity", "deflate, br", "gzip;q=0", "gzip; q=0.000, deflate", "*;q=0", "*, gzip;q=0", "xgzip" };
+    static_resource_t resource = { "check.html.gz", "text/html" };
+    zos_bool_t passed = ZOS_TRUE;
+    char label[64];
+
+    restart_app("static resource content coding");
+
+    write_file("check.html.gz", (const uint8_t*)"\x1f\x8b", 2);
+
+    serve_resource(&resource, NULL);
+    passed &= expect(reply.status == 200 && strcmp(reply_header("Content-Encoding"), "gzip") == 0 &&
+                     strcmp(reply_header("Vary"), "Accept-Encoding") == 0, "no Accept-Encoding takes gzip, and the reply varies on it");
+    for(uint8_t i = 0; i < sizeof(accepted)/sizeof(accepted[0]); ++i)
+    {
+        serve_resource(&resource, accepted[i]);
+        snprintf(label, sizeof(label), "'%s' is served gzip", accepted[i]);
+        passed &= expect(reply.status == 200, label);
+    }
+    for(uint8_t i = 0; i < sizeof(refused)/sizeof(refused[0]); ++i)
+    {
+        serve_resource(&resource, refused[i]);
+        snprintf(label, sizeof(label), "'%s' gets a 406", refused[i]);
+        passed &= expect(reply.status == 406 && strcmp(reply_header("Vary"), "Accept-Encoding") == 0, label);
+    }
+
+    return report(passed);
+}
+
+/*************************************************************************************************/
+int main(int argc, char *argv[])
+{
+    zos_bool_t passed = ZOS_TRUE;
+
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage: %s <fs roots> <write dir>\n", argv[0]);
+        return 2;
+    }
+    zos_host_set_fs_root(argv[1]);
+    zos_host_set_fs_write_root(argv[2]);
+    write_dir = argv[2];
+    zos_host_set_log_enabled(getenv("CHECK_LOG") != NULL);
+
+    passed &= check_display();
+    passed &= check_retrieve_changes();
+    passed &= check_writer();
+    passed &= check_animation();
+    passed &= check_journal();
+    passed &= check_playlist();
+    passed &= check_stream();
+    passed &= check_event_thread();
+    passed &= check_scan();
+    passed &= check_static_resource();
+
+    zn_app_deinit();
+
+    printf("\n%s\n", passed ? "All checks passed" : "Some checks FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,567 @@
+/*
+ * Host load generator for the led_matrix HTTP pages.
+ *
+ * Replays request traces (see host/traces/) from a number of simulated clients against
+ * the app's dynamic pages, the way the module's HTTP server would call them, and reports
+ * per endpoint latency percentiles, failed requests and throughput at each concurrency
+ * level.
+ *
+ * The module's HTTP server serves requests one at a time, and a request that changes the
+ * display waits for the app's event thread to make the change between the display's timer
+ * events. The run is a simulation of the two threads taking turns: each request (with the
+ * event thread's share of it) and each batch of due timers is executed for real and the CPU
+ * time it takes measured, and the simulated clock moves on by that much (times the -x factor). Requests from other clients meanwhile queue up, so the
+ * reported latency is queueing plus service time, as a client on the network would see it.
+ * Clients wait for their reply, then for the think time of their next trace line.
+ *
+ * With -z the think times are ignored: every client sends its next request as soon as it
+ * has the reply to the last, so the server is never idle and the requests per second are
+ * its capacity. Latency is then mostly the queue in front of each request, the service
+ * time of every other client's request, so a page getting slower shows at every endpoint
+ * and well above the host's timing noise.
+ *
+ * With -b, the p99 of each endpoint is compared to a baseline from an earlier run and the
+ * exit status is non-zero when one regressed by more than the -t ratio, or when any
+ * request failed. An endpoint whose baseline p99 is well below the level's median has
+ * its increase judged against the median instead: a few microseconds of host noise are
+ * not a regression of a page that takes five. Endpoints with fewer than LOAD_MIN_SAMPLES
+ * requests at a level are reported but not compared. A missing or empty baseline is an error, so the comparison
+ * cannot quietly turn into recording one. -r records the run's p99s as the new baseline.
+ *
+ *   led_matrix_load <fs roots> <write dir> [-c 1,16,64] [-d seconds] [-x factor] [-z]
+ *                   [-b baseline | -r baseline] [-t ratio] <trace>...
+ */
+
+#include <time.h>
+#include <unistd.h>
+#include "zos_host.h"
+#include "led_matrix.c"
+
+
+#define LOAD_MAX_TRACES         8
+#define LOAD_MAX_CLIENTS        64
+#define LOAD_MAX_LEVELS         8
+#define LOAD_MAX_ENDPOINTS      32
+#define LOAD_MAX_LINE           1024
+#define LOAD_MIN_SAMPLES        100     // fewer requests than this make no meaningful p99
+
+typedef struct
+{
+    uint32_t delay;                     // ms of think time before the request
+    zos_bool_t post;
+    char *url;
+    char *body;                         // POST body, NULL for GET
+} trace_line_t;
+
+typedef struct
+{
+    const char *name;
+    trace_line_t *lines;
+    uint32_t count;
+} trace_t;
+
+typedef struct
+{
+    const trace_t *trace;
+    uint32_t line;                      // next line to send
+    uint64_t ready_at;                  // ns, when the next request is sent
+    char version[24];                   // state version token of the last state reply
+} client_t;
+
+typedef struct
+{
+    char path[64];
+    uint64_t *latencies;                // ns
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t failed;
+} endpoint_t;
+
+typedef struct
+{
+    uint32_t concurrency;
+    char path[64];
+    double p99;                         // us
+} baseline_t;
+
+
+static trace_t traces[LOAD_MAX_TRACES];
+static uint32_t trace_count;
+static client_t clients[LOAD_MAX_CLIENTS];
+static endpoint_t endpoints[LOAD_MAX_ENDPOINTS];
+static uint32_t endpoint_count;
+static baseline_t baseline[LOAD_MAX_LEVELS * LOAD_MAX_ENDPOINTS];
+static uint32_t baseline_count;
+static zos_host_http_reply_t reply;
+static double scale = 1.0;             // host to module CPU time
+static double threshold = 2.0;         // p99 over baseline that counts as a regression
+static zos_bool_t saturate;             // -z, no think time
+
+
+
+/*************************************************************************************************/
+static uint64_t now_ns(void)
+{
+    // CPU time of this process, both the HTTP server and the event thread, so the host being
+    // busy with something else doesn't show up as the app's service time
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*************************************************************************************************/
+static zos_bool_t load_trace(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    trace_t *trace = &traces[trace_count];
+    char line[LOAD_MAX_LINE];
+    uint32_t capacity = 0;
+
+    if(file == NULL || trace_count >= LOAD_MAX_TRACES)
+    {
+        fprintf(stderr, "cannot load trace %s\n", filename);
+        if(file != NULL)
+        {
+            fclose(file);
+        }
+        return ZOS_FALSE;
+    }
+
+    trace->name = filename;
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        char method[8];
+        char url[LOAD_MAX_LINE];
+        uint32_t delay;
+        int body = 0;
+        trace_line_t *entry;
+
+        line[strcspn(line, "\r\n")] = 0;
+        if(line[0] == '#' || line[0] == 0)
+        {
+            continue;
+        }
+        if(sscanf(line, "%u %7s %1023s %n", &delay, method, url, &body) < 3)
+        {
+            fprintf(stderr, "%s: bad line: %s\n", filename, line);
+            fclose(file);
+            return ZOS_FALSE;
+        }
+
+        if(trace->count == capacity)
+        {
+            capacity = (capacity == 0) ? 32 : capacity * 2;
+            trace->lines = realloc(trace->lines, capacity * sizeof(trace_line_t));
+        }
+        entry = &trace->lines[trace->count++];
+        entry->delay = delay;
+        entry->post = (strcmp(method, "POST") == 0);
+        entry->url = strdup(url);
+        entry->body = (entry->post && body > 0) ? strdup(&line[body]) : NULL;
+    }
+    fclose(file);
+
+    if(trace->count == 0)
+    {
+        fprintf(stderr, "%s: no requests\n", filename);
+        return ZOS_FALSE;
+    }
+    ++trace_count;
+
+    return ZOS_TRUE;
+}
+
+/*************************************************************************************************/
+static endpoint_t* get_endpoint(const char *path)
+{
+    for(uint32_t i = 0; i < endpoint_count; ++i)
+    {
+        if(strcmp(endpoints[i].path, path) == 0)
+        {
+            return &endpoints[i];
+        }
+    }
+    if(endpoint_count == LOAD_MAX_ENDPOINTS)
+    {
+        return &endpoints[LOAD_MAX_ENDPOINTS - 1];
+    }
+
+    memcpy(endpoints[endpoint_count].path, path, MIN(strlen(path), sizeof(endpoints[0].path) - 1));
+    return &endpoints[endpoint_count++];
+}
+
+/*************************************************************************************************/
+static void record(endpoint_t *endpoint, uint64_t latency, zos_bool_t failed)
+{
+    if(endpoint->count == endpoint->capacity)
+    {
+        endpoint->capacity = (endpoint->capacity == 0) ? 1024 : endpoint->capacity * 2;
+        endpoint->latencies = realloc(endpoint->latencies, endpoint->capacity * sizeof(uint64_t));
+    }
+    endpoint->latencies[endpoint->count++] = latency;
+    endpoint->failed += failed ? 1 : 0;
+}
+
+/*************************************************************************************************/
+static int compare_latency(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/*************************************************************************************************/
+static double percentile_us(const endpoint_t *endpoint, uint32_t percent)
+{
+    // Nearest rank, the latencies are sorted
+    uint32_t rank = (endpoint->count * percent + 99) / 100;
+
+    return (rank == 0) ? 0.0 : endpoint->latencies[rank - 1] / 1000.0;
+}
+
+/*************************************************************************************************/
+/*
+ * Send the client's next request, returns the simulated service time in ns
+ */
+static uint64_t send_request(client_t *client, endpoint_t **endpoint, zos_bool_t *failed)
+{
+    const trace_line_t *line = &client->trace->lines[client->line];
+    const http_server_request_t *request;
+    char url[LOAD_MAX_LINE + 16];
+    const char *placeholder = strstr(line->url, "{version}");
+    zos_result_t result;
+    uint64_t start, elapsed;
+
+    if(placeholder != NULL)
+    {
+        snprintf(url, sizeof(url), "%.*s%s%s", (int)(placeholder - line->url), line->url,
+                 client->version, placeholder + strlen("{version}"));
+    }
+    else
+    {
+        snprintf(url, sizeof(url), "%s", line->url);
+    }
+
+    request = zos_host_http_prepare(url, &reply);
+    url[strcspn(url, "?")] = 0;
+    *endpoint = get_endpoint(url);
+    if(request == NULL || zos_host_http_find(url) == NULL)
+    {
+        *failed = ZOS_TRUE;
+        return 0;
+    }
+    if(line->body != NULL)
+    {
+        zos_host_http_set_body(request, line->body, strlen(line->body));
+    }
+
+    start = now_ns();
+    result = zos_host_http_serve(request);
+    elapsed = now_ns() - start;
+
+    *failed = (result != ZOS_SUCCESS || reply.status >= 400);
+    if(reply.status == 200 && strncmp(reply.body, "{\"version\":\"", 12) == 0)
+    {
+        const size_t length = strcspn(&reply.body[12], "\"");
+
+        snprintf(client->version, sizeof(client->version), "%.*s", (int)length, &reply.body[12]);
+    }
+
+    return (uint64_t)(elapsed * scale);
+}
+
+/*************************************************************************************************/
+/*
+ * Run the app's timers up to the simulated time 'until', returns their simulated run time
+ */
+static uint64_t run_timers(uint64_t until, uint32_t *host_ms)
+{
+    const uint32_t target = until / 1000000;
+    uint64_t start;
+
+    if(target <= *host_ms)
+    {
+        return 0;
+    }
+
+    start = now_ns();
+    zos_host_advance(target - *host_ms);
+    *host_ms = target;
+
+    return (uint64_t)((now_ns() - start) * scale);
+}
+
+/*************************************************************************************************/
+static int compare_p99(const void *a, const void *b)
+{
+    const double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*************************************************************************************************/
+/*
+ * The median of the baseline p99s at a concurrency level, 0 when it has none
+ */
+static double baseline_median(uint32_t concurrency)
+{
+    double p99s[LOAD_MAX_ENDPOINTS];
+    uint32_t count = 0;
+
+    for(uint32_t i = 0; i < baseline_count && count < LOAD_MAX_ENDPOINTS; ++i)
+    {
+        if(baseline[i].concurrency == concurrency)
+        {
+            p99s[count++] = baseline[i].p99;
+        }
+    }
+    if(count == 0)
+    {
+        return 0.0;
+    }
+    qsort(p99s, count, sizeof(double), compare_p99);
+
+    return p99s[count / 2];
+}
+
+/*************************************************************************************************/
+static zos_bool_t run_level(uint32_t concurrency, uint32_t duration, FILE *save)
+{
+    const uint64_t end = (uint64_t)duration * 1000000000ULL;
+    uint64_t server_free = 0;
+    uint64_t busy = 0;
+    uint32_t host_ms = 0;
+    uint32_t completed = 0, failures = 0;
+    zos_bool_t passed = ZOS_TRUE;
+    const double median = baseline_median(concurrency);
+
+    for(uint32_t i = 0; i < endpoint_count; ++i)
+    {
+        endpoints[i].count = 0;
+        endpoints[i].failed = 0;
+    }
+
+    zn_app_init();
+
+    // Clients are spread over the traces and start at different points of them, a few ms apart
+    for(uint32_t i = 0; i < concurrency; ++i)
+    {
+        client_t *client = &clients[i];
+
+        client->trace = &traces[i % trace_count];
+        client->line = (i / trace_count * 7) % client->trace->count;
+        client->ready_at = saturate ? 0 : (uint64_t)i * 3000000ULL;
+        strcpy(client->version, "0");
+    }
+
+    for(;;)
+    {
+        client_t *client = &clients[0];
+        endpoint_t *endpoint;
+        zos_bool_t failed;
+        uint64_t start, done;
+
+        // The server takes the longest waiting request once it is free
+        for(uint32_t i = 1; i < concurrency; ++i)
+        {
+            if(clients[i].ready_at < client->ready_at)
+            {
+                client = &clients[i];
+            }
+        }
+        start = MAX(client->ready_at, server_free);
+        if(start >= end)
+        {
+            break;
+        }
+
+        // Timer events due by then run first on the same thread
+        start += run_timers(start, &host_ms);
+        done = start + send_request(client, &endpoint, &failed);
+
+        record(endpoint, done - client->ready_at, failed);
+        busy += done - MAX(client->ready_at, server_free);
+        server_free = done;
+        ++completed;
+        failures += failed ? 1 : 0;
+
+        client->line = (client->line + 1) % client->trace->count;
+        client->ready_at = done + (saturate ? 0 : (uint64_t)client->trace->lines[client->line].delay * 1000000ULL);
+    }
+
+    zn_app_deinit();
+    zos_host_run_events();
+
+    printf("\nconcurrency %lu: %lu requests in %lus, %.1f req/s, %lu failed, server busy %.2f%%\n",
+           (unsigned long)concurrency, (unsigned long)completed, (unsigned long)duration,
+           (double)completed / duration, (unsigned long)failures, 100.0 * busy / end);
+    printf("  %-32s %8s %10s %10s %8s\n", "endpoint", "requests", "p50 us", "p99 us", "failed");
+
+    for(uint32_t i = 0; i < endpoint_count; ++i)
+    {
+        endpoint_t *endpoint = &endpoints[i];
+        const char *verdict = "";
+        double p50, p99;
+
+        if(endpoint->count == 0)
+        {
+            continue;
+        }
+        qsort(endpoint->latencies, endpoint->count, sizeof(uint64_t), compare_latency);
+        p50 = percentile_us(endpoint, 50);
+        p99 = percentile_us(endpoint, 99);
+
+        for(uint32_t j = 0; j < baseline_count; ++j)
+        {
+            if(baseline[j].concurrency == concurrency && strcmp(baseline[j].path, endpoint->path) == 0 &&
+               endpoint->count >= LOAD_MIN_SAMPLES)
+            {
+                if(p99 - baseline[j].p99 > (threshold - 1.0) * MAX(baseline[j].p99, median))
+                {
+                    verdict = "REGRESSED";
+                    passed = ZOS_FALSE;
+                }
+                break;
+            }
+        }
+        if(endpoint->failed > 0)
+        {
+            verdict = "FAILED";
+            passed = ZOS_FALSE;
+        }
+
+        printf("  %-32s %8lu %10.1f %10.1f %8lu%s%s\n", endpoint->path, (unsigned long)endpoint->count,
+               p50, p99, (unsigned long)endpoint->failed, (verdict[0] != 0) ? "  " : "", verdict);
+        if(save != NULL)
+        {
+            fprintf(save, "%lu %s %.1f\n", (unsigned long)concurrency, endpoint->path, p99);
+        }
+    }
+
+    return passed;
+}
+
+/*************************************************************************************************/
+static zos_bool_t load_baseline(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    unsigned long concurrency;
+    char path[64];
+    double p99;
+
+    if(file == NULL)
+    {
+        return ZOS_FALSE;
+    }
+    // '#' lines are comments
+    while(baseline_count < sizeof(baseline)/sizeof(baseline[0]) &&
+          fscanf(file, " #%*[^\n]") != EOF &&
+          fscanf(file, "%lu %63s %lf", &concurrency, path, &p99) == 3)
+    {
+        baseline[baseline_count].concurrency = concurrency;
+        strcpy(baseline[baseline_count].path, path);
+        baseline[baseline_count].p99 = p99;
+        ++baseline_count;
+    }
+    fclose(file);
+
+    return baseline_count > 0;
+}
+
+/*************************************************************************************************/
+int main(int argc, char **argv)
+{
+    uint32_t levels[LOAD_MAX_LEVELS] = { 1, 16, 64 };
+    uint32_t level_count = 3;
+    uint32_t duration = 300;
+    const char *baseline_file = NULL;
+    const char *record_file = NULL;
+    FILE *save = NULL;
+    zos_bool_t passed = ZOS_TRUE;
+    int opt;
+
+    if(argc < 4)
+    {
+        fprintf(stderr, "usage: %s <fs roots> <write dir> [-c 1,16,64] [-d seconds] [-x factor] [-z] [-b baseline | -r baseline] [-t ratio] <trace>...\n", argv[0]);
+        return 2;
+    }
+    zos_host_set_fs_root(argv[1]);
+    zos_host_set_fs_write_root(argv[2]);
+    zos_host_set_log_enabled(ZOS_FALSE);
+
+    optind = 3;
+    while((opt = getopt(argc, argv, "c:d:x:zb:r:t:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'c':
+            level_count = 0;
+            for(char *level = strtok(optarg, ","); level != NULL && level_count < LOAD_MAX_LEVELS; level = strtok(NULL, ","))
+            {
+                levels[level_count++] = MIN(MAX(atoi(level), 1), LOAD_MAX_CLIENTS);
+            }
+            break;
+        case 'd':
+            duration = MAX(atoi(optarg), 1);
+            break;
+        case 'x':
+            scale = atof(optarg);
+            break;
+        case 'z':
+            saturate = ZOS_TRUE;
+            break;
+        case 'b':
+            baseline_file = optarg;
+            break;
+        case 'r':
+            record_file = optarg;
+            break;
+        case 't':
+            threshold = atof(optarg);
+            break;
+        default:
+            return 2;
+        }
+    }
+
+    for(int i = optind; i < argc; ++i)
+    {
+        if(!load_trace(argv[i]))
+        {
+            return 2;
+        }
+    }
+    if(trace_count == 0)
+    {
+        fprintf(stderr, "no traces given\n");
+        return 2;
+    }
+
+    if(baseline_file != NULL && !load_baseline(baseline_file))
+    {
+        fprintf(stderr, "No baseline in %s, record one with -r (make load-baseline)\n", baseline_file);
+        return 2;
+    }
+    if(record_file != NULL)
+    {
+        if((save = fopen(record_file, "w")) == NULL)
+        {
+            fprintf(stderr, "cannot write %s\n", record_file);
+            return 2;
+        }
+        fprintf(save, "# p99 latency in us per concurrency level and endpoint, recorded by led_matrix_load -r%s\n", saturate ? " -z" : "");
+        printf("Recording the baseline to %s\n", record_file);
+    }
+
+    for(uint32_t i = 0; i < level_count; ++i)
+    {
+        passed &= run_level(levels[i], duration, save);
+    }
+
+    if(save != NULL)
+    {
+        fclose(save);
+    }
+
+    printf("\n%s\n", passed ? "Load test passed" : "Load test FAILED");
+    return passed ? 0 : 1;
+}
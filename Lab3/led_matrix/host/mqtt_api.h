@@ -0,0 +1,69 @@
+/*
+ * Host stand-in for the SDK's MQTT client library, backed by the broker stand-in in
+ * zos_host.c.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+typedef uint16_t mqtt_msgid_t;
+
+#define MQTT_PROTOCOL_VER4                  4
+#define MQTT_QOS_DELIVER_AT_MOST_ONCE       0
+#define MQTT_QOS_DELIVER_AT_LEAST_ONCE      1
+
+typedef enum
+{
+    MQTT_EVENT_TYPE_CONNECTED,
+    MQTT_EVENT_TYPE_DISCONNECTED,
+    MQTT_EVENT_TYPE_PUBLISHED,
+    MQTT_EVENT_TYPE_SUBCRIBED,
+    MQTT_EVENT_TYPE_UNSUBSCRIBED,
+    MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED
+} mqtt_event_type_t;
+
+typedef struct
+{
+    uint8_t *topic;
+    uint16_t topic_len;
+    uint8_t *data;
+    uint32_t data_len;
+} mqtt_topic_msg_t;
+
+typedef struct
+{
+    mqtt_event_type_t type;
+    union
+    {
+        mqtt_msgid_t msgid;
+        mqtt_topic_msg_t pub_recvd;
+    } data;
+} mqtt_event_info_t;
+
+typedef zos_result_t (*mqtt_callback_t)(mqtt_event_info_t *event);
+
+typedef struct
+{
+    uint8_t mqtt_version;
+    uint8_t clean_session;
+    uint8_t *client_id;
+    uint16_t keep_alive;
+    uint8_t *username;
+    uint8_t *password;
+} mqtt_pkt_connect_t;
+
+typedef struct
+{
+    mqtt_callback_t callback;
+    zos_bool_t open;
+} mqtt_connection_t;
+
+zos_result_t mqtt_init(mqtt_connection_t *conn);
+zos_result_t mqtt_deinit(mqtt_connection_t *conn);
+zos_result_t mqtt_open(mqtt_connection_t *conn, const char *host, uint16_t port, zos_interface_t iface, mqtt_callback_t callback, zos_bool_t security);
+zos_result_t mqtt_connect(mqtt_connection_t *conn, const mqtt_pkt_connect_t *conninfo);
+zos_result_t mqtt_disconnect(mqtt_connection_t *conn);
+mqtt_msgid_t mqtt_publish(mqtt_connection_t *conn, const uint8_t *topic, const uint8_t *data, uint32_t length, uint8_t qos);
+mqtt_msgid_t mqtt_subscribe(mqtt_connection_t *conn, const uint8_t *topic, uint8_t qos);
+mqtt_msgid_t mqtt_unsubscribe(mqtt_connection_t *conn, const uint8_t *topic);
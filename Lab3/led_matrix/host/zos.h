@@ -0,0 +1,328 @@
+/*
+ * Host (Linux) stand-in for the subset of the ZentriOS SDK used by the led_matrix app.
+ *
+ * Only the types, macros and zn_* calls the app actually references are declared here.
+ * The behaviour behind them lives in zos_host.c and is deliberately simple: enough for the
+ * app sources to compile unmodified on a PC so they can be profiled and exercised without
+ * a board on the bench. Nothing in this directory is part of the firmware build.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+
+/******************************************************
+ *                 Basic types
+ ******************************************************/
+typedef int zos_result_t;
+typedef uint8_t zos_bool_t;
+
+#define ZOS_TRUE                    1
+#define ZOS_FALSE                   0
+
+#define ZOS_SUCCESS                 0
+#define ZOS_ERROR                   1
+#define ZOS_TIMEOUT                 2
+#define ZOS_BADARG                  5
+#define ZOS_NO_MEM                  6
+#define ZOS_NOT_FOUND               7
+#define ZOS_BUFFER_OVERFLOW         8
+#define ZOS_UNSUPPORTED             9
+
+#define ZOS_FAILED(result, func)    (((result) = (func)) != ZOS_SUCCESS)
+
+#ifndef MIN
+#define MIN(x,y)                    (((x) < (y)) ? (x) : (y))
+#endif
+#ifndef MAX
+#define MAX(x,y)                    (((x) > (y)) ? (x) : (y))
+#endif
+
+#define ZOS_LOG(fmt, ...)           zn_host_log(fmt, ##__VA_ARGS__)
+
+void zn_host_log(const char *fmt, ...);
+
+
+/******************************************************
+ *                 Platform
+ ******************************************************/
+typedef enum
+{
+    ZOS_WLAN,
+    ZOS_SOFTAP,
+    ZOS_ETHERNET
+} zos_interface_t;
+
+typedef int zos_gpio_t;
+typedef int zos_i2c_t;
+
+#define PLATFORM_BUTTON1            0
+#define PLATFORM_STD_I2C            0
+#define PLATFORM_ENABLE_JTAG_GPIOS()
+
+zos_result_t zn_get_random_buffer(void *buffer, uint16_t length);
+
+
+/******************************************************
+ *                 Buttons
+ ******************************************************/
+typedef void (*button_handler_t)(void *arg);
+
+typedef enum
+{
+    BUTTON_ACTIVE_HIGH,
+    BUTTON_ACTIVE_LOW
+} button_active_level_t;
+
+typedef struct
+{
+    button_active_level_t active_level;
+    uint16_t debounce;
+    uint16_t click_time;
+    uint16_t press_time;
+    struct
+    {
+        button_handler_t press;
+        button_handler_t click;
+        button_handler_t toggle;
+    } event_handler;
+} button_config_t;
+
+zos_result_t button_init(zos_gpio_t gpio, const button_config_t *config, void *arg);
+void button_deinit(zos_gpio_t gpio);
+
+
+/******************************************************
+ *                 Event loop / RTOS
+ ******************************************************/
+typedef void (*zos_event_handler_t)(void *arg);
+
+#define RUN_NOW                     (1 << 0)
+#define EVENT_FLAGS1(a)             (a)
+
+zos_result_t zn_event_issue(zos_event_handler_t handler, void *arg, uint32_t flags);
+zos_result_t zn_event_register_periodic(zos_event_handler_t handler, void *arg, uint32_t period_ms, uint32_t flags);
+zos_result_t zn_event_register_timed(zos_event_handler_t handler, void *arg, uint32_t delay_ms, uint32_t flags);
+void zn_event_unregister(zos_event_handler_t handler, void *arg);
+uint32_t zn_rtos_get_time(void);
+
+#define ZOS_WAIT_FOREVER            0xFFFFFFFF
+
+typedef struct
+{
+    volatile uint32_t count;
+} zos_semaphore_t;
+
+zos_result_t zn_rtos_semaphore_init(zos_semaphore_t *semaphore);
+zos_result_t zn_rtos_semaphore_set(zos_semaphore_t *semaphore);
+zos_result_t zn_rtos_semaphore_get(zos_semaphore_t *semaphore, uint32_t timeout_ms);
+zos_result_t zn_rtos_semaphore_deinit(zos_semaphore_t *semaphore);
+
+
+/******************************************************
+ *                 I2C
+ ******************************************************/
+typedef enum
+{
+    I2C_CLOCK_STANDARD_SPEED,
+    I2C_CLOCK_HIGH_SPEED
+} zos_i2c_speed_t;
+
+typedef struct
+{
+    zos_i2c_t port;
+    uint16_t address;
+    zos_i2c_speed_t speed;
+    uint16_t retries;
+    uint16_t read_timeout;
+} zos_i2c_device_t;
+
+zos_result_t zn_i2c_master_write(const zos_i2c_device_t *device, const uint8_t *data, uint16_t size);
+
+
+/******************************************************
+ *                 Settings
+ ******************************************************/
+zos_result_t zn_load_app_settings(const char *filename);
+char* zn_host_get_setting_str(const char *name, char *buffer);
+
+#define ZOS_GET_SETTING_STR(name, buffer)   zn_host_get_setting_str(name, buffer)
+
+
+/******************************************************
+ *                 Memory
+ ******************************************************/
+zos_result_t zn_malloc(uint8_t **ptr, uint32_t size);
+void zn_free(void *ptr);
+
+
+/******************************************************
+ *                 File system
+ ******************************************************/
+typedef enum
+{
+    ZOS_FILE_TYPE_MISC = 0xFE
+} zos_file_type_t;
+
+typedef struct
+{
+    char name[96];
+    uint32_t size;
+    zos_file_type_t type;
+    uint32_t version;
+} zos_file_t;
+
+zos_result_t zn_file_open(const char *name, uint32_t *handle);
+zos_result_t zn_file_read(uint32_t handle, void *data, uint32_t size, uint32_t *bytes_read);
+zos_result_t zn_file_close(uint32_t handle);
+zos_result_t zn_file_create(const zos_file_t *file, uint32_t *handle);
+zos_result_t zn_file_write(uint32_t handle, const void *data, uint32_t size);
+zos_result_t zn_file_delete(const char *name);
+
+
+/******************************************************
+ *                 Network
+ ******************************************************/
+typedef struct
+{
+    uint8_t octet[6];
+} zos_mac_t;
+
+typedef struct
+{
+    uint8_t len;
+    uint8_t value[32];
+} zos_ssid_t;
+
+typedef enum
+{
+    ZOS_BSS_TYPE_INFRASTRUCTURE,
+    ZOS_BSS_TYPE_ADHOC
+} zos_bss_type_t;
+
+typedef enum
+{
+    ZOS_SECURITY_OPEN,
+    ZOS_SECURITY_WEP_PSK,
+    ZOS_SECURITY_WPA_TKIP_PSK,
+    ZOS_SECURITY_WPA_AES_PSK,
+    ZOS_SECURITY_WPA2_AES_PSK,
+    ZOS_SECURITY_WPA2_TKIP_PSK,
+    ZOS_SECURITY_WPA2_MIXED_PSK,
+    ZOS_SECURITY_UNKNOWN
+} zos_security_t;
+
+typedef struct zos_scan_result
+{
+    struct zos_scan_result *next;
+    zos_ssid_t SSID;
+    zos_mac_t BSSID;
+    int16_t signal_strength;
+    uint32_t max_data_rate;
+    zos_bss_type_t bss_type;
+    zos_security_t security;
+    uint8_t channel;
+} zos_scan_result_t;
+
+zos_bool_t zn_network_is_up(zos_interface_t iface);
+zos_result_t zn_network_up(zos_interface_t iface, zos_bool_t blocking);
+zos_result_t zn_network_restart(zos_interface_t iface);
+zos_result_t zn_network_register_event_handler(zos_interface_t iface, zos_event_handler_t handler); // arg is the link state, NULL to unregister
+zos_result_t zn_network_get_mac(char *mac_str);
+zos_result_t zn_network_scan(zos_scan_result_t **results_ptr, uint8_t channel, const char *ssid);
+void zn_network_scan_destroy_results(void);
+
+typedef void (*zos_stream_receive_handler_t)(uint32_t handle);
+
+zos_result_t zn_udp_server(uint16_t listen_port, uint32_t *handle);
+zos_result_t zn_udp_register_receive_event_handler(uint32_t handle, zos_stream_receive_handler_t receive_handler);
+zos_result_t zn_network_read(uint32_t handle, void *data, uint32_t max_size, uint32_t *bytes_read);
+zos_result_t zn_network_close(uint32_t handle);
+
+
+/******************************************************
+ *                 HTTP server
+ ******************************************************/
+typedef struct
+{
+    const char *key;
+    const char *value;
+} http_server_param_t;
+
+typedef struct http_server_request http_server_request_t;
+
+typedef zos_result_t (*http_server_processor_t)(const http_server_request_t *request, const char *arg);
+
+typedef struct
+{
+    const char *path;
+    http_server_processor_t processor;
+} http_server_dynamic_page_t;
+
+#define HTTP_SERVER_HEADER_NONE     0
+
+#define HTTP_SERVER_DYNAMIC_PAGES_START             static const http_server_dynamic_page_t app_dynamic_pages[] = {
+#define HTTP_SERVER_DYNAMIC_PAGE(path, processor)   { path, processor }
+#define HTTP_SERVER_DYNAMIC_PAGES_END               { NULL, NULL } };
+#define HTTP_SERVER_REGISTER_DYNAMIC_PAGES()        zn_hs_register_dynamic_pages(app_dynamic_pages)
+
+void zn_hs_register_dynamic_pages(const http_server_dynamic_page_t *pages);
+const http_server_param_t* zn_hs_get_param(const http_server_request_t *request, const char *key);
+const char* zn_hs_get_header(const http_server_request_t *request, const char *name);
+zos_result_t zn_hs_read_post_data(const http_server_request_t *request, void *data, uint32_t max_length, uint32_t *bytes_read);
+zos_result_t zn_hs_add_reply_header(const http_server_request_t *request, const char *name, const char *value);
+zos_result_t zn_hs_write_reply_status(const http_server_request_t *request, uint16_t status);
+zos_result_t zn_hs_write_reply_header(const http_server_request_t *request, const char *content_type, int32_t content_length, uint32_t flags);
+zos_result_t zn_hs_write_chunked_data(const http_server_request_t *request, const void *data, uint32_t length, zos_bool_t is_final);
+
+
+/******************************************************
+ *                 Console commands
+ ******************************************************/
+typedef enum
+{
+    ZOS_CMD_SUCCESS,
+    ZOS_CMD_FAILED,
+    ZOS_CMD_BAD_ARGS
+} zos_cmd_result_t;
+
+typedef zos_cmd_result_t (*zos_cmd_handler_t)(int argc, char **argv);
+
+typedef struct
+{
+    const char *name;
+    zos_cmd_handler_t handler;
+    uint8_t min_args;
+    uint8_t max_args;
+} zos_command_t;
+
+#define ZOS_COMMANDS_START                                  static const zos_command_t app_commands[] = {
+#define ZOS_COMMAND(name, handler, min_args, max_args)      { name, handler, min_args, max_args }
+#define ZOS_COMMANDS_END                                    { NULL, NULL, 0, 0 } };
+#define ZOS_REGISTER_COMMANDS()                             zn_cmd_register_commands(app_commands)
+
+void zn_cmd_register_commands(const zos_command_t *commands);
+
+
+/******************************************************
+ *                 String utilities
+ ******************************************************/
+typedef char fpi_str_buffer_t[16];
+
+uint32_t str_to_uint32(const char *str);
+char* int_to_str(int32_t value, char *str);
+char* fpi_int_to_str(char *str, int32_t value, float divisor, uint8_t precision);
+char* mac_to_str(const zos_mac_t *mac, char *str);
+char* ssid_to_str(char *str, const zos_ssid_t *ssid);
+
+
+/******************************************************
+ *                 App entry points
+ ******************************************************/
+void zn_app_init(void);
+void zn_app_deinit(void);
+zos_bool_t zn_app_idle(void);
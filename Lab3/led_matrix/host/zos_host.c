@@ -0,0 +1,1452 @@
+/*
+ * Host (Linux) implementation of the ZentriOS stand-in declared in zos.h.
+ *
+ * Everything here uses static storage so the allocation counters only ever see the
+ * allocations made by the app itself.
+ *
+ * The thread driving the stand-in (zos_host_run_events(), zos_host_advance()) plays the
+ * app's event thread. Page processors run on a thread of their own, as the module's HTTP
+ * server calls them, and zos_host_http_serve() keeps running the events they issue until
+ * the page returns. Semaphores block that thread for real, with the timeout in real time,
+ * so a page waiting on the event thread is only released by the event thread.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <strings.h>
+#include <time.h>
+#include "zos_host.h"
+#include "mqtt_api.h"
+
+
+#define HOST_MAX_FILES              8
+#define HOST_MAX_EVENTS             32
+#define HOST_MAX_TIMERS             16
+#define HOST_MAX_PARAMS             8
+#define HOST_MAX_HEADERS            4
+#define HOST_MAX_SCAN_RECORDS       64
+#define HOST_UDP_HANDLE             100     // apart from file handles
+#define HOST_UDP_QUEUE              8       // datagrams buffered by the UDP server socket
+#define HOST_UDP_MAX_DATAGRAM       1472
+#define HOST_URL_MAX                1024
+#define HOST_MQTT_TOPICS            4       // subscriptions, and topics the client's messages are kept for
+#define HOST_MQTT_MAX_TOPIC         64
+#define HOST_MQTT_MAX_MESSAGE       1024
+#define HOST_MQTT_QUEUE             8       // messages on their way to the client
+#define HOST_JOIN_TIME              1800    // ms a non-blocking network join takes
+
+struct http_server_request
+{
+    const char *path;
+    http_server_param_t params[HOST_MAX_PARAMS];
+    uint32_t param_count;
+    http_server_param_t headers[HOST_MAX_HEADERS];
+    uint32_t header_count;
+    const uint8_t *body;
+    uint32_t body_remaining;
+    char content_length[12];
+    zos_host_http_reply_t *reply;
+};
+
+typedef struct
+{
+    zos_event_handler_t handler;
+    void *arg;
+} host_event_t;
+
+typedef struct
+{
+    zos_event_handler_t handler;
+    void *arg;
+    uint32_t period;                // 0 for a one-shot timed event
+    uint32_t due;
+} host_timer_t;
+
+
+static zos_bool_t log_enabled = ZOS_TRUE;
+static const char *fs_root = "resources";
+static const char *fs_write_root = NULL;
+static FILE *files[HOST_MAX_FILES];
+static host_event_t events[HOST_MAX_EVENTS];
+static uint32_t event_head, event_tail;
+static host_timer_t timers[HOST_MAX_TIMERS];
+static uint32_t host_time;                  // ms since power-on, only moved by zos_host_advance()
+static button_config_t button_config;
+static void *button_arg;
+static const http_server_dynamic_page_t *dynamic_pages;
+static const zos_command_t *commands;
+static zos_scan_result_t scan_records[HOST_MAX_SCAN_RECORDS];
+static uint32_t scan_record_count = 12;
+static zos_bool_t network_up = ZOS_TRUE;
+static zos_bool_t network_joinable = ZOS_TRUE;
+static zos_event_handler_t network_event_handler;
+static zos_host_counters_t counters;
+
+// Guards the event queue and the hand-over to the HTTP server thread. One condition for
+// both: an event issued, a page started or finished.
+static pthread_mutex_t host_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_changed = PTHREAD_COND_INITIALIZER;
+
+// The semaphores have their own, so setting one (stats.c takes one as a lock on every
+// sample) only wakes a thread when one is waiting on a semaphore, as on the module
+static pthread_mutex_t semaphore_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t semaphore_changed = PTHREAD_COND_INITIALIZER;
+static uint32_t semaphore_waiters;
+
+static struct
+{
+    zos_bool_t started;
+    http_server_processor_t processor;
+    const http_server_request_t *request;   // page the thread is to run, NULL once it returned
+    zos_result_t result;
+} http_server;
+
+static struct
+{
+    uint16_t port;                  // 0 when no server is open
+    zos_stream_receive_handler_t handler;
+    uint8_t datagrams[HOST_UDP_QUEUE][HOST_UDP_MAX_DATAGRAM];
+    uint32_t lengths[HOST_UDP_QUEUE];
+    uint32_t head, tail;
+} udp;
+
+typedef struct
+{
+    char topic[HOST_MQTT_MAX_TOPIC];
+    uint8_t data[HOST_MQTT_MAX_MESSAGE + 1];
+    uint32_t length;
+} host_mqtt_message_t;
+
+static struct
+{
+    zos_bool_t reachable;
+    mqtt_connection_t *connection;  // the one client, NULL when it is not connected
+    mqtt_msgid_t next_msgid;
+    char subscriptions[HOST_MQTT_TOPICS][HOST_MQTT_MAX_TOPIC];
+    host_mqtt_message_t published[HOST_MQTT_TOPICS];     // last message from the client per topic
+    host_mqtt_message_t queue[HOST_MQTT_QUEUE];
+    uint32_t head, tail;
+    zos_host_broker_stats_t stats;
+} broker = { .reachable = ZOS_TRUE };
+
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+
+/*************************************************************************************************/
+void zn_host_log(const char *fmt, ...)
+{
+    char buffer[256];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+
+    if(log_enabled)
+    {
+        printf("%s\n", buffer);
+    }
+}
+
+/*************************************************************************************************/
+void zos_host_set_log_enabled(zos_bool_t enabled)
+{
+    log_enabled = enabled;
+}
+
+/*************************************************************************************************/
+zos_host_counters_t* zos_host_counters(void)
+{
+    return &counters;
+}
+
+/*************************************************************************************************/
+void zos_host_reset_counters(void)
+{
+    memset(&counters, 0, sizeof(counters));
+}
+
+
+/*************************************************************************************************
+ * Memory
+ *
+ * The bench links with -Wl,--wrap for the libc allocators so heap use by the app is counted
+ * the same way as zn_malloc().
+ */
+void *__wrap_malloc(size_t size)
+{
+    ++counters.heap_mallocs;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    ++counters.heap_mallocs;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    ++counters.heap_mallocs;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    __real_free(ptr);
+}
+
+/*************************************************************************************************/
+zos_result_t zn_malloc(uint8_t **ptr, uint32_t size)
+{
+    ++counters.zn_mallocs;
+    *ptr = __real_malloc(size);
+    return (*ptr != NULL) ? ZOS_SUCCESS : ZOS_NO_MEM;
+}
+
+/*************************************************************************************************/
+void zn_free(void *ptr)
+{
+    __real_free(ptr);
+}
+
+
+/*************************************************************************************************
+ * Event loop / RTOS
+ */
+zos_result_t zn_event_issue(zos_event_handler_t handler, void *arg, uint32_t flags)
+{
+    zos_result_t result = ZOS_SUCCESS;
+    const uint32_t next = (event_tail + 1) % HOST_MAX_EVENTS;
+
+    pthread_mutex_lock(&host_lock);
+    if(next == event_head)
+    {
+        result = ZOS_NO_MEM;
+    }
+    else
+    {
+        events[event_tail].handler = handler;
+        events[event_tail].arg = arg;
+        event_tail = next;
+        pthread_cond_broadcast(&host_changed);
+    }
+    pthread_mutex_unlock(&host_lock);
+
+    return result;
+}
+
+/*************************************************************************************************/
+void zos_host_run_events(void)
+{
+    for(;;)
+    {
+        host_event_t event;
+
+        pthread_mutex_lock(&host_lock);
+        if(event_head == event_tail)
+        {
+            pthread_mutex_unlock(&host_lock);
+            break;
+        }
+        event = events[event_head];
+        event_head = (event_head + 1) % HOST_MAX_EVENTS;
+        pthread_mutex_unlock(&host_lock);
+
+        event.handler(event.arg);
+    }
+}
+
+/*************************************************************************************************/
+static zos_result_t register_timer(zos_event_handler_t handler, void *arg, uint32_t delay, uint32_t period)
+{
+    host_timer_t *slot = NULL;
+
+    for(host_timer_t *timer = timers; timer < &timers[HOST_MAX_TIMERS]; ++timer)
+    {
+        if(timer->handler == handler && timer->arg == arg)
+        {
+            slot = timer;
+            break;
+        }
+        else if(timer->handler == NULL && slot == NULL)
+        {
+            slot = timer;
+        }
+    }
+
+    if(slot == NULL)
+    {
+        return ZOS_NO_MEM;
+    }
+    slot->handler = handler;
+    slot->arg = arg;
+    slot->period = period;
+    slot->due = host_time + delay;
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_event_register_periodic(zos_event_handler_t handler, void *arg, uint32_t period_ms, uint32_t flags)
+{
+    return register_timer(handler, arg, (flags & RUN_NOW) ? 0 : period_ms, period_ms);
+}
+
+/*************************************************************************************************/
+zos_result_t zn_event_register_timed(zos_event_handler_t handler, void *arg, uint32_t delay_ms, uint32_t flags)
+{
+    return register_timer(handler, arg, delay_ms, 0);
+}
+
+/*************************************************************************************************/
+void zn_event_unregister(zos_event_handler_t handler, void *arg)
+{
+    for(host_timer_t *timer = timers; timer < &timers[HOST_MAX_TIMERS]; ++timer)
+    {
+        if(timer->handler == handler && timer->arg == arg)
+        {
+            memset(timer, 0, sizeof(host_timer_t));
+        }
+    }
+}
+
+/*************************************************************************************************/
+void zos_host_advance(uint32_t ms)
+{
+    const uint32_t target = host_time + ms;
+
+    // Events already issued run before any timer, as on the module's event loop
+    zos_host_run_events();
+
+    for(;;)
+    {
+        host_timer_t *next = NULL;
+
+        for(host_timer_t *timer = timers; timer < &timers[HOST_MAX_TIMERS]; ++timer)
+        {
+            if(timer->handler != NULL && (int32_t)(timer->due - target) <= 0 &&
+              (next == NULL || (int32_t)(timer->due - next->due) < 0))
+            {
+                next = timer;
+            }
+        }
+        if(next == NULL)
+        {
+            break;
+        }
+
+        const host_timer_t fired = *next;
+        host_time = fired.due;
+        if(fired.period > 0)
+        {
+            next->due += fired.period;
+        }
+        else
+        {
+            memset(next, 0, sizeof(host_timer_t));
+        }
+
+        ++counters.timer_wakeups;
+        fired.handler(fired.arg);
+        zos_host_run_events();
+    }
+
+    host_time = target;
+}
+
+/*************************************************************************************************/
+uint32_t zn_rtos_get_time(void)
+{
+    // Purely simulated, so runs do not depend on how fast or loaded the host is
+    return host_time;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_rtos_semaphore_init(zos_semaphore_t *semaphore)
+{
+    semaphore->count = 0;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_rtos_semaphore_set(zos_semaphore_t *semaphore)
+{
+    pthread_mutex_lock(&semaphore_lock);
+    ++semaphore->count;
+    if(semaphore_waiters > 0)
+    {
+        pthread_cond_broadcast(&semaphore_changed);
+    }
+    pthread_mutex_unlock(&semaphore_lock);
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*
+ * Blocks the calling thread until the semaphore is set or 'timeout_ms' of real time has
+ * passed; the simulated clock does not move meanwhile
+ */
+zos_result_t zn_rtos_semaphore_get(zos_semaphore_t *semaphore, uint32_t timeout_ms)
+{
+    zos_result_t result = ZOS_SUCCESS;
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&semaphore_lock);
+    ++semaphore_waiters;
+    while(semaphore->count == 0)
+    {
+        if(timeout_ms == ZOS_WAIT_FOREVER)
+        {
+            pthread_cond_wait(&semaphore_changed, &semaphore_lock);
+        }
+        else if(pthread_cond_timedwait(&semaphore_changed, &semaphore_lock, &deadline) == ETIMEDOUT && semaphore->count == 0)
+        {
+            result = ZOS_TIMEOUT;
+            break;
+        }
+    }
+    --semaphore_waiters;
+    if(result == ZOS_SUCCESS)
+    {
+        --semaphore->count;
+    }
+    pthread_mutex_unlock(&semaphore_lock);
+
+    return result;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_rtos_semaphore_deinit(zos_semaphore_t *semaphore)
+{
+    return ZOS_SUCCESS;
+}
+
+
+/*************************************************************************************************
+ * Buttons
+ */
+zos_result_t button_init(zos_gpio_t gpio, const button_config_t *config, void *arg)
+{
+    button_config = *config;
+    button_arg = arg;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+void button_deinit(zos_gpio_t gpio)
+{
+    memset(&button_config, 0, sizeof(button_config));
+}
+
+/*************************************************************************************************/
+void zos_host_press_button(zos_gpio_t gpio)
+{
+    if(button_config.event_handler.press != NULL)
+    {
+        button_config.event_handler.press(button_arg);
+    }
+}
+
+
+/*************************************************************************************************
+ * I2C
+ */
+zos_result_t zn_i2c_master_write(const zos_i2c_device_t *device, const uint8_t *data, uint16_t size)
+{
+    ++counters.i2c_transactions;
+    counters.i2c_bytes += 1 + size;
+    return ZOS_SUCCESS;
+}
+
+
+/*************************************************************************************************
+ * Settings
+ */
+zos_result_t zn_load_app_settings(const char *filename)
+{
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+char* zn_host_get_setting_str(const char *name, char *buffer)
+{
+    strcpy(buffer, (strcmp(name, "wlan.network.ip") == 0) ? "127.0.0.1" : "");
+    return buffer;
+}
+
+
+/*************************************************************************************************
+ * File system
+ *
+ * Files are looked up by their base name in the resource directories (a ':' separated
+ * list), which matches the way the manifest places them on the module. Files the app
+ * creates go to the write root, when one is set, so host runs never modify the app's
+ * resources; it is searched first.
+ */
+void zos_host_set_fs_root(const char *path)
+{
+    fs_root = path;
+}
+
+/*************************************************************************************************/
+void zos_host_set_fs_write_root(const char *path)
+{
+    fs_write_root = path;
+}
+
+/*************************************************************************************************/
+static void host_file_path(char *path, size_t size, const char *root, const char *name)
+{
+    const char *base = strrchr(name, '/');
+    snprintf(path, size, "%s/%s", root, (base != NULL) ? base + 1 : name);
+}
+
+/*************************************************************************************************/
+static zos_result_t host_file_open(const char *name, const char *mode, uint32_t *handle)
+{
+    char path[256];
+
+    for(uint32_t i = 0; i < HOST_MAX_FILES; ++i)
+    {
+        if(files[i] == NULL)
+        {
+            if(fs_write_root != NULL)
+            {
+                host_file_path(path, sizeof(path), fs_write_root, name);
+                files[i] = fopen(path, mode);
+            }
+            for(const char *root = fs_root; files[i] == NULL && *mode == 'r' && *root != 0; )
+            {
+                const size_t len = strcspn(root, ":");
+                char dir[128];
+
+                snprintf(dir, sizeof(dir), "%.*s", (int)len, root);
+                host_file_path(path, sizeof(path), dir, name);
+                files[i] = fopen(path, mode);
+                root += (root[len] == ':') ? len + 1 : len;
+            }
+            if(files[i] == NULL)
+            {
+                return ZOS_NOT_FOUND;
+            }
+            *handle = i + 1;
+            return ZOS_SUCCESS;
+        }
+    }
+
+    return ZOS_NO_MEM;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_open(const char *name, uint32_t *handle)
+{
+    return host_file_open(name, "rb", handle);
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_create(const zos_file_t *file, uint32_t *handle)
+{
+    ++counters.file_creates;
+    return host_file_open(file->name, "wb", handle);
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_write(uint32_t handle, const void *data, uint32_t size)
+{
+    if(handle == 0 || handle > HOST_MAX_FILES || files[handle-1] == NULL)
+    {
+        return ZOS_BADARG;
+    }
+    return (fwrite(data, 1, size, files[handle-1]) == size) ? ZOS_SUCCESS : ZOS_ERROR;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_delete(const char *name)
+{
+    char path[256];
+
+    if(fs_write_root == NULL)
+    {
+        return ZOS_NOT_FOUND;
+    }
+    host_file_path(path, sizeof(path), fs_write_root, name);
+    return (remove(path) == 0) ? ZOS_SUCCESS : ZOS_NOT_FOUND;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_read(uint32_t handle, void *data, uint32_t size, uint32_t *bytes_read)
+{
+    if(handle == 0 || handle > HOST_MAX_FILES || files[handle-1] == NULL)
+    {
+        return ZOS_BADARG;
+    }
+    *bytes_read = fread(data, 1, size, files[handle-1]);
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_file_close(uint32_t handle)
+{
+    if(handle == 0 || handle > HOST_MAX_FILES || files[handle-1] == NULL)
+    {
+        return ZOS_BADARG;
+    }
+    fclose(files[handle-1]);
+    files[handle-1] = NULL;
+    return ZOS_SUCCESS;
+}
+
+
+/*************************************************************************************************
+ * Platform
+ */
+/*
+ * Not random, so runs repeat, but a new value on every call as each boot gets from the
+ * module's hardware generator
+ */
+zos_result_t zn_get_random_buffer(void *buffer, uint16_t length)
+{
+    static uint32_t state = 0x2545F491;
+
+    for(uint8_t *byte = buffer; byte < (uint8_t*)buffer + length; ++byte)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        *byte = (uint8_t)state;
+    }
+
+    return ZOS_SUCCESS;
+}
+
+
+/*************************************************************************************************
+ * Network
+ */
+zos_bool_t zn_network_is_up(zos_interface_t iface)
+{
+    return network_up;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_network_get_mac(char *mac_str)
+{
+    strcpy(mac_str, "4C:55:CC:10:2A:3B");
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*
+ * The link comes and goes through here, telling the app's handler as the OS does
+ */
+static void set_network_up(zos_bool_t up)
+{
+    if(up != network_up)
+    {
+        network_up = up;
+        if(network_event_handler != NULL)
+        {
+            zn_event_issue(network_event_handler, (void*)(uintptr_t)up, 0);
+        }
+    }
+}
+
+/*************************************************************************************************/
+static void join_event_handler(void *arg)
+{
+    set_network_up(ZOS_TRUE);
+}
+
+/*************************************************************************************************/
+/*
+ * A non-blocking join succeeds HOST_JOIN_TIME later, reported as a network event. A network
+ * that cannot be joined (zos_host_set_network_joinable()) fails straight away.
+ */
+zos_result_t zn_network_up(zos_interface_t iface, zos_bool_t blocking)
+{
+    if(network_up)
+    {
+        return ZOS_SUCCESS;
+    }
+    else if(!network_joinable)
+    {
+        return ZOS_NOT_FOUND;
+    }
+    else if(blocking)
+    {
+        set_network_up(ZOS_TRUE);
+        return ZOS_SUCCESS;
+    }
+
+    return register_timer(join_event_handler, NULL, HOST_JOIN_TIME, 0);
+}
+
+/*************************************************************************************************/
+zos_result_t zn_network_restart(zos_interface_t iface)
+{
+    set_network_up(ZOS_FALSE);
+    return zn_network_up(iface, ZOS_TRUE);
+}
+
+/*************************************************************************************************/
+zos_result_t zn_network_register_event_handler(zos_interface_t iface, zos_event_handler_t handler)
+{
+    network_event_handler = handler;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*
+ * The link is up from the start unless told otherwise, as if the module had joined before the
+ * app was initialised. Changing it afterwards raises a network event, like a join or a drop.
+ */
+void zos_host_set_network_up(zos_bool_t up)
+{
+    set_network_up(up);
+}
+
+/*************************************************************************************************/
+void zos_host_set_network_joinable(zos_bool_t joinable)
+{
+    network_joinable = joinable;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_udp_server(uint16_t listen_port, uint32_t *handle)
+{
+    if(udp.port != 0)
+    {
+        return ZOS_ERROR;
+    }
+    memset(&udp, 0, sizeof(udp));
+    udp.port = listen_port;
+    *handle = HOST_UDP_HANDLE;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_udp_register_receive_event_handler(uint32_t handle, zos_stream_receive_handler_t receive_handler)
+{
+    if(handle != HOST_UDP_HANDLE || udp.port == 0)
+    {
+        return ZOS_BADARG;
+    }
+    udp.handler = receive_handler;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_network_read(uint32_t handle, void *data, uint32_t max_size, uint32_t *bytes_read)
+{
+    // One datagram per read, truncated to the buffer like a UDP socket does
+    *bytes_read = 0;
+    if(handle != HOST_UDP_HANDLE || udp.port == 0)
+    {
+        return ZOS_BADARG;
+    }
+    if(udp.tail != udp.head)
+    {
+        const uint32_t slot = udp.tail % HOST_UDP_QUEUE;
+
+        *bytes_read = MIN(udp.lengths[slot], max_size);
+        memcpy(data, udp.datagrams[slot], *bytes_read);
+        ++udp.tail;
+    }
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_network_close(uint32_t handle)
+{
+    if(handle != HOST_UDP_HANDLE)
+    {
+        return ZOS_BADARG;
+    }
+    memset(&udp, 0, sizeof(udp));
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+static void udp_receive_event_handler(void *arg)
+{
+    if(udp.handler != NULL && udp.tail != udp.head)
+    {
+        udp.handler(HOST_UDP_HANDLE);
+    }
+}
+
+/*************************************************************************************************/
+zos_result_t zos_host_udp_send(uint16_t port, const void *data, uint32_t length)
+{
+    // Delivered by the event loop, the way the network stack notifies the app
+    if(port != udp.port || udp.port == 0 || length > HOST_UDP_MAX_DATAGRAM)
+    {
+        return ZOS_NOT_FOUND;
+    }
+    if(udp.head - udp.tail >= HOST_UDP_QUEUE)
+    {
+        ++counters.udp_dropped;
+        return ZOS_SUCCESS;
+    }
+    memcpy(udp.datagrams[udp.head % HOST_UDP_QUEUE], data, length);
+    udp.lengths[udp.head % HOST_UDP_QUEUE] = length;
+    if(udp.head++ == udp.tail)
+    {
+        zn_event_issue(udp_receive_event_handler, NULL, 0);
+    }
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+void zos_host_set_scan_records(uint32_t count)
+{
+    scan_record_count = (count < HOST_MAX_SCAN_RECORDS) ? count : HOST_MAX_SCAN_RECORDS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_network_scan(zos_scan_result_t **results_ptr, uint8_t channel, const char *ssid)
+{
+    zos_scan_result_t *prev = NULL;
+
+    *results_ptr = NULL;
+
+    for(uint32_t i = 0; i < scan_record_count; ++i)
+    {
+        zos_scan_result_t *record = &scan_records[i];
+
+        memset(record, 0, sizeof(*record));
+        record->SSID.len = (i % 5 == 4) ? 0 : sprintf((char*)record->SSID.value, "network-%02u", (unsigned)i);
+        record->BSSID.octet[0] = 0x02;
+        record->BSSID.octet[4] = (uint8_t)(i >> 8);
+        record->BSSID.octet[5] = (uint8_t)i;
+        record->signal_strength = -40 - (int16_t)(i % 50);
+        record->max_data_rate = 54000 + 1000 * (i % 7);
+        record->bss_type = (i % 9 == 8) ? ZOS_BSS_TYPE_ADHOC : ZOS_BSS_TYPE_INFRASTRUCTURE;
+        record->security = (zos_security_t)(i % (ZOS_SECURITY_UNKNOWN + 1));
+        record->channel = 1 + (i % 13);
+
+        if(channel != 0 && record->channel != channel)
+        {
+            continue;
+        }
+        if(prev == NULL)
+        {
+            *results_ptr = record;
+        }
+        else
+        {
+            prev->next = record;
+        }
+        prev = record;
+    }
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+void zn_network_scan_destroy_results(void)
+{
+}
+
+
+/*************************************************************************************************
+ * HTTP server
+ */
+void zn_hs_register_dynamic_pages(const http_server_dynamic_page_t *pages)
+{
+    dynamic_pages = pages;
+}
+
+/*************************************************************************************************/
+const http_server_param_t* zn_hs_get_param(const http_server_request_t *request, const char *key)
+{
+    for(uint32_t i = 0; i < request->param_count; ++i)
+    {
+        if(strcmp(request->params[i].key, key) == 0)
+        {
+            return &request->params[i];
+        }
+    }
+    return NULL;
+}
+
+/*************************************************************************************************/
+const char* zn_hs_get_header(const http_server_request_t *request, const char *name)
+{
+    for(uint32_t i = 0; i < request->header_count; ++i)
+    {
+        if(strcasecmp(request->headers[i].key, name) == 0)
+        {
+            return request->headers[i].value;
+        }
+    }
+    return NULL;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_hs_read_post_data(const http_server_request_t *request, void *data, uint32_t max_length, uint32_t *bytes_read)
+{
+    http_server_request_t *req = (http_server_request_t*)request;
+
+    *bytes_read = MIN(max_length, req->body_remaining);
+    memcpy(data, req->body, *bytes_read);
+    req->body += *bytes_read;
+    req->body_remaining -= *bytes_read;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_hs_add_reply_header(const http_server_request_t *request, const char *name, const char *value)
+{
+    zos_host_http_reply_t *reply = request->reply;
+    const size_t len = strlen(reply->headers);
+
+    snprintf(&reply->headers[len], sizeof(reply->headers) - len, "%s: %s\r\n", name, value);
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_hs_write_reply_status(const http_server_request_t *request, uint16_t status)
+{
+    request->reply->status = status;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_hs_write_reply_header(const http_server_request_t *request, const char *content_type, int32_t content_length, uint32_t flags)
+{
+    zos_host_http_reply_t *reply = request->reply;
+
+    reply->status = 200;
+    snprintf(reply->content_type, sizeof(reply->content_type), "%s", (content_type != NULL) ? content_type : "");
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t zn_hs_write_chunked_data(const http_server_request_t *request, const void *data, uint32_t length, zos_bool_t is_final)
+{
+    zos_host_http_reply_t *reply = request->reply;
+    const uint32_t space = sizeof(reply->body) - 1 - reply->body_length;
+    const uint32_t n = (length < space) ? length : space;
+
+    memcpy(&reply->body[reply->body_length], data, n);
+    reply->body_length += n;
+    reply->body[reply->body_length] = 0;
+    ++reply->chunks;
+
+    return (n == length) ? ZOS_SUCCESS : ZOS_BUFFER_OVERFLOW;
+}
+
+/*************************************************************************************************/
+static void url_decode(char *str)
+{
+    char *out = str;
+
+    for(; *str != 0; ++str)
+    {
+        if(*str == '%' && isxdigit((int)str[1]) && isxdigit((int)str[2]))
+        {
+            const char hex[3] = { str[1], str[2], 0 };
+            *out++ = (char)strtoul(hex, NULL, 16);
+            str += 2;
+        }
+        else
+        {
+            *out++ = (*str == '+') ? ' ' : *str;
+        }
+    }
+    *out = 0;
+}
+
+/*************************************************************************************************/
+const http_server_request_t* zos_host_http_prepare(const char *url, zos_host_http_reply_t *reply)
+{
+    static char buffer[HOST_URL_MAX];
+    static http_server_request_t request;
+    char *query;
+
+    if(strlen(url) >= sizeof(buffer))
+    {
+        return NULL;
+    }
+
+    strcpy(buffer, url);
+    memset(&request, 0, sizeof(request));
+    memset(reply, 0, sizeof(*reply));
+    reply->status = 404;
+    request.reply = reply;
+    request.path = buffer;
+
+    if((query = strchr(buffer, '?')) != NULL)
+    {
+        *query++ = 0;
+        for(char *pair = strtok(query, "&"); pair != NULL && request.param_count < HOST_MAX_PARAMS; pair = strtok(NULL, "&"))
+        {
+            http_server_param_t *param = &request.params[request.param_count++];
+            char *value = strchr(pair, '=');
+
+            if(value != NULL)
+            {
+                *value++ = 0;
+            }
+            url_decode(pair);
+            if(value != NULL)
+            {
+                url_decode(value);
+            }
+            param->key = pair;
+            param->value = (value != NULL) ? value : "";
+        }
+    }
+
+    return &request;
+}
+
+/*************************************************************************************************/
+void zos_host_http_add_header(const http_server_request_t *request, const char *name, const char *value)
+{
+    http_server_request_t *req = (http_server_request_t*)request;
+
+    if(req->header_count < HOST_MAX_HEADERS)
+    {
+        req->headers[req->header_count].key = name;
+        req->headers[req->header_count].value = value;
+        ++req->header_count;
+    }
+}
+
+/*************************************************************************************************/
+void zos_host_http_set_body(const http_server_request_t *request, const void *body, uint32_t length)
+{
+    http_server_request_t *req = (http_server_request_t*)request;
+
+    req->body = body;
+    req->body_remaining = length;
+    sprintf(req->content_length, "%lu", (unsigned long)length);
+    zos_host_http_add_header(request, "Content-Length", req->content_length);
+}
+
+/*************************************************************************************************/
+http_server_processor_t zos_host_http_find(const char *path)
+{
+    for(const http_server_dynamic_page_t *page = dynamic_pages; page != NULL && page->path != NULL; ++page)
+    {
+        if(strcmp(page->path, path) == 0)
+        {
+            return page->processor;
+        }
+    }
+    return NULL;
+}
+
+/*************************************************************************************************/
+static void* http_server_thread(void *arg)
+{
+    pthread_mutex_lock(&host_lock);
+    for(;;)
+    {
+        zos_result_t result;
+
+        while(http_server.request == NULL)
+        {
+            pthread_cond_wait(&host_changed, &host_lock);
+        }
+        pthread_mutex_unlock(&host_lock);
+
+        result = http_server.processor(http_server.request, NULL);
+
+        pthread_mutex_lock(&host_lock);
+        http_server.result = result;
+        http_server.request = NULL;
+        pthread_cond_broadcast(&host_changed);
+    }
+
+    return NULL;
+}
+
+/*************************************************************************************************/
+/*
+ * Run the page for 'request' on the HTTP server thread. The calling thread is the app's
+ * event thread: it runs the events issued meanwhile until the page has returned.
+ */
+zos_result_t zos_host_http_serve(const http_server_request_t *request)
+{
+    const http_server_processor_t processor = zos_host_http_find(request->path);
+    pthread_t thread;
+
+    if(processor == NULL)
+    {
+        return ZOS_NOT_FOUND;
+    }
+
+    pthread_mutex_lock(&host_lock);
+    if(!http_server.started)
+    {
+        pthread_create(&thread, NULL, http_server_thread, NULL);
+        pthread_detach(thread);
+        http_server.started = ZOS_TRUE;
+    }
+    http_server.processor = processor;
+    http_server.request = request;
+    pthread_cond_broadcast(&host_changed);
+
+    while(http_server.request != NULL)
+    {
+        if(event_head != event_tail)
+        {
+            pthread_mutex_unlock(&host_lock);
+            zos_host_run_events();
+            pthread_mutex_lock(&host_lock);
+        }
+        else
+        {
+            pthread_cond_wait(&host_changed, &host_lock);
+        }
+    }
+    pthread_mutex_unlock(&host_lock);
+
+    return http_server.result;
+}
+
+/*************************************************************************************************/
+zos_result_t zos_host_http_get(const char *url, zos_host_http_reply_t *reply)
+{
+    const http_server_request_t *request;
+
+    if((request = zos_host_http_prepare(url, reply)) == NULL)
+    {
+        return ZOS_BADARG;
+    }
+
+    return zos_host_http_serve(request);
+}
+
+
+/*************************************************************************************************
+ * Console commands
+ */
+void zn_cmd_register_commands(const zos_command_t *list)
+{
+    commands = list;
+}
+
+/*************************************************************************************************/
+zos_cmd_result_t zos_host_run_command(const char *line)
+{
+    char buffer[128];
+    char *argv[8];
+    int argc = 0;
+
+    snprintf(buffer, sizeof(buffer), "%s", line);
+    for(char *token = strtok(buffer, " "); token != NULL && argc < 8; token = strtok(NULL, " "))
+    {
+        argv[argc++] = token;
+    }
+
+    for(const zos_command_t *command = commands; argc > 0 && command != NULL && command->name != NULL; ++command)
+    {
+        if(strcmp(command->name, argv[0]) == 0)
+        {
+            if(argc - 1 < command->min_args || argc - 1 > command->max_args)
+            {
+                return ZOS_CMD_BAD_ARGS;
+            }
+            return command->handler(argc - 1, &argv[1]);
+        }
+    }
+
+    return ZOS_CMD_FAILED;
+}
+
+
+/*************************************************************************************************
+ * MQTT client library and broker
+ *
+ * A broker with a single client, reached through the event loop like any other network
+ * traffic: the CONNACK and every message routed to the client arrive as events. Messages
+ * the client publishes are kept, the last one per topic, for the host tools to inspect.
+ */
+zos_result_t mqtt_init(mqtt_connection_t *conn)
+{
+    memset(conn, 0, sizeof(mqtt_connection_t));
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t mqtt_deinit(mqtt_connection_t *conn)
+{
+    mqtt_disconnect(conn);
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t mqtt_open(mqtt_connection_t *conn, const char *host, uint16_t port, zos_interface_t iface, mqtt_callback_t callback, zos_bool_t security)
+{
+    if(!broker.reachable || !network_up)
+    {
+        return ZOS_TIMEOUT;
+    }
+    conn->callback = callback;
+    conn->open = ZOS_TRUE;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+static void connack_event_handler(void *arg)
+{
+    mqtt_event_info_t event = { .type = MQTT_EVENT_TYPE_CONNECTED };
+
+    if(broker.connection != NULL)
+    {
+        broker.connection->callback(&event);
+    }
+}
+
+/*************************************************************************************************/
+zos_result_t mqtt_connect(mqtt_connection_t *conn, const mqtt_pkt_connect_t *conninfo)
+{
+    if(!conn->open)
+    {
+        return ZOS_ERROR;
+    }
+    broker.connection = conn;
+    memset(broker.subscriptions, 0, sizeof(broker.subscriptions));
+    broker.head = broker.tail = 0;
+    ++broker.stats.connects;
+    zn_event_issue(connack_event_handler, NULL, 0);
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+zos_result_t mqtt_disconnect(mqtt_connection_t *conn)
+{
+    if(broker.connection == conn)
+    {
+        broker.connection = NULL;
+    }
+    conn->open = ZOS_FALSE;
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+static mqtt_msgid_t next_msgid(void)
+{
+    // 0 is the library's error value
+    if(++broker.next_msgid == 0)
+    {
+        ++broker.next_msgid;
+    }
+    return broker.next_msgid;
+}
+
+/*************************************************************************************************/
+mqtt_msgid_t mqtt_publish(mqtt_connection_t *conn, const uint8_t *topic, const uint8_t *data, uint32_t length, uint8_t qos)
+{
+    host_mqtt_message_t *slot = NULL;
+
+    if(broker.connection != conn || length > HOST_MQTT_MAX_MESSAGE || strlen((const char*)topic) >= HOST_MQTT_MAX_TOPIC)
+    {
+        return 0;
+    }
+
+    for(host_mqtt_message_t *message = broker.published; message < &broker.published[HOST_MQTT_TOPICS]; ++message)
+    {
+        if(strcmp(message->topic, (const char*)topic) == 0 || (slot == NULL && message->topic[0] == 0))
+        {
+            slot = message;
+        }
+    }
+    if(slot == NULL)
+    {
+        slot = &broker.published[0];
+    }
+    strcpy(slot->topic, (const char*)topic);
+    memcpy(slot->data, data, length);
+    slot->data[length] = 0;
+    slot->length = length;
+
+    ++broker.stats.received;
+    return next_msgid();
+}
+
+/*************************************************************************************************/
+mqtt_msgid_t mqtt_subscribe(mqtt_connection_t *conn, const uint8_t *topic, uint8_t qos)
+{
+    if(broker.connection != conn || strlen((const char*)topic) >= HOST_MQTT_MAX_TOPIC)
+    {
+        return 0;
+    }
+
+    for(uint32_t i = 0; i < HOST_MQTT_TOPICS; ++i)
+    {
+        if(broker.subscriptions[i][0] == 0 || strcmp(broker.subscriptions[i], (const char*)topic) == 0)
+        {
+            strcpy(broker.subscriptions[i], (const char*)topic);
+            return next_msgid();
+        }
+    }
+    return 0;
+}
+
+/*************************************************************************************************/
+mqtt_msgid_t mqtt_unsubscribe(mqtt_connection_t *conn, const uint8_t *topic)
+{
+    for(uint32_t i = 0; i < HOST_MQTT_TOPICS; ++i)
+    {
+        if(strcmp(broker.subscriptions[i], (const char*)topic) == 0)
+        {
+            broker.subscriptions[i][0] = 0;
+        }
+    }
+    return next_msgid();
+}
+
+/*************************************************************************************************/
+static void deliver_event_handler(void *arg)
+{
+    while(broker.tail != broker.head)
+    {
+        host_mqtt_message_t *message = &broker.queue[broker.tail % HOST_MQTT_QUEUE];
+        mqtt_event_info_t event = { .type = MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED };
+
+        event.data.pub_recvd.topic = (uint8_t*)message->topic;
+        event.data.pub_recvd.topic_len = strlen(message->topic);
+        event.data.pub_recvd.data = message->data;
+        event.data.pub_recvd.data_len = message->length;
+        ++broker.tail;
+        ++broker.stats.delivered;
+
+        if(broker.connection != NULL)
+        {
+            broker.connection->callback(&event);
+        }
+    }
+}
+
+/*************************************************************************************************/
+zos_result_t zos_host_broker_publish(const char *topic, const void *data, uint32_t length)
+{
+    zos_bool_t subscribed = ZOS_FALSE;
+    host_mqtt_message_t *message;
+
+    for(uint32_t i = 0; i < HOST_MQTT_TOPICS; ++i)
+    {
+        subscribed |= (strcmp(broker.subscriptions[i], topic) == 0);
+    }
+    if(broker.connection == NULL || !subscribed)
+    {
+        return ZOS_NOT_FOUND;
+    }
+    if(length > HOST_MQTT_MAX_MESSAGE || strlen(topic) >= HOST_MQTT_MAX_TOPIC || broker.head - broker.tail >= HOST_MQTT_QUEUE)
+    {
+        return ZOS_BUFFER_OVERFLOW;
+    }
+
+    message = &broker.queue[broker.head % HOST_MQTT_QUEUE];
+    strcpy(message->topic, topic);
+    memcpy(message->data, data, length);
+    message->length = length;
+    if(broker.head++ == broker.tail)
+    {
+        zn_event_issue(deliver_event_handler, NULL, 0);
+    }
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+const char* zos_host_broker_last_message(const char *topic)
+{
+    for(const host_mqtt_message_t *message = broker.published; message < &broker.published[HOST_MQTT_TOPICS]; ++message)
+    {
+        if(strcmp(message->topic, topic) == 0)
+        {
+            return (const char*)message->data;
+        }
+    }
+    return NULL;
+}
+
+/*************************************************************************************************/
+static void connection_lost_event_handler(void *arg)
+{
+    mqtt_event_info_t event = { .type = MQTT_EVENT_TYPE_DISCONNECTED };
+    mqtt_connection_t *connection = arg;
+
+    connection->callback(&event);
+}
+
+/*************************************************************************************************/
+/*
+ * An unreachable broker refuses new connections and drops the one it has
+ */
+void zos_host_broker_set_reachable(zos_bool_t reachable)
+{
+    broker.reachable = reachable;
+    if(!reachable && broker.connection != NULL)
+    {
+        zn_event_issue(connection_lost_event_handler, broker.connection, 0);
+        broker.connection->open = ZOS_FALSE;
+        broker.connection = NULL;
+    }
+}
+
+/*************************************************************************************************/
+const zos_host_broker_stats_t* zos_host_broker_stats(void)
+{
+    return &broker.stats;
+}
+
+
+/*************************************************************************************************
+ * String utilities
+ */
+uint32_t str_to_uint32(const char *str)
+{
+    return (uint32_t)strtoul(str, NULL, 10);
+}
+
+/*************************************************************************************************/
+char* int_to_str(int32_t value, char *str)
+{
+    sprintf(str, "%ld", (long)value);
+    return str;
+}
+
+/*************************************************************************************************/
+char* fpi_int_to_str(char *str, int32_t value, float divisor, uint8_t precision)
+{
+    sprintf(str, "%.*f", (int)precision, (double)value / divisor);
+    return str;
+}
+
+/*************************************************************************************************/
+char* mac_to_str(const zos_mac_t *mac, char *str)
+{
+    sprintf(str, "%02X:%02X:%02X:%02X:%02X:%02X",
+            mac->octet[0], mac->octet[1], mac->octet[2], mac->octet[3], mac->octet[4], mac->octet[5]);
+    return str;
+}
+
+/*************************************************************************************************/
+char* ssid_to_str(char *str, const zos_ssid_t *ssid)
+{
+    memcpy(str, ssid->value, ssid->len);
+    str[ssid->len] = 0;
+    return str;
+}
@@ -0,0 +1,67 @@
+/*
+ * Controls for the host stand-in of the ZentriOS SDK and the MQTT broker.
+ *
+ * These calls have no firmware equivalent; they let host-side tools drive the app the way
+ * the module's event loop, HTTP server, radio and a remote broker would.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+typedef struct
+{
+    uint32_t zn_mallocs;            // zn_malloc() calls
+    uint32_t heap_mallocs;          // malloc/calloc/realloc calls made from app objects
+    uint32_t i2c_transactions;      // zn_i2c_master_write() calls
+    uint32_t i2c_bytes;             // bytes clocked onto the I2C bus, address byte included
+    uint32_t timer_wakeups;         // timed/periodic events fired by zos_host_advance()
+    uint32_t file_creates;          // zn_file_create() calls, each one erases flash on the module
+    uint32_t udp_dropped;           // datagrams dropped by zos_host_udp_send() as the socket buffer was full
+} zos_host_counters_t;
+
+typedef struct
+{
+    uint32_t connects;              // CONNECT frames accepted
+    uint32_t received;              // PUBLISH frames from the client
+    uint32_t delivered;             // PUBLISH frames routed to the client
+} zos_host_broker_stats_t;
+
+typedef struct
+{
+    int status;
+    char content_type[48];
+    char headers[256];              // extra reply headers, "Name: value\r\n" each
+    char body[4096];
+    uint32_t body_length;
+    uint32_t chunks;
+} zos_host_http_reply_t;
+
+
+void zos_host_set_log_enabled(zos_bool_t enabled);
+void zos_host_set_fs_root(const char *path);
+void zos_host_set_fs_write_root(const char *path);
+void zos_host_set_scan_records(uint32_t count);
+void zos_host_set_network_up(zos_bool_t up);
+void zos_host_set_network_joinable(zos_bool_t joinable);
+zos_result_t zos_host_udp_send(uint16_t port, const void *data, uint32_t length);
+
+zos_host_counters_t* zos_host_counters(void);
+void zos_host_reset_counters(void);
+
+void zos_host_run_events(void);
+void zos_host_advance(uint32_t ms);
+void zos_host_press_button(zos_gpio_t gpio);
+zos_cmd_result_t zos_host_run_command(const char *line);
+
+const http_server_request_t* zos_host_http_prepare(const char *url, zos_host_http_reply_t *reply);
+void zos_host_http_add_header(const http_server_request_t *request, const char *name, const char *value);
+void zos_host_http_set_body(const http_server_request_t *request, const void *body, uint32_t length);
+http_server_processor_t zos_host_http_find(const char *path);
+zos_result_t zos_host_http_serve(const http_server_request_t *request);
+zos_result_t zos_host_http_get(const char *url, zos_host_http_reply_t *reply);
+
+zos_result_t zos_host_broker_publish(const char *topic, const void *data, uint32_t length);
+const char* zos_host_broker_last_message(const char *topic);
+void zos_host_broker_set_reachable(zos_bool_t reachable);
+const zos_host_broker_stats_t* zos_host_broker_stats(void);
@@ -0,0 +1,117 @@
+/*
+ * Minimal driver for the HT16K33 LED controller on the Adafruit 8x8 matrix backpack.
+ *
+ * Only what the display engine needs: oscillator/display setup, dimming, blinking and
+ * writing a contiguous span of rows in a single auto-incrementing I2C transaction.
+ */
+
+#include "zos.h"
+#include "ht16k33.h"
+#include "stats.h"
+
+
+#define HT16K33_CMD_OSCILLATOR_ON   0x21
+#define HT16K33_CMD_DISPLAY_SETUP   0x80
+#define HT16K33_DISPLAY_ON          0x01
+#define HT16K33_CMD_DIMMING         0xE0
+#define HT16K33_I2C_RETRIES         3
+
+
+/*************************************************************************************************/
+zos_result_t ht16k33_init(ht16k33_t *panel, zos_i2c_t port, uint8_t address)
+{
+    zos_result_t result;
+    const uint8_t cmd = HT16K33_CMD_OSCILLATOR_ON;
+    const uint8_t blank[HT16K33_ROWS] = { 0 };
+
+    memset(panel, 0, sizeof(ht16k33_t));
+    panel->device.port = port;
+    panel->device.address = address;
+    panel->device.speed = I2C_CLOCK_HIGH_SPEED;
+    panel->device.retries = HT16K33_I2C_RETRIES;
+    panel->brightness = HT16K33_MAX_BRIGHTNESS;
+    panel->blink_rate = 0;
+
+    if(!ZOS_FAILED(result, panel_write(panel, &cmd, 1)) &&
+       !ZOS_FAILED(result, ht16k33_write_rows(panel, 0, blank, HT16K33_ROWS)))
+    {
+        const uint8_t setup = HT16K33_CMD_DISPLAY_SETUP | HT16K33_DISPLAY_ON;
+        const uint8_t dimming = HT16K33_CMD_DIMMING | HT16K33_MAX_BRIGHTNESS;
+
+        if(!ZOS_FAILED(result, panel_write(panel, &setup, 1)))
+        {
+            result = panel_write(panel, &dimming, 1);
+        }
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+void ht16k33_deinit(ht16k33_t *panel)
+{
+    const uint8_t setup = HT16K33_CMD_DISPLAY_SETUP;
+    panel_write(panel, &setup, 1);
+}
+
+/*************************************************************************************************/
+zos_result_t ht16k33_set_brightness(ht16k33_t *panel, uint8_t brightness)
+{
+    zos_result_t result = ZOS_SUCCESS;
+    const uint8_t cmd = HT16K33_CMD_DIMMING | MIN(brightness, HT16K33_MAX_BRIGHTNESS);
+
+    if(panel->brightness != brightness && !ZOS_FAILED(result, panel_write(panel, &cmd, 1)))
+    {
+        panel->brightness = brightness;
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+zos_result_t ht16k33_set_blink_rate(ht16k33_t *panel, uint8_t rate)
+{
+    zos_result_t result = ZOS_SUCCESS;
+    const uint8_t cmd = HT16K33_CMD_DISPLAY_SETUP | HT16K33_DISPLAY_ON | (MIN(rate, HT16K33_MAX_BLINK_RATE) << 1);
+
+    if(panel->blink_rate != rate && !ZOS_FAILED(result, panel_write(panel, &cmd, 1)))
+    {
+        panel->blink_rate = rate;
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+zos_result_t ht16k33_write_rows(ht16k33_t *panel, uint8_t first_row, const uint8_t *rows, uint8_t count)
+{
+    // Display RAM holds 16 bits per row; the 8x8 backpack only wires the low byte, and wires
+    // it rotated by one: column 0 is bit 7, column 1 is bit 0 and so on.
+    uint8_t buffer[1 + 2*HT16K33_ROWS];
+    uint8_t *ptr = buffer;
+
+    if(first_row + count > HT16K33_ROWS)
+    {
+        return ZOS_BADARG;
+    }
+
+    *ptr++ = first_row * 2;
+    for(const uint8_t *end = rows + count; rows < end; ++rows)
+    {
+        *ptr++ = (uint8_t)((*rows >> 1) | (*rows << 7));
+        *ptr++ = 0;
+    }
+
+    return panel_write(panel, buffer, ptr - buffer);
+}
+
+/*************************************************************************************************/
+static zos_result_t panel_write(ht16k33_t *panel, const uint8_t *data, uint16_t size)
+{
+    const uint32_t start = stats_time_us();
+    const zos_result_t result = zn_i2c_master_write(&panel->device, data, size);
+
+    stats_record_i2c(1 + size, stats_time_us() - start, result);
+
+    return result;
+}
@@ -0,0 +1,26 @@
+/*
+ * Minimal driver for the HT16K33 LED controller on the Adafruit 8x8 matrix backpack.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+#define HT16K33_DEFAULT_ADDRESS     0x70
+#define HT16K33_ROWS                8
+#define HT16K33_MAX_BRIGHTNESS      15
+#define HT16K33_MAX_BLINK_RATE      3
+
+typedef struct
+{
+    zos_i2c_device_t device;
+    uint8_t brightness;
+    uint8_t blink_rate;
+} ht16k33_t;
+
+
+zos_result_t ht16k33_init(ht16k33_t *panel, zos_i2c_t port, uint8_t address);
+void ht16k33_deinit(ht16k33_t *panel);
+zos_result_t ht16k33_set_brightness(ht16k33_t *panel, uint8_t brightness);
+zos_result_t ht16k33_set_blink_rate(ht16k33_t *panel, uint8_t rate);
+zos_result_t ht16k33_write_rows(ht16k33_t *panel, uint8_t first_row, const uint8_t *rows, uint8_t count);
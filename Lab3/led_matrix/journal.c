@@ -0,0 +1,364 @@
+/*
+ * Debounced, wear-levelled journal of the display settings, replayed at boot.
+ *
+ * Each record holds the whole persisted state: brightness, blink rate, scroll rate and
+ * either the message text or the name of the file it is streamed from. Records go to a
+ * ring of JOURNAL_SLOTS files, one record per file, each new one replacing the oldest:
+ * files cannot be appended to once closed, and rotating through the slots spreads the
+ * erases over as many flash sectors instead of wearing out one.
+ *
+ * What is journalled is what the user set, not whatever the display shows: the journal
+ * keeps its own copy of the settings and message, updated from each of the user's
+ * changes, so a playlist entry or anything else shown for a while is never what comes
+ * back after a reboot.
+ *
+ * A change only arms a timer, and the state is written once when it fires, so a slider
+ * dragged for a few seconds costs one write rather than hundreds. A record identical to
+ * the last one written is skipped.
+ *
+ * At boot every slot's record is validated (magic and checksum) and the one with the
+ * highest sequence number is replayed: a fixed JOURNAL_SLOTS small reads, however many
+ * records were ever written. A record torn by a reset fails its checksum and the previous
+ * one is used instead, as is one whose string would not fit the display.
+ */
+
+#include "zos.h"
+#include "journal.h"
+#include "display.h"
+#include "ht16k33.h"
+#include "stats.h"
+
+
+#define JOURNAL_FILENAME            "journal_%u.bin"
+#define JOURNAL_MAGIC               0x314A4D4CUL    // 'LMJ1'
+#define JOURNAL_SOURCE_TEXT         0
+#define JOURNAL_SOURCE_FILE         1
+
+
+static journal_context_t context;
+static journal_record_t saved;              // the latest record, as written to or read from flash
+static zos_bool_t pending;
+
+static struct
+{
+    uint8_t brightness;
+    uint8_t blink_rate;
+    uint16_t scroll_rate;
+    uint8_t source;                         // JOURNAL_SOURCE_*
+    char string[DISPLAY_MAX_TEXT_LENGTH];   // the message text, or the file it is streamed from
+} user;                                     // the state the user set, what is journalled
+
+STATS_EVENT_HANDLER(write_event_handler)
+
+
+/*************************************************************************************************/
+/*
+ * Find the latest valid record and apply it to the display. Returns ZOS_NOT_FOUND when
+ * there is none, in which case the display keeps its defaults.
+ */
+zos_result_t journal_restore(void)
+{
+    journal_record_t record;
+    const uint8_t *payload = &saved.data[JOURNAL_HEADER_SIZE];
+    display_update_t update =
+    {
+        .flags = DISPLAY_UPDATE_BRIGHTNESS | DISPLAY_UPDATE_BLINK | DISPLAY_UPDATE_SCROLL,
+    };
+    memset(&context, 0, sizeof(context));
+    memset(&saved, 0, sizeof(saved));
+
+    for(uint8_t slot = 0; slot < JOURNAL_SLOTS; ++slot)
+    {
+        const uint32_t sequence = read_record(slot, &record);
+
+        if(sequence > context.sequence)
+        {
+            context.sequence = sequence;
+            context.slot = slot;
+            saved = record;
+        }
+    }
+
+    if(context.sequence == 0)
+    {
+        context.slot = JOURNAL_SLOTS - 1;
+        return ZOS_NOT_FOUND;
+    }
+
+    // read_record() has checked the string fits
+    user.brightness = update.brightness = payload[0];
+    user.blink_rate = update.blink_rate = payload[1];
+    user.scroll_rate = update.scroll_rate = payload[2] | (payload[3] << 8);
+    user.source = payload[4];
+    memcpy(user.string, &payload[5], saved.length - JOURNAL_HEADER_SIZE - 5);
+    user.string[saved.length - JOURNAL_HEADER_SIZE - 5] = 0;
+
+    if(user.source == JOURNAL_SOURCE_FILE)
+    {
+        update.flags |= DISPLAY_UPDATE_FILE;
+        update.file = user.string;
+    }
+    else
+    {
+        update.flags |= DISPLAY_UPDATE_TEXT;
+        update.text = user.string;
+    }
+
+    return display_update(&update);
+}
+
+/*************************************************************************************************/
+/*
+ * With nothing restored, take what the display shows at boot (the default or the message
+ * file) as the user's state, so that the first change journals it along with that change
+ */
+void journal_adopt_display(void)
+{
+    const display_context_t *display = display_get_context();
+
+    user.brightness = display->brightness;
+    user.blink_rate = display->blink_rate;
+    user.scroll_rate = display->scroll_rate;
+    user.source = (display->file[0] != 0) ? JOURNAL_SOURCE_FILE : JOURNAL_SOURCE_TEXT;
+    strcpy(user.string, (display->file[0] != 0) ? display->file : display->text);
+}
+
+/*************************************************************************************************/
+/*
+ * Note a change the user made, once the display has taken it. The settings it leaves are
+ * written JOURNAL_DEBOUNCE_TIME later.
+ */
+void journal_schedule(const display_update_t *update)
+{
+    if(update->flags & DISPLAY_UPDATE_FILE)
+    {
+        user.source = JOURNAL_SOURCE_FILE;
+        strncpy(user.string, update->file, DISPLAY_MAX_FILENAME - 1);
+        user.string[DISPLAY_MAX_FILENAME - 1] = 0;
+    }
+    else if(update->flags & DISPLAY_UPDATE_TEXT)
+    {
+        user.source = JOURNAL_SOURCE_TEXT;
+        strncpy(user.string, update->text, sizeof(user.string) - 1);
+        user.string[sizeof(user.string) - 1] = 0;
+    }
+    if(update->flags & DISPLAY_UPDATE_BRIGHTNESS)
+    {
+        user.brightness = MIN(update->brightness, HT16K33_MAX_BRIGHTNESS);
+    }
+    if(update->flags & DISPLAY_UPDATE_BLINK)
+    {
+        user.blink_rate = MIN(update->blink_rate, HT16K33_MAX_BLINK_RATE);
+    }
+    if(update->flags & DISPLAY_UPDATE_SCROLL)
+    {
+        user.scroll_rate = update->scroll_rate;
+    }
+
+    if(pending)
+    {
+        ++context.coalesced;
+    }
+    else if(zn_event_register_timed(write_event_handler_counted, NULL, JOURNAL_DEBOUNCE_TIME, 0) == ZOS_SUCCESS)
+    {
+        pending = ZOS_TRUE;
+    }
+}
+
+/*************************************************************************************************/
+/*
+ * Write a pending change now, e.g. before the app stops
+ */
+void journal_flush(void)
+{
+    if(pending)
+    {
+        zn_event_unregister(write_event_handler_counted, NULL);
+        write_event_handler(NULL);
+    }
+}
+
+/*************************************************************************************************/
+/*
+ * TRUE when the message the user set, or the one in the last record written, is streamed
+ * from the file 'name', which must then be left in place
+ */
+zos_bool_t journal_uses_file(const char *name)
+{
+    const uint8_t *payload = &saved.data[JOURNAL_HEADER_SIZE];
+    const uint16_t length = strlen(name);
+
+    return (user.source == JOURNAL_SOURCE_FILE && strcmp(user.string, name) == 0) ||
+           (saved.length == JOURNAL_HEADER_SIZE + 5 + length && payload[4] == JOURNAL_SOURCE_FILE &&
+            memcmp(&payload[5], name, length) == 0);
+}
+
+/*************************************************************************************************/
+const journal_context_t* journal_get_context(void)
+{
+    return &context;
+}
+
+/*************************************************************************************************/
+static void write_event_handler(void *arg)
+{
+    journal_record_t record;
+    zos_result_t result;
+    uint32_t handle;
+    const uint8_t slot = (context.slot + 1) % JOURNAL_SLOTS;
+    zos_file_t file =
+    {
+        .type = ZOS_FILE_TYPE_MISC,
+    };
+
+    pending = ZOS_FALSE;
+
+    encode_record(&record, context.sequence + 1);
+    if(record.length == saved.length &&
+       memcmp(&record.data[JOURNAL_HEADER_SIZE], &saved.data[JOURNAL_HEADER_SIZE], record.length - JOURNAL_HEADER_SIZE) == 0)
+    {
+        ++context.unchanged;
+        return;
+    }
+
+    file.size = record.length;
+    get_filename(slot, file.name);
+    zn_file_delete(file.name);
+
+    if(!ZOS_FAILED(result, zn_file_create(&file, &handle)))
+    {
+        result = zn_file_write(handle, record.data, record.length);
+        zn_file_close(handle);
+    }
+
+    if(result != ZOS_SUCCESS)
+    {
+        // The slot is empty now, the next write tries it again
+        ++context.errors;
+        zn_file_delete(file.name);
+        return;
+    }
+
+    ++context.sequence;
+    ++context.writes;
+    context.slot = slot;
+    saved = record;
+}
+
+/*************************************************************************************************/
+static void encode_record(journal_record_t *record, uint32_t sequence)
+{
+    const uint16_t string_length = strlen(user.string);
+    uint8_t *header = record->data;
+    uint8_t *payload = &record->data[JOURNAL_HEADER_SIZE];
+    const uint16_t payload_length = 5 + string_length;
+
+    payload[0] = user.brightness;
+    payload[1] = user.blink_rate;
+    payload[2] = user.scroll_rate & 0xFF;
+    payload[3] = user.scroll_rate >> 8;
+    payload[4] = user.source;
+    memcpy(&payload[5], user.string, string_length);
+
+    put_uint32(&header[0], JOURNAL_MAGIC);
+    put_uint32(&header[4], sequence);
+    header[8] = payload_length & 0xFF;
+    header[9] = payload_length >> 8;
+    header[10] = 0;
+    header[11] = 0;
+    put_checksum(header, checksum(record->data, JOURNAL_HEADER_SIZE + payload_length));
+
+    record->length = JOURNAL_HEADER_SIZE + payload_length;
+}
+
+/*************************************************************************************************/
+/*
+ * Returns the record's sequence number, 0 when the slot holds no valid record
+ */
+static uint32_t read_record(uint8_t slot, journal_record_t *record)
+{
+    char filename[DISPLAY_MAX_FILENAME];
+    uint32_t handle;
+    uint32_t bytes_read = 0;
+    uint16_t stored, payload_length;
+
+    get_filename(slot, filename);
+    if(zn_file_open(filename, &handle) != ZOS_SUCCESS)
+    {
+        return 0;
+    }
+    zn_file_read(handle, record->data, sizeof(record->data), &bytes_read);
+    zn_file_close(handle);
+
+    if(bytes_read < JOURNAL_HEADER_SIZE + 5 || get_uint32(&record->data[0]) != JOURNAL_MAGIC)
+    {
+        return 0;
+    }
+
+    // A string that would not fit the display, even with a valid checksum, is not replayed
+    payload_length = record->data[8] | (record->data[9] << 8);
+    if(payload_length < 5 || payload_length > JOURNAL_PAYLOAD_SIZE || JOURNAL_HEADER_SIZE + payload_length != bytes_read ||
+       (record->data[JOURNAL_HEADER_SIZE + 4] == JOURNAL_SOURCE_FILE && payload_length - 5 >= DISPLAY_MAX_FILENAME))
+    {
+        return 0;
+    }
+
+    // The checksum is computed with its own field zeroed
+    stored = record->data[10] | (record->data[11] << 8);
+    record->data[10] = 0;
+    record->data[11] = 0;
+    if(checksum(record->data, bytes_read) != stored)
+    {
+        return 0;
+    }
+    put_checksum(record->data, stored);
+    record->length = bytes_read;
+
+    return get_uint32(&record->data[4]);
+}
+
+/*************************************************************************************************/
+static void get_filename(uint8_t slot, char *filename)
+{
+    sprintf(filename, JOURNAL_FILENAME, (unsigned)slot);
+}
+
+/*************************************************************************************************/
+static uint16_t checksum(const uint8_t *data, uint16_t length)
+{
+    // CRC-16/CCITT, bitwise: a record is written every few seconds at most
+    uint16_t crc = 0xFFFF;
+
+    while(length-- > 0)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+        for(uint8_t bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/*************************************************************************************************/
+static void put_checksum(uint8_t *header, uint16_t crc)
+{
+    header[10] = crc & 0xFF;
+    header[11] = crc >> 8;
+}
+
+/*************************************************************************************************/
+static void put_uint32(uint8_t *data, uint32_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+/*************************************************************************************************/
+static uint32_t get_uint32(const uint8_t *data)
+{
+    return data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
@@ -0,0 +1,38 @@
+/*
+ * Debounced, wear-levelled journal of the display settings, replayed at boot.
+ */
+#pragma once
+
+#include "zos.h"
+#include "display.h"
+
+
+#define JOURNAL_SLOTS               8       // record files in the ring, each write replaces the oldest
+#define JOURNAL_DEBOUNCE_TIME       5000    // ms from the first unsaved change to the write
+#define JOURNAL_HEADER_SIZE         12      // magic, sequence, payload length, checksum
+#define JOURNAL_PAYLOAD_SIZE        (5 + DISPLAY_MAX_TEXT_LENGTH - 1)   // brightness, blink, scroll, source, unterminated string
+
+// One record as stored in its file, little endian
+typedef struct
+{
+    uint16_t length;                        // header and payload
+    uint8_t data[JOURNAL_HEADER_SIZE + JOURNAL_PAYLOAD_SIZE];
+} journal_record_t;
+
+typedef struct
+{
+    uint32_t sequence;                      // of the latest record, 0 when there is none
+    uint8_t slot;                           // holding the latest record
+    uint32_t writes;                        // records written since boot
+    uint32_t coalesced;                     // changes folded into a write already pending
+    uint32_t unchanged;                     // writes skipped as the state was already saved
+    uint32_t errors;
+} journal_context_t;
+
+
+zos_result_t journal_restore(void);
+void journal_adopt_display(void);
+void journal_schedule(const display_update_t *update);
+void journal_flush(void);
+zos_bool_t journal_uses_file(const char *name);
+const journal_context_t* journal_get_context(void);
@@ -17,32 +17,135 @@
  *  - Listing scan results to the serial console
  *  - Reading from a text file on the local file system and displaying on the LED matrix
  *  In addition, the module's IP address is printed in a related console message, so that this compatible with all OSes
+ *  Text rendering, scrolling and the panel's I2C traffic are handled by the app itself (display.c, ht16k33.c)
+ *  The message and display settings survive a reboot (journal.c)
+ *  Messages can be queued in a prioritised playlist (playlist.c)
+ *  Raw frames can be streamed to the panel over UDP (stream.c)
+ *  Boot shows the last message straight away and brings the network up in the background (boot.c)
+ *  The display can be controlled over MQTT, one broker fanning commands out to many panels (remote.c)
+ *
+ *  The HTTP server calls the page processors on its own thread, one request at a time. Everything else the app registers
+ *  (timers, issued events, the button, UDP and MQTT receives) runs on the app's event thread, which
+ *  owns the display and the modules around it. A page that changes the display hands the change to
+ *  the event thread and waits for it to be made (call_on_event_thread()), for EVENT_CALL_TIMEOUT at
+ *  most before it answers 503; a page that reads it takes a consistent copy (display_copy_context()).
  */
 
 #include "zos.h"
-#include "led_matrix8x8.h"
+#include "display.h"
+#include "ht16k33.h"
+#include "writer.h"
+#include "scanner.h"
+#include "static_resource.h"
+#include "stats.h"
+#include "animation.h"
+#include "journal.h"
+#include "playlist.h"
+#include "stream.h"
+#include "boot.h"
+#include "remote.h"
+
 
+// Every page, and the button, goes through stats.c so it is counted and timed
+STATS_HTTP_PAGE(index_page_processor)
+STATS_HTTP_PAGE(update_processor)
+STATS_HTTP_PAGE(update_text_processor)
+STATS_HTTP_PAGE(update_blink_processor)
+STATS_HTTP_PAGE(update_brightness_processor)
+STATS_HTTP_PAGE(update_scroll_processor)
+STATS_HTTP_PAGE(update_animation_processor)
+STATS_HTTP_PAGE(update_playlist_processor)
+STATS_HTTP_PAGE(retrieve_all_processor)
+STATS_HTTP_PAGE(retrieve_changes_processor)
+STATS_HTTP_PAGE(retrieve_scan_processor)
+STATS_EVENT_HANDLER(button_pressed_event_handler)
+STATS_EVENT_HANDLER(network_event_handler)
 
 HTTP_SERVER_DYNAMIC_PAGES_START
-	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/text",          update_text_processor),
-	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/blink",         update_blink_processor),
-	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/brightness",    update_brightness_processor),
-	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/scroll",        update_scroll_processor),
-	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/retrieve/all",         retrieve_all_processor),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/index.html",           index_page_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update",               update_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/text",          update_text_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/blink",         update_blink_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/brightness",    update_brightness_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/scroll",        update_scroll_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/animation",     update_animation_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/update/playlist",      update_playlist_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/retrieve/all",         retrieve_all_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/retrieve/changes",     retrieve_changes_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/retrieve/scan",        retrieve_scan_processor_counted),
+	HTTP_SERVER_DYNAMIC_PAGE("/led_matrix/retrieve/stats",       retrieve_stats_processor),
 HTTP_SERVER_DYNAMIC_PAGES_END
 
+ZOS_COMMANDS_START
+	ZOS_COMMAND("stats", stats_command, 0, 1),
+	ZOS_COMMAND("boot", boot_command, 0, 0),
+	ZOS_COMMAND("remote", remote_command, 0, 2),
+ZOS_COMMANDS_END
+
 #define BUTTON_DEBOUNCE_TIME  50 // ms
 #define BUTTON_CLICK_TIME   1000 // ms
 #define BUTTON_PRESS_TIME    100 // ms
 
+#define NETWORK_JOIN_TIMEOUT        10000   // ms to wait for the join before showing how to set up the network
+#define EVENT_CALL_TIMEOUT          1000    // ms a page waits for the event thread before it answers 503
+
+// MQTT remote control (remote.c). Empty leaves it off until a broker is given with the
+// 'remote <host> [port]' command.
+#define MQTT_BROKER_HOST            ""
+#define MQTT_BROKER_PORT            1883
+#define MQTT_CLIENT_ID              "led_matrix_%c%c%c%c"   // from the end of the MAC address
+
+// POSTed messages go to one of these, never to one still in use (see free_message_file())
+#define HTTP_MESSAGE_FILENAME       "http_message_%c.txt"   // 'a' onwards
+#define HTTP_MESSAGE_FILES          4
+#define HTTP_MESSAGE_MAX_SIZE       4096    // bytes, longer bodies get a 413
+
+#define SCAN_PAGE_DEFAULT_LIMIT     16
+
+static static_resource_t index_page = { "led_matrix/index.html.gz", "text/html" };
+
+// The row of LED matrix panels, left to right. Add an entry per chained panel, each
+// backpack strapped to its own address (0x70 to 0x77 on one bus)
+static const display_panel_config_t panels[] =
+{
+    { PLATFORM_STD_I2C, HT16K33_DEFAULT_ADDRESS },
+};
+
 static zos_bool_t initialized;
+static uint32_t boot_nonce;             // tells state versions of this boot from those of earlier ones
+
+// The HTTP server's hand-over to the event thread, one call at a time (call_on_event_thread())
+#define EVENT_CALL_IDLE             0
+#define EVENT_CALL_ISSUED           1       // waiting for the event thread, or given up on if the page timed out
+#define EVENT_CALL_RUNNING          2
+
+static struct
+{
+    zos_result_t (*func)(void *arg);
+    void *arg;
+    zos_result_t result;
+    uint32_t state;                         // EVENT_CALL_*, moved on by whichever thread claims it first
+    zos_semaphore_t done;
+} event_call;
+
+// What the scan page asks of the event thread, and the copy of the scan cache it gets back
+// (copy_scan()). Static rather than on the HTTP server's stack, pages run one at a time.
+static struct
+{
+    zos_bool_t refresh;
+    scanner_context_t copy;
+} scan_page;
 
 
 /*************************************************************************************************/
+/*
+ * Boot runs in phases (see boot.c), ordered so the panel shows the message as soon as it is
+ * up: the network join is started once the settings are loaded and completes after init has
+ * returned, with the display already scrolling.
+ */
 void zn_app_init(void)
 {
     zos_result_t result;
-    char buffer[32];
 
     const button_config_t config =
     {
@@ -50,50 +153,71 @@ void zn_app_init(void)
         .debounce = BUTTON_DEBOUNCE_TIME,
         .click_time = BUTTON_CLICK_TIME,
         .press_time = BUTTON_PRESS_TIME,
-        .event_handler.press = button_pressed_event_handler,
+        .event_handler.press = button_pressed_event_handler_counted,
     };
 
     PLATFORM_ENABLE_JTAG_GPIOS();
+    stats_init();
+    zn_rtos_semaphore_init(&event_call.done);
+    zn_get_random_buffer(&boot_nonce, sizeof(boot_nonce));
     button_init(PLATFORM_BUTTON1, &config, (void*)1);
 
     ZOS_LOG("Starting Lab1: 8x8 LED Matrix Demo");
 
-    if(zn_load_app_settings("settings.ini") != ZOS_SUCCESS)
+    boot_begin(BOOT_PHASE_DISPLAY);
+    result = display_init(panels, sizeof(panels)/sizeof(panels[0]));
+    boot_end(BOOT_PHASE_DISPLAY, result);
+    if(result != ZOS_SUCCESS)
     {
-        ZOS_LOG("Failed to load settings");
+        ZOS_LOG("Failed to initialize LED Matrix display");
         return;
     }
 
-    if(ZOS_FAILED(result, led_matrix8x8_init(PLATFORM_STD_I2C)))
+    // What was on the display before the reboot if anything was saved, else the message
+    // file, else the default. All of it is local flash, and it is committed straight away
+    // rather than at the first frame tick.
+    boot_begin(BOOT_PHASE_FIRST_FRAME);
+    display_set_text("Default message ... ");
+    display_set_scroll_rate(35);
+    if(journal_restore() != ZOS_SUCCESS)
     {
-        ZOS_LOG("Failed to initialize LED Matrix Library");
-        return;
+        load_file_message();
+        journal_adopt_display();
     }
+    result = display_commit();
+    boot_end(BOOT_PHASE_FIRST_FRAME, result);
 
-    led_matrix8x8_set_text("Default message ... ");
-    led_matrix8x8_set_scroll_rate(35);
-
-    HTTP_SERVER_REGISTER_DYNAMIC_PAGES();
+    boot_begin(BOOT_PHASE_SERVICES);
+    result = zn_load_app_settings("settings.ini");
+    if(result == ZOS_SUCCESS)
+    {
+        HTTP_SERVER_REGISTER_DYNAMIC_PAGES();
+        ZOS_REGISTER_COMMANDS();
+    }
+    boot_end(BOOT_PHASE_SERVICES, result);
+    if(result != ZOS_SUCCESS)
+    {
+        ZOS_LOG("Failed to load settings");
+        return;
+    }
 
-    if(ZOS_FAILED(result,zn_network_restart(ZOS_WLAN)))
+    // The join starts now the settings are in, without blocking: the link coming up (or going
+    // down later) arrives as a network event, so nothing polls for it
+    boot_begin(BOOT_PHASE_NETWORK);
+    zn_network_register_event_handler(ZOS_WLAN, network_event_handler_counted);
+    if(zn_network_is_up(ZOS_WLAN))
     {
-        ZOS_LOG("Failed to restart network: %d\r\n\r\n", result);
-        ZOS_LOG("----------------------------------------------------------------------\r\n");
-        ZOS_LOG("This basic app expects valid network credentials have been configured.");
-        ZOS_LOG("Join a network and save credentials to non-volatile memory using the  ");
-        ZOS_LOG("ZentriOS commands shown below                                         ");
-        ZOS_LOG("                                                                      ");
-        ZOS_LOG("> network_up -s                                                       ");
-        ZOS_LOG("----------------------------------------------------------------------");
-        ZOS_LOG("\r\n                                                                  ");
+        network_ready(ZOS_SUCCESS);
+    }
+    else if(ZOS_FAILED(result, zn_network_up(ZOS_WLAN, ZOS_FALSE)))
+    {
+        network_ready(result);
     }
     else
     {
-        ZOS_LOG("From your browser, enter the URL: http://%s/ to control the display",  ZOS_GET_SETTING_STR("wlan.network.ip", buffer));
+        zn_event_register_timed(network_timeout_event_handler, NULL, NETWORK_JOIN_TIMEOUT, 0);
     }
 
-    load_file_message();
-
     initialized = ZOS_TRUE;
 }
 
@@ -101,7 +225,17 @@ void zn_app_init(void)
 /*************************************************************************************************/
 void zn_app_deinit(void)
 {
-    led_matrix8x8_deinit();
+    zn_network_register_event_handler(ZOS_WLAN, NULL);
+    zn_event_unregister(network_timeout_event_handler, NULL);
+    remote_stop();
+    scanner_stop();
+    stream_stop();
+    animation_stop();
+    playlist_stop();
+    journal_flush();
+    display_deinit();
+    zn_rtos_semaphore_deinit(&event_call.done);
+    stats_deinit();
     button_deinit(PLATFORM_BUTTON1);
 }
 
@@ -110,53 +244,360 @@ void zn_app_deinit(void)
 zos_bool_t zn_app_idle(void)
 {
     // Return TRUE so the event loop idles
-    // It will wakeup when the LED matrix needs to be updated or the HTTP server receives a request
+    // Nothing in the app polls: it wakes up for the display's next commit or scroll step (none
+    // while the message stands still), an HTTP request, a streamed frame or the button
     return initialized;
 }
 
+/*************************************************************************************************/
+static void network_event_handler(void *arg)
+{
+    if(arg != NULL)
+    {
+        zn_event_unregister(network_timeout_event_handler, NULL);
+        network_ready(ZOS_SUCCESS);
+    }
+    else
+    {
+        // The remote control reconnects by itself, the stream port is opened again on the way up
+        ZOS_LOG("Network down");
+        stream_stop();
+    }
+}
+
+/*************************************************************************************************/
+static void network_timeout_event_handler(void *arg)
+{
+    // Tell the user how to set up the network, a join that completes later still starts the services
+    network_ready(ZOS_TIMEOUT);
+}
+
+/*************************************************************************************************/
+static void network_ready(zos_result_t result)
+{
+    char buffer[32];
+    const zos_bool_t booting = (boot_get_context()->phases[BOOT_PHASE_NETWORK].state == BOOT_STATE_RUNNING);
+
+    boot_end(BOOT_PHASE_NETWORK, result);
+
+    if(result != ZOS_SUCCESS)
+    {
+        ZOS_LOG("Failed to join the network: %d\r\n\r\n", result);
+        ZOS_LOG("----------------------------------------------------------------------\r\n");
+        ZOS_LOG("This basic app expects valid network credentials have been configured.");
+        ZOS_LOG("Join a network and save credentials to non-volatile memory using the  ");
+        ZOS_LOG("ZentriOS commands shown below                                         ");
+        ZOS_LOG("                                                                      ");
+        ZOS_LOG("> network_up -s                                                       ");
+        ZOS_LOG("----------------------------------------------------------------------");
+        ZOS_LOG("\r\n                                                                  ");
+    }
+    else
+    {
+        ZOS_LOG("From your browser, enter the URL: http://%s/ to control the display",  ZOS_GET_SETTING_STR("wlan.network.ip", buffer));
+
+        if(ZOS_FAILED(result, stream_start(STREAM_UDP_PORT)))
+        {
+            ZOS_LOG("Failed to open the frame stream port: %d", result);
+        }
+        else
+        {
+            ZOS_LOG("Frames can be streamed to UDP port %u", STREAM_UDP_PORT);
+        }
+
+        if(MQTT_BROKER_HOST[0] != 0 && !remote_get_context()->running)
+        {
+            start_remote(MQTT_BROKER_HOST, MQTT_BROKER_PORT);
+        }
+    }
+
+    if(booting)
+    {
+        boot_print();
+    }
+}
+
 /*************************************************************************************************/
 static void load_file_message(void)
 {
-	uint32_t handle;
 	zos_result_t result;
 
-	if(!ZOS_FAILED(result, zn_file_open("message.txt", &handle)))
+	// The display streams the file as it scrolls, so message.txt can be any length
+	if(!ZOS_FAILED(result, display_set_file("message.txt")))
 	{
-		char buffer[64];
-		uint32_t bytes_read;
-
-		if(!ZOS_FAILED(result, zn_file_read(handle, buffer, sizeof(buffer)-1, &bytes_read)))
-		{
-			buffer[bytes_read] = 0;
-			led_matrix8x8_set_text(buffer);
-			ZOS_LOG("LED matrix updated with message.txt");
-		}
-		else
-		{
-			ZOS_LOG("Failed to read message.txt");
-		}
+		ZOS_LOG("LED matrix updated with message.txt");
 	}
-	else
+	else if(result == ZOS_NOT_FOUND)
 	{
 		ZOS_LOG("message.txt not found");
 	}
+	else
+	{
+		ZOS_LOG("Failed to read message.txt");
+	}
 }
 
 /*************************************************************************************************/
+static zos_result_t index_page_processor(const http_server_request_t *request, const char *arg)
+{
+    return static_resource_write(request, &index_page);
+}
+
+/*************************************************************************************************/
+/*
+ * Apply any mix of text, blink, brightness and scroll in one request and reply with the
+ * resulting state, e.g. /led_matrix/update?brightness=8&scroll=100
+ */
+static zos_result_t update_processor(const http_server_request_t *request, const char *arg)
+{
+    const http_server_param_t *param;
+    display_update_t update = { .flags = 0 };
+    display_context_t state;
+
+    if((param = zn_hs_get_param(request, "text")) != NULL)
+    {
+        update.flags |= DISPLAY_UPDATE_TEXT;
+        update.text = param->value;
+    }
+    if((param = zn_hs_get_param(request, "blink")) != NULL)
+    {
+        update.flags |= DISPLAY_UPDATE_BLINK;
+        update.blink_rate = str_to_uint32(param->value);
+    }
+    if((param = zn_hs_get_param(request, "brightness")) != NULL)
+    {
+        update.flags |= DISPLAY_UPDATE_BRIGHTNESS;
+        update.brightness = str_to_uint32(param->value);
+    }
+    if((param = zn_hs_get_param(request, "scroll")) != NULL)
+    {
+        update.flags |= DISPLAY_UPDATE_SCROLL;
+        update.scroll_rate = str_to_uint32(param->value);
+    }
+
+    if(call_on_event_thread(apply_update_call, &update) != ZOS_SUCCESS)
+    {
+        return zn_hs_write_reply_status(request, 503);
+    }
+    display_copy_context(&state);
+
+    return write_state_reply(request, &state, 0);
+}
+
+/*************************************************************************************************/
+/*
+ * Run func(arg) on the event thread and wait for its result. Only the HTTP server calls
+ * this, one request at a time, so a single hand-over slot is enough. The request's
+ * parameters stay valid while it waits, so they are passed as they are.
+ *
+ * The wait is bounded: a busy event thread (e.g. dwelling on a scan channel) costs the
+ * page a ZOS_TIMEOUT, for a 503, rather than stalling the HTTP server. The call is then
+ * taken back, unless the event thread has already claimed it, in which case it is waited
+ * out: its arguments live on this thread's stack.
+ */
+static zos_result_t call_on_event_thread(zos_result_t (*func)(void *arg), void *arg)
+{
+    zos_result_t result;
+    uint32_t issued = EVENT_CALL_ISSUED;
+
+    event_call.func = func;
+    event_call.arg = arg;
+    __atomic_store_n(&event_call.state, EVENT_CALL_ISSUED, __ATOMIC_RELEASE);
+
+    if(ZOS_FAILED(result, zn_event_issue(event_call_handler, NULL, 0)))
+    {
+        __atomic_store_n(&event_call.state, EVENT_CALL_IDLE, __ATOMIC_RELAXED);
+        return result;
+    }
+    else if(zn_rtos_semaphore_get(&event_call.done, EVENT_CALL_TIMEOUT) != ZOS_SUCCESS)
+    {
+        if(__atomic_compare_exchange_n(&event_call.state, &issued, EVENT_CALL_IDLE, ZOS_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            return ZOS_TIMEOUT;
+        }
+        zn_rtos_semaphore_get(&event_call.done, ZOS_WAIT_FOREVER);
+    }
+
+    return event_call.result;
+}
+
+/*************************************************************************************************/
+static void event_call_handler(void *arg)
+{
+    // A call taken back is skipped; a later call may already reuse the slot, and is run here
+    // if this event comes first, its own event then finds nothing to do
+    uint32_t issued = EVENT_CALL_ISSUED;
+
+    if(!__atomic_compare_exchange_n(&event_call.state, &issued, EVENT_CALL_RUNNING, ZOS_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    event_call.result = event_call.func(event_call.arg);
+    __atomic_store_n(&event_call.state, EVENT_CALL_IDLE, __ATOMIC_RELEASE);
+    zn_rtos_semaphore_set(&event_call.done);
+}
+
+/*************************************************************************************************/
+static zos_result_t apply_update_call(void *update)
+{
+    apply_update(update);
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*
+ * Every batched update goes through here on the event thread, from an HTTP page or a
+ * remote command alike
+ */
+static void apply_update(const display_update_t *update)
+{
+    display_update_t journalled = *update;
+
+    // A message file the display could not read is not journalled, the rest of the update is
+    if(display_update(update) != ZOS_SUCCESS && (update->flags & DISPLAY_UPDATE_FILE))
+    {
+        journalled.flags &= ~(DISPLAY_UPDATE_FILE | DISPLAY_UPDATE_TEXT);
+    }
+    journal_schedule(&journalled);
+}
+
+
+/*************************************************************************************************/
+/*
+ * Short messages come in the 'data' parameter. Longer ones are POSTed as the request body,
+ * saved to flash and streamed by the display from there, the same way as message.txt.
+ */
 static zos_result_t update_text_processor(const http_server_request_t *request, const char *arg)
 {
     const http_server_param_t *param = zn_hs_get_param(request, "data");
-    led_matrix8x8_set_text(param->value);
+    display_update_t update = { .flags = 0 };
+    char filename[DISPLAY_MAX_FILENAME];
+
+    if(param != NULL)
+    {
+        update.flags = DISPLAY_UPDATE_TEXT;
+        update.text = param->value;
+    }
+    else
+    {
+        // Saved to a file nothing uses, so the message being shown keeps streaming while its
+        // replacement is uploaded, and a failed upload leaves every other message intact
+        zos_result_t result;
+
+        if(call_on_event_thread(free_message_file, filename) != ZOS_SUCCESS)
+        {
+            return zn_hs_write_reply_status(request, 503);
+        }
+        else if(ZOS_FAILED(result, save_request_body(request, filename)))
+        {
+            return zn_hs_write_reply_status(request, (result == ZOS_BUFFER_OVERFLOW) ? 413 : (result == ZOS_BADARG) ? 400 : 500);
+        }
+        update.flags = DISPLAY_UPDATE_FILE;
+        update.file = filename;
+    }
+    if(call_on_event_thread(apply_update_call, &update) != ZOS_SUCCESS)
+    {
+        return zn_hs_write_reply_status(request, 503);
+    }
+
     return zn_hs_write_reply_header(request, NULL, 0, HTTP_SERVER_HEADER_NONE);
 }
 
+/*************************************************************************************************/
+/*
+ * The name of a message file that can be overwritten: not the one on the display, nor the
+ * one the user set or the journal last saved, which may differ for the debounce time. That
+ * is at most three files in use, so one of HTTP_MESSAGE_FILES is always free. Runs on the
+ * event thread, where those are kept; only the HTTP server names new ones, after this.
+ */
+static zos_result_t free_message_file(void *arg)
+{
+    char *filename = arg;
+
+    for(char slot = 'a'; slot < 'a' + HTTP_MESSAGE_FILES; ++slot)
+    {
+        sprintf(filename, HTTP_MESSAGE_FILENAME, slot);
+        if(strcmp(display_get_context()->file, filename) != 0 && !journal_uses_file(filename))
+        {
+            break;
+        }
+    }
+
+    return ZOS_SUCCESS;
+}
+
+
+/*************************************************************************************************/
+static zos_result_t save_request_body(const http_server_request_t *request, const char *filename)
+{
+    zos_result_t result;
+    uint32_t handle;
+    const char *content_length = zn_hs_get_header(request, "Content-Length");
+    uint32_t remaining = (content_length != NULL) ? str_to_uint32(content_length) : 0;
+    zos_file_t file =
+    {
+        .size = remaining,
+        .type = ZOS_FILE_TYPE_MISC,
+    };
+
+    // The length sizes the file, so it is checked before anything is erased
+    if(remaining == 0 || (content_length != NULL && strspn(content_length, "0123456789") != strlen(content_length)))
+    {
+        return ZOS_BADARG;
+    }
+    else if(remaining > HTTP_MESSAGE_MAX_SIZE || strlen(content_length) > 10)
+    {
+        return ZOS_BUFFER_OVERFLOW;
+    }
+
+    strncpy(file.name, filename, sizeof(file.name) - 1);
+    zn_file_delete(filename);
+
+    if(ZOS_FAILED(result, zn_file_create(&file, &handle)))
+    {
+        return result;
+    }
+
+    while(remaining > 0)
+    {
+        char buffer[128];
+        uint32_t bytes_read;
+
+        if(ZOS_FAILED(result, zn_hs_read_post_data(request, buffer, MIN(remaining, sizeof(buffer)), &bytes_read)))
+        {
+            break;
+        }
+        else if(bytes_read == 0)
+        {
+            result = ZOS_ERROR;
+            break;
+        }
+        else if(ZOS_FAILED(result, zn_file_write(handle, buffer, bytes_read)))
+        {
+            break;
+        }
+        remaining -= bytes_read;
+    }
+
+    zn_file_close(handle);
+    if(result != ZOS_SUCCESS)
+    {
+        zn_file_delete(filename);
+    }
+
+    return result;
+}
+
 
 /*************************************************************************************************/
 static zos_result_t update_blink_processor(const http_server_request_t *request, const char *arg)
 {
     const http_server_param_t *param = zn_hs_get_param(request, "data");
-    const uint8_t val = str_to_uint32(param->value);
-    led_matrix8x8_set_blink_rate(val);
+    const display_update_t update = { .flags = DISPLAY_UPDATE_BLINK, .blink_rate = str_to_uint32(param->value) };
+    if(call_on_event_thread(apply_update_call, (void*)&update) != ZOS_SUCCESS)
+    {
+        return zn_hs_write_reply_status(request, 503);
+    }
     return zn_hs_write_reply_header(request, NULL, 0, HTTP_SERVER_HEADER_NONE);
 }
 
@@ -165,8 +606,11 @@ static zos_result_t update_blink_processor(const http_server_request_t *request,
 static zos_result_t update_brightness_processor(const http_server_request_t *request, const char *arg)
 {
     const http_server_param_t *param = zn_hs_get_param(request, "data");
-    const uint8_t val = str_to_uint32(param->value);
-    led_matrix8x8_set_brightness(val);
+    const display_update_t update = { .flags = DISPLAY_UPDATE_BRIGHTNESS, .brightness = str_to_uint32(param->value) };
+    if(call_on_event_thread(apply_update_call, (void*)&update) != ZOS_SUCCESS)
+    {
+        return zn_hs_write_reply_status(request, 503);
+    }
     return zn_hs_write_reply_header(request, NULL, 0, HTTP_SERVER_HEADER_NONE);
 }
 
@@ -175,108 +619,722 @@ static zos_result_t update_brightness_processor(const http_server_request_t *req
 static zos_result_t update_scroll_processor(const http_server_request_t *request, const char *arg)
 {
     const http_server_param_t *param = zn_hs_get_param(request, "data");
-    const uint16_t val = str_to_uint32(param->value);
-    led_matrix8x8_set_scroll_rate(val);
+    const display_update_t update = { .flags = DISPLAY_UPDATE_SCROLL, .scroll_rate = str_to_uint32(param->value) };
+    if(call_on_event_thread(apply_update_call, (void*)&update) != ZOS_SUCCESS)
+    {
+        return zn_hs_write_reply_status(request, 503);
+    }
+    return zn_hs_write_reply_header(request, NULL, 0, HTTP_SERVER_HEADER_NONE);
+}
+
+
+/*************************************************************************************************/
+/*
+ * Play a pre-compiled animation (resources/animations/) until new text is sent, e.g.
+ * /led_matrix/update/animation?data=heart.anim. Without 'data' the message is shown again.
+ */
+static zos_result_t update_animation_processor(const http_server_request_t *request, const char *arg)
+{
+    const http_server_param_t *param = zn_hs_get_param(request, "data");
+    zos_result_t result;
+
+    if(ZOS_FAILED(result, call_on_event_thread(play_animation, (void*)((param != NULL) ? param->value : ""))))
+    {
+        return zn_hs_write_reply_status(request, (result == ZOS_TIMEOUT) ? 503 : 404);
+    }
+
+    return zn_hs_write_reply_header(request, NULL, 0, HTTP_SERVER_HEADER_NONE);
+}
+
+/*************************************************************************************************/
+/*
+ * On the event thread: play the named animation, or with an empty name stop the one playing
+ */
+static zos_result_t play_animation(void *arg)
+{
+    const char *file = arg;
+
+    if(file[0] != 0)
+    {
+        return animation_play(file);
+    }
+    else if(animation_get_context()->file[0] != 0)
+    {
+        animation_cancel();
+    }
+
+    return ZOS_SUCCESS;
+}
+
+
+/*************************************************************************************************/
+/*
+ * Queue the POSTed message in the playlist, e.g. POST /led_matrix/update/playlist?priority=2&repeat=3&dwell=5000.
+ * Priority and repeat go from 0 to 255; a value out of range, empty or not a number gets a 400.
+ * Without a body, ?clear=1 empties the playlist and brings back the message it interrupted.
+ */
+static zos_result_t update_playlist_processor(const http_server_request_t *request, const char *arg)
+{
+    const char *content_length = zn_hs_get_header(request, "Content-Length");
+    uint32_t remaining = (content_length != NULL) ? str_to_uint32(content_length) : 0;
+    uint32_t priority, repeat, dwell;
+    playlist_message_t *message;
+    char *text;
+
+    if(remaining == 0)
+    {
+        if(zn_hs_get_param(request, "clear") != NULL)
+        {
+            playlist_clear();
+        }
+        return zn_hs_write_reply_header(request, NULL, 0, HTTP_SERVER_HEADER_NONE);
+    }
+    else if(remaining >= sizeof(message->text))
+    {
+        return zn_hs_write_reply_status(request, 413);
+    }
+    else if(!get_uint_param(request, "priority", UINT8_MAX, 0, &priority) ||
+            !get_uint_param(request, "repeat", UINT8_MAX, 1, &repeat) ||
+            !get_uint_param(request, "dwell", UINT32_MAX, PLAYLIST_DEFAULT_DWELL, &dwell))
+    {
+        return zn_hs_write_reply_status(request, 400);
+    }
+    else if((message = playlist_reserve()) == NULL)
+    {
+        return zn_hs_write_reply_status(request, 503);
+    }
+
+    // The body is read straight into the queue slot, nothing is published until it is complete
+    text = message->text;
+    while(remaining > 0)
+    {
+        uint32_t bytes_read;
+
+        if(zn_hs_read_post_data(request, text, remaining, &bytes_read) != ZOS_SUCCESS || bytes_read == 0)
+        {
+            return zn_hs_write_reply_status(request, 400);
+        }
+        text += bytes_read;
+        remaining -= bytes_read;
+    }
+    *text = 0;
+
+    message->priority = priority;
+    message->repeat = repeat;
+    message->dwell = dwell;
+
+    playlist_submit();
+
     return zn_hs_write_reply_header(request, NULL, 0, HTTP_SERVER_HEADER_NONE);
 }
 
 
 /*************************************************************************************************/
+/*
+ * A numeric page parameter: 'fallback' when it is not given, ZOS_FALSE when it is given
+ * but empty, not a decimal number or over 'max'
+ */
+static zos_bool_t get_uint_param(const http_server_request_t *request, const char *name, uint32_t max, uint32_t fallback, uint32_t *value)
+{
+    const http_server_param_t *param = zn_hs_get_param(request, name);
+    uint64_t number = 0;
+
+    if(param == NULL)
+    {
+        *value = fallback;
+        return ZOS_TRUE;
+    }
+    else if(param->value[0] == 0)
+    {
+        return ZOS_FALSE;
+    }
+
+    for(const char *c = param->value; *c != 0; ++c)
+    {
+        if(*c < '0' || *c > '9' || (number = number * 10 + (*c - '0')) > max)
+        {
+            return ZOS_FALSE;
+        }
+    }
+    *value = (uint32_t)number;
+
+    return ZOS_TRUE;
+}
+
+
+/*************************************************************************************************/
+/*
+ * Full display state. Supports conditional GET: the ETag is derived from the state itself
+ * and the boot nonce, so a client revalidating with If-None-Match gets an empty 304 until
+ * something changes or the module reboots.
+ */
 static zos_result_t retrieve_all_processor(const http_server_request_t *request, const char *arg)
+{
+    const char *if_none_match = zn_hs_get_header(request, "If-None-Match");
+    display_context_t context;
+    const char *etag;
+
+    display_copy_context(&context);
+    etag = state_etag(&context);
+    if(if_none_match != NULL && strcmp(if_none_match, etag) == 0)
+    {
+        return write_not_modified_reply(request, etag);
+    }
+
+    return write_state_reply(request, &context, 0);
+}
+
+
+/*************************************************************************************************/
+/*
+ * Only the fields that changed after the given version, e.g. /led_matrix/retrieve/changes?since=5F3A09C2-12
+ * The version token, as in every state reply, is the boot nonce and the state version. The
+ * version restarts at every boot, so a token from an earlier boot (another nonce), or one
+ * that is not a version of this boot at all, gets the full state. Replies 304 when nothing
+ * changed.
+ *
+ * Holding requests open for long-polling or server-sent events would stall every other
+ * client of the HTTP server (see the top of this file); instead, idle polls cost one empty
+ * 304 and changes cost one reply carrying just the changed fields.
+ */
+static zos_result_t retrieve_changes_processor(const http_server_request_t *request, const char *arg)
+{
+    const http_server_param_t *param = zn_hs_get_param(request, "since");
+    display_context_t context;
+    uint32_t since;
+
+    display_copy_context(&context);
+    if(param == NULL || !parse_state_version(param->value, &since) || since > context.version)
+    {
+        since = 0;
+    }
+    else if(since == context.version)
+    {
+        return write_not_modified_reply(request, state_etag(&context));
+    }
+
+    return write_state_reply(request, &context, since);
+}
+
+/*************************************************************************************************/
+/*
+ * The state version in a "<boot nonce>-<version>" token, if the token was issued since this boot
+ */
+static zos_bool_t parse_state_version(const char *token, uint32_t *version)
+{
+    char *end;
+
+    if(strtoul(token, &end, 16) != boot_nonce || end == token || *end != '-' || end[1] < '0' || end[1] > '9')
+    {
+        return ZOS_FALSE;
+    }
+    *version = strtoul(&end[1], NULL, 10);
+
+    return ZOS_TRUE;
+}
+
+
+/*************************************************************************************************/
+/*
+ * Cached Wi-Fi scan results, a page at a time: /led_matrix/retrieve/scan?offset=0&limit=16
+ * Add refresh=1 to start a background sweep; the reply still carries the current cache and
+ * "scanning" tells the client to poll again for the refreshed list.
+ */
+static zos_result_t retrieve_scan_processor(const http_server_request_t *request, const char *arg)
 {
     zos_result_t result;
-    char buffer[128];
-    char *ptr = buffer;
-    const led_matrix8x8_context_t *context = led_matrix8x8_get_context();
+    writer_t writer;
+    const scanner_context_t *scan = &scan_page.copy;
+    const http_server_param_t *param;
+    const uint32_t now = zn_rtos_get_time();
+    uint32_t offset = 0;
+    uint32_t limit = SCAN_PAGE_DEFAULT_LIMIT;
+
+    // The sweep merges into the cache on the event thread, so the page reads a copy taken there
+    param = zn_hs_get_param(request, "refresh");
+    scan_page.refresh = (param != NULL && str_to_uint32(param->value) != 0);
+    if(call_on_event_thread(copy_scan, NULL) != ZOS_SUCCESS)
+    {
+        return zn_hs_write_reply_status(request, 503);
+    }
+
+    if((param = zn_hs_get_param(request, "offset")) != NULL)
+    {
+        offset = MIN(str_to_uint32(param->value), scan->count);
+    }
+    if((param = zn_hs_get_param(request, "limit")) != NULL)
+    {
+        limit = str_to_uint32(param->value);
+    }
+
+    if(ZOS_FAILED(result, zn_hs_add_reply_header(request, "Cache-Control", "no-cache")))
+    {
+    }
+    else if(ZOS_FAILED(result, zn_hs_write_reply_header(request, "application/json", -1, HTTP_SERVER_HEADER_NONE)))
+    {
+    }
+    else
+    {
+        writer_init_http(&writer, request);
+        writer_str(&writer, "{\"sweeps\":");
+        writer_uint(&writer, scan->sweeps, 0);
+        writer_str(&writer, ",\"scanning\":");
+        writer_str(&writer, (scan->channel != 0) ? "true" : "false");
+        writer_str(&writer, ",\"sweep_time\":");
+        writer_uint(&writer, scan->sweep_time, 0);
+        writer_str(&writer, ",\"total\":");
+        writer_uint(&writer, scan->count, 0);
+        writer_str(&writer, ",\"offset\":");
+        writer_uint(&writer, offset, 0);
+        writer_str(&writer, ",\"records\":[");
+
+        for(uint32_t i = offset; i < scan->count && i - offset < limit; ++i)
+        {
+            const scanner_record_t *record = &scan->records[i];
 
-    ptr += sprintf(ptr, "{\"brightness\":%d,", context->brightness);
-    ptr += sprintf(ptr, "\"blink\":%d,", context->blink_rate);
-    ptr += sprintf(ptr, "\"scroll\":%d,", context->scroll.rate);
-    ptr += sprintf(ptr, "\"msg\":\"");
+            writer_str(&writer, (i > offset) ? ",{\"bssid\":\"" : "{\"bssid\":\"");
+            write_mac(&writer, &record->bssid);
+            writer_str(&writer, "\",\"ssid\":\"");
+            writer_json_data(&writer, record->ssid.value, MIN(record->ssid.len, sizeof(record->ssid.value)));
+            writer_str(&writer, "\",\"type\":");
+            writer_str(&writer, (record->bss_type == ZOS_BSS_TYPE_ADHOC) ? "\"Adhoc\"" : "\"Infra\"");
+            writer_str(&writer, ",\"rssi\":");
+            writer_int(&writer, record->rssi, 0);
+            writer_str(&writer, ",\"rate\":");
+            writer_uint(&writer, record->max_data_rate, 0);
+            writer_str(&writer, ",\"channel\":");
+            writer_uint(&writer, record->channel, 0);
+            writer_str(&writer, ",\"security\":");
+            writer_json_str(&writer, security_name(record->security));
+            writer_str(&writer, ",\"age\":");
+            writer_uint(&writer, now - record->last_seen, 0);
+            writer_char(&writer, '}');
+        }
+        writer_str(&writer, "]}");
 
-    if(ZOS_FAILED(result, zn_hs_write_reply_header(request, "application/json", -1, HTTP_SERVER_HEADER_NONE)))
+        result = writer_finish(&writer);
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+/*
+ * On the event thread: start a sweep if the scan page asked for one, and copy the cache
+ */
+static zos_result_t copy_scan(void *arg)
+{
+    if(scan_page.refresh)
     {
+        scanner_start(NULL);
     }
-    else if(ZOS_FAILED(result, zn_hs_write_chunked_data(request, buffer, ptr - buffer, ZOS_FALSE)))
+    scan_page.copy = *scanner_get_context();
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*
+ * Runtime counters, see stats.c. Add reset=1 to start counting afresh after the reply.
+ * Not counted itself, so polling it does not skew the figures.
+ */
+static zos_result_t retrieve_stats_processor(const http_server_request_t *request, const char *arg)
+{
+    zos_result_t result;
+    writer_t writer;
+    const http_server_param_t *param = zn_hs_get_param(request, "reset");
+
+    if(ZOS_FAILED(result, zn_hs_add_reply_header(request, "Cache-Control", "no-cache")))
     {
     }
-    else if(ZOS_FAILED(result, zn_hs_write_chunked_data(request, context->text, strlen(context->text), ZOS_FALSE)))
+    else if(ZOS_FAILED(result, zn_hs_write_reply_header(request, "application/json", -1, HTTP_SERVER_HEADER_NONE)))
     {
     }
-    else if(ZOS_FAILED(result, zn_hs_write_chunked_data(request, "\"}", 2, ZOS_TRUE)))
+    else
     {
+        writer_init_http(&writer, request);
+        stats_write_json(&writer);
+        result = writer_finish(&writer);
+    }
+
+    if(param != NULL && str_to_uint32(param->value) != 0)
+    {
+        stats_reset();
     }
 
     return result;
 }
 
+/*************************************************************************************************/
+/*
+ * Console: 'stats' prints the runtime counters, 'stats reset' clears them
+ */
+static zos_cmd_result_t stats_command(int argc, char **argv)
+{
+    if(argc == 0)
+    {
+        stats_print();
+    }
+    else if(strcmp(argv[0], "reset") == 0)
+    {
+        stats_reset();
+    }
+    else
+    {
+        return ZOS_CMD_BAD_ARGS;
+    }
+
+    return ZOS_CMD_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*
+ * Console: 'boot' prints when each boot phase started and how long it took
+ */
+static zos_cmd_result_t boot_command(int argc, char **argv)
+{
+    boot_print();
+
+    return ZOS_CMD_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*
+ * Console: 'remote' prints the MQTT remote control's counters, 'remote <host> [port]'
+ * connects to that broker, 'remote off' disconnects
+ */
+static zos_cmd_result_t remote_command(int argc, char **argv)
+{
+    const remote_context_t *context = remote_get_context();
+
+    if(argc == 0)
+    {
+        ZOS_LOG("Remote control %s, topic %s", !context->running ? "off" : context->connected ? "connected" : "connecting",
+                context->command_topic);
+        ZOS_LOG("%lu commands, %lu invalid, %lu statuses, %lu connects, %lu errors, handling mean %luus max %luus",
+                (unsigned long)context->commands, (unsigned long)context->invalid, (unsigned long)context->statuses,
+                (unsigned long)context->connects, (unsigned long)context->errors,
+                (unsigned long)((context->handling.samples > 0) ? context->handling.total_us / context->handling.samples : 0),
+                (unsigned long)context->handling.max_us);
+    }
+    else if(strcmp(argv[0], "off") == 0)
+    {
+        remote_stop();
+    }
+    else if(start_remote(argv[0], (argc > 1) ? str_to_uint32(argv[1]) : MQTT_BROKER_PORT) != ZOS_SUCCESS)
+    {
+        return ZOS_CMD_BAD_ARGS;
+    }
+
+    return ZOS_CMD_SUCCESS;
+}
+
+/*************************************************************************************************/
+static zos_result_t start_remote(const char *host, uint16_t port)
+{
+    zos_result_t result;
+    char mac[32] = {0};
+    remote_config_t config =
+    {
+        .port = port,
+        .apply = apply_update,
+        .write_status = write_remote_status,
+    };
+
+    zn_network_get_mac(mac);
+    strncpy(config.host, host, sizeof(config.host) - 1);
+    sprintf(config.client_id, MQTT_CLIENT_ID, mac[12], mac[13], mac[15], mac[16]);
+
+    if(ZOS_FAILED(result, remote_start(&config)))
+    {
+        ZOS_LOG("Failed to start the remote control: %d", result);
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+static void write_remote_status(writer_t *writer)
+{
+    // The message as held in the snapshot: a streamed one is only sent in part
+    write_state_json(writer, display_get_context(), 0, ZOS_FALSE);
+}
+
+/*************************************************************************************************/
+static const char* state_etag(const display_context_t *context)
+{
+    // The boot nonce and an FNV-1a over the state, recomputed only when the state version moves
+    static char etag[24];
+    static uint32_t etag_version = UINT32_MAX;
+    static uint32_t etag_nonce;
+
+    if(etag_version != context->version || etag_nonce != boot_nonce)
+    {
+        const uint8_t fields[4] = { context->brightness, context->blink_rate, context->scroll_rate & 0xFF, context->scroll_rate >> 8 };
+        uint32_t hash = 2166136261UL;
+
+        for(uint8_t i = 0; i < sizeof(fields); ++i)
+        {
+            hash = (hash ^ fields[i]) * 16777619UL;
+        }
+        for(const char *c = context->text; *c != 0; ++c)
+        {
+            hash = (hash ^ (uint8_t)*c) * 16777619UL;
+        }
+        if(context->file[0] != 0)
+        {
+            // Only the start of a streamed message is in memory, so tell files apart by
+            // the version they were loaded in instead of hashing the whole file
+            for(uint8_t i = 0; i < sizeof(context->modified.text); ++i)
+            {
+                hash = (hash ^ (uint8_t)(context->modified.text >> (i*8))) * 16777619UL;
+            }
+        }
+
+        sprintf(etag, "\"%08lX-%08lx\"", (unsigned long)boot_nonce, (unsigned long)hash);
+        etag_version = context->version;
+        etag_nonce = boot_nonce;
+    }
+
+    return etag;
+}
+
+
+/*************************************************************************************************/
+static zos_result_t write_not_modified_reply(const http_server_request_t *request, const char *etag)
+{
+    zos_result_t result;
+
+    if(!ZOS_FAILED(result, zn_hs_add_reply_header(request, "ETag", etag)))
+    {
+        result = zn_hs_write_reply_status(request, 304);
+    }
+
+    return result;
+}
+
+
+/*************************************************************************************************/
+/*
+ * Reply with the fields of the state snapshot modified after version 'since' (all of them
+ * when 'since' is 0). The ETag and every field come from the same snapshot.
+ */
+static zos_result_t write_state_reply(const http_server_request_t *request, const display_context_t *context, uint32_t since)
+{
+    zos_result_t result;
+    writer_t writer;
+
+    if(ZOS_FAILED(result, zn_hs_add_reply_header(request, "ETag", state_etag(context))))
+    {
+    }
+    else if(ZOS_FAILED(result, zn_hs_add_reply_header(request, "Cache-Control", "no-cache")))
+    {
+    }
+    else if(ZOS_FAILED(result, zn_hs_write_reply_header(request, "application/json", -1, HTTP_SERVER_HEADER_NONE)))
+    {
+    }
+    else
+    {
+        writer_init_http(&writer, request);
+        write_state_json(&writer, context, since, ZOS_TRUE);
+        result = writer_finish(&writer);
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+/*
+ * The state as JSON, only the fields changed since version 'since' unless it is 0. With
+ * 'file_contents', a message streamed from a file is written out whole, rather than the
+ * beginning held in the snapshot.
+ */
+static void write_state_json(writer_t *writer, const display_context_t *context, uint32_t since, zos_bool_t file_contents)
+{
+    const zos_bool_t all = (since == 0);
+
+    writer_str(writer, "{\"version\":\"");
+    writer_hex(writer, boot_nonce, 8);
+    writer_char(writer, '-');
+    writer_uint(writer, context->version, 0);
+    writer_char(writer, '"');
+    if(all || context->modified.brightness > since)
+    {
+        writer_str(writer, ",\"brightness\":");
+        writer_uint(writer, context->brightness, 0);
+    }
+    if(all || context->modified.blink > since)
+    {
+        writer_str(writer, ",\"blink\":");
+        writer_uint(writer, context->blink_rate, 0);
+    }
+    if(all || context->modified.scroll > since)
+    {
+        writer_str(writer, ",\"scroll\":");
+        writer_uint(writer, context->scroll_rate, 0);
+    }
+    if(all || context->modified.text > since)
+    {
+        writer_str(writer, ",\"msg\":\"");
+        if(file_contents && context->file[0] != 0)
+        {
+            write_file_json(writer, context->file);
+        }
+        else
+        {
+            writer_json_data(writer, context->text, strlen(context->text));
+        }
+        writer_char(writer, '"');
+    }
+    writer_char(writer, '}');
+}
+
+/*************************************************************************************************/
+static void write_file_json(writer_t *writer, const char *filename)
+{
+    uint32_t handle;
+
+    if(zn_file_open(filename, &handle) == ZOS_SUCCESS)
+    {
+        char buffer[WRITER_BUFFER_SIZE];
+        uint32_t bytes_read;
+
+        while(zn_file_read(handle, buffer, sizeof(buffer), &bytes_read) == ZOS_SUCCESS && bytes_read > 0)
+        {
+            writer_json_data(writer, buffer, bytes_read);
+        }
+
+        zn_file_close(handle);
+    }
+}
+
 /*************************************************************************************************/
 static void button_pressed_event_handler(void *arg)
 {
+    // Already on the event thread, so the scan starts in this wakeup rather than another one
     ZOS_LOG("USER BUTTON Pressed!");
-    zn_event_issue(scan_event_handler, NULL, EVENT_FLAGS1(RUN_NOW));
+    scan_event_handler(NULL);
 }
 
 /*************************************************************************************************/
 static void scan_event_handler(void *arg)
 {
+    // Show what is already known straight away and refresh it in the background; the
+    // refreshed list is printed when the sweep completes
     zos_result_t ret;
-    zos_scan_result_t *scan_results;
-    const uint32_t start_time = zn_rtos_get_time();
-    int i = 0;
+
+    if(scanner_get_context()->count > 0)
+    {
+        ZOS_LOG("Cached Wi-Fi networks:");
+        print_scan_results();
+    }
 
     ZOS_LOG( "Scanning for Wi-Fi networks ..." );
-    if(ZOS_FAILED(ret, zn_network_scan(&scan_results, 0, NULL)))
+    if(ZOS_FAILED(ret, scanner_start(scan_complete_event_handler)))
     {
         ZOS_LOG("Failed to issue scan: %d", ret);
-        return;
     }
+}
+
+/*************************************************************************************************/
+static void scan_complete_event_handler(void *arg)
+{
+    print_scan_results();
+    ZOS_LOG("Scan complete in %lu milliseconds\r\n", scanner_get_context()->sweep_time);
+}
+
+/*************************************************************************************************/
+static void print_scan_results(void)
+{
+    const scanner_context_t *scan = scanner_get_context();
 
     ZOS_LOG("  # Type  BSSID             RSSI  Rate Chan  Security    SSID" );
     ZOS_LOG("--------------------------------------------------------------------" );
 
-    for(const zos_scan_result_t *result = scan_results; result != NULL; result = result->next, ++i)
+    for(uint8_t i = 0; i < scan->count; ++i)
     {
-        print_scan_result(i, result);
+        print_scan_result(i, &scan->records[i]);
     }
-
-    ZOS_LOG("Scan complete in %lu milliseconds\r\n", zn_rtos_get_time() - start_time);
-    zn_network_scan_destroy_results();
 }
 
 
 /*************************************************************************************************/
-static void print_scan_result(int index, const zos_scan_result_t* record )
+static void print_scan_result(int index, const scanner_record_t* record )
 {
-    char buffer[128], mac[20];
-    fpi_str_buffer_t data_rate_str;
-    char *ptr = buffer;
-    fpi_int_to_str(data_rate_str, record->max_data_rate, 1000.0, 3);
+    writer_t writer;
+    uint16_t column;
 
-    ptr += sprintf(ptr,    " %2d", index);
-    ptr += sprintf(ptr,    " %5s", ( record->bss_type == ZOS_BSS_TYPE_ADHOC ) ? "Adhoc" : "Infra");
-    ptr += sprintf(ptr,     " %s", mac_to_str(&record->BSSID, mac));
-    ptr += sprintf(ptr,   "  %3d", record->signal_strength);
-    ptr += sprintf(ptr,  "  %-5s", data_rate_str);
-    ptr += sprintf(ptr,    " %3d", record->channel);
-    ptr += sprintf(ptr, "  %-10s", ( record->security == ZOS_SECURITY_OPEN )           ? "Open" :
-                                   ( record->security == ZOS_SECURITY_WEP_PSK )        ? "WEP" :
-                                   ( record->security == ZOS_SECURITY_WPA_TKIP_PSK )   ? "WPA TKIP" :
-                                   ( record->security == ZOS_SECURITY_WPA_AES_PSK )    ? "WPA AES" :
-                                   ( record->security == ZOS_SECURITY_WPA2_AES_PSK )   ? "WPA2 AES" :
-                                   ( record->security == ZOS_SECURITY_WPA2_TKIP_PSK )  ? "WPA2 TKIP" :
-                                   ( record->security == ZOS_SECURITY_WPA2_MIXED_PSK ) ? "WPA2 Mixed" :
-                                   "Unknown" );
-    ptr += sprintf(ptr, "  ");
+    writer_init(&writer, NULL, NULL);
 
-    if(record->SSID.len > 0)
+    writer_char(&writer, ' ');
+    writer_int(&writer, index, 2);
+    writer_str(&writer, ( record->bss_type == ZOS_BSS_TYPE_ADHOC ) ? " Adhoc " : " Infra ");
+    write_mac(&writer, &record->bssid);
+    writer_str(&writer, "  ");
+    writer_int(&writer, record->rssi, 3);
+    writer_str(&writer, "  ");
+    column = writer.length;
+    writer_decimal(&writer, record->max_data_rate, 3);
+    writer_pad(&writer, column, 5);
+    writer_char(&writer, ' ');
+    writer_uint(&writer, record->channel, 3);
+    writer_str(&writer, "  ");
+    column = writer.length;
+    writer_str(&writer, security_name(record->security));
+    writer_pad(&writer, column, 10);
+    writer_str(&writer, "  ");
+
+    if(record->ssid.len > 0)
     {
-        ssid_to_str(ptr, &record->SSID);
+        writer_data(&writer, record->ssid.value, MIN(record->ssid.len, sizeof(record->ssid.value)));
     }
     else
     {
-        strcpy(ptr, "<ssid hidden>");
+        writer_str(&writer, "<ssid hidden>");
+    }
+
+    ZOS_LOG("%s", writer_line(&writer));
+}
+
+/*************************************************************************************************/
+static const char* security_name(zos_security_t security)
+{
+    static const struct
+    {
+        zos_security_t security;
+        const char *name;
+    } security_names[] =
+    {
+        { ZOS_SECURITY_OPEN,            "Open" },
+        { ZOS_SECURITY_WEP_PSK,         "WEP" },
+        { ZOS_SECURITY_WPA_TKIP_PSK,    "WPA TKIP" },
+        { ZOS_SECURITY_WPA_AES_PSK,     "WPA AES" },
+        { ZOS_SECURITY_WPA2_AES_PSK,    "WPA2 AES" },
+        { ZOS_SECURITY_WPA2_TKIP_PSK,   "WPA2 TKIP" },
+        { ZOS_SECURITY_WPA2_MIXED_PSK,  "WPA2 Mixed" },
+    };
+
+    // The security values are bit flags in the SDK, not a dense enum, hence the search
+    for(uint8_t i = 0; i < sizeof(security_names)/sizeof(security_names[0]); ++i)
+    {
+        if(security_names[i].security == security)
+        {
+            return security_names[i].name;
+        }
     }
 
-    ZOS_LOG("%s", buffer);
+    return "Unknown";
+}
+
+/*************************************************************************************************/
+static void write_mac(writer_t *writer, const zos_mac_t *mac)
+{
+    for(uint8_t i = 0; i < sizeof(mac->octet); ++i)
+    {
+        if(i > 0)
+        {
+            writer_char(writer, ':');
+        }
+        writer_hex(writer, mac->octet[i], 2);
+    }
 }
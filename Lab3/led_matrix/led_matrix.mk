@@ -1,7 +1,9 @@
 ########################################
 
 # The targets should be defined in a file named: 'project_targets.mk' in the root directory of the project
-PRE_BUILD_TARGETS := 
+# compress_resources and compile_animations generate the build/resources/*.gz and *.anim files
+# listed in resources/manifest.json
+PRE_BUILD_TARGETS := compress_resources compile_animations
 
 # The name of the project component
 NAME := app_external_led_matrix
@@ -25,10 +27,13 @@ $(NAME)_SOURCES := led_matrix.c
 $(NAME)_AUTO_INCLUDE := 
 
 # List of regular expressions to use for excluding source files into the build
-$(NAME)_AUTO_EXCLUDE := 
+# host/ holds the Linux stand-in SDK used by the Makefile benchmarks, never the firmware
+$(NAME)_AUTO_EXCLUDE := host/.*
 
 # List of referenced libraries. This should contain library directory names relative to either the SDK or $(NAME)_LIBRARAY_PATHS
-$(NAME)_COMPONENTS := displays/led_matrix8x8
+# The display is driven directly by display.c/ht16k33.c, so the SDK's displays/led_matrix8x8 is not used
+# The MQTT client is used by the remote control channel (remote.c)
+$(NAME)_COMPONENTS := ZENTRIOS_SDK_ROOT/libraries/cloud/protocols/mqtt
 
 # List of absolute paths to library directories
 $(NAME)_LIBRARAY_PATHS := 
@@ -0,0 +1,286 @@
+/*
+ * Prioritised message playlist, fed from the HTTP server through a single-producer,
+ * single-consumer queue.
+ *
+ * The HTTP server is the only producer: it reserves the next free queue slot, reads the
+ * POSTed message straight into it and publishes it by advancing the head index. The app's
+ * event loop is the only consumer: it moves published messages into the playlist and
+ * releases their slots by advancing the tail index. Each index is written by one side only,
+ * with release ordering so the slot contents are visible before the index that publishes or
+ * frees them, so neither side ever waits on a lock and a burst of submissions is limited
+ * only by the queue size.
+ *
+ * The playlist itself belongs to the event loop. Its entries are shown for their dwell time
+ * each, highest priority first, entries of equal priority in turn. A message of higher
+ * priority than the one on the display interrupts it. Once every entry has used up its
+ * repeats the message shown before the playlist started comes back. Like an animation, the
+ * playlist stops as soon as the display is given new text by anything else.
+ */
+
+#include "zos.h"
+#include "playlist.h"
+#include "stats.h"
+
+
+static struct
+{
+    playlist_message_t slots[PLAYLIST_QUEUE_SIZE];
+    uint32_t head;                          // written by the producer only
+    uint32_t tail;                          // written by the consumer only
+} queue;
+
+static playlist_context_t context;
+static playlist_entry_t entries[PLAYLIST_MAX_ENTRIES];
+static uint32_t next_order;
+static uint32_t text_version;               // display text version set by the playlist
+
+static struct
+{
+    char text[DISPLAY_MAX_TEXT_LENGTH];
+    char file[DISPLAY_MAX_FILENAME];
+} previous;                                 // message to restore when the playlist ends
+
+STATS_EVENT_HANDLER(dwell_event_handler)
+
+
+/*************************************************************************************************/
+/*
+ * Producer: the queue slot for the next message, to be filled in place and then published
+ * with playlist_submit(). Returns NULL when the queue is full.
+ */
+playlist_message_t* playlist_reserve(void)
+{
+    const uint32_t head = queue.head;
+
+    if(head - __atomic_load_n(&queue.tail, __ATOMIC_ACQUIRE) >= PLAYLIST_QUEUE_SIZE)
+    {
+        ++context.rejected;
+        return NULL;
+    }
+
+    return &queue.slots[head % PLAYLIST_QUEUE_SIZE];
+}
+
+/*************************************************************************************************/
+/*
+ * Producer: publish the message filled in the slot returned by playlist_reserve()
+ */
+zos_result_t playlist_submit(void)
+{
+    playlist_message_t *message = &queue.slots[queue.head % PLAYLIST_QUEUE_SIZE];
+
+    message->text[sizeof(message->text) - 1] = 0;
+    message->dwell = MAX(message->dwell, PLAYLIST_MIN_DWELL);
+
+    __atomic_store_n(&queue.head, queue.head + 1, __ATOMIC_RELEASE);
+    ++context.submitted;
+
+    return zn_event_issue(dequeue_event_handler, NULL, 0);
+}
+
+/*************************************************************************************************/
+/*
+ * Empty the playlist and show the message it interrupted again
+ */
+void playlist_clear(void)
+{
+    zn_event_issue(clear_event_handler, NULL, 0);
+}
+
+/*************************************************************************************************/
+/*
+ * Empty the playlist, leaving the display as it is. Called from the event loop.
+ */
+void playlist_stop(void)
+{
+    zn_event_unregister(dwell_event_handler_counted, NULL);
+    context.count = 0;
+    context.current = NULL;
+}
+
+/*************************************************************************************************/
+const playlist_context_t* playlist_get_context(void)
+{
+    return &context;
+}
+
+/*************************************************************************************************/
+static void dequeue_event_handler(void *arg)
+{
+    const uint32_t head = __atomic_load_n(&queue.head, __ATOMIC_ACQUIRE);
+    playlist_entry_t *preempt = NULL;
+
+    stop_if_replaced();
+
+    while(queue.tail != head)
+    {
+        const playlist_message_t *message = &queue.slots[queue.tail % PLAYLIST_QUEUE_SIZE];
+
+        if(context.count < PLAYLIST_MAX_ENTRIES)
+        {
+            playlist_entry_t *entry = &entries[context.count++];
+
+            entry->message = *message;
+            entry->remaining = message->repeat;
+            entry->order = next_order++;
+
+            if(context.current == NULL || message->priority > context.current->message.priority)
+            {
+                if(preempt == NULL || message->priority > preempt->message.priority)
+                {
+                    preempt = entry;
+                }
+            }
+        }
+        else
+        {
+            ++context.dropped;
+        }
+
+        __atomic_store_n(&queue.tail, queue.tail + 1, __ATOMIC_RELEASE);
+    }
+
+    if(preempt != NULL)
+    {
+        if(context.current == NULL)
+        {
+            save_previous();
+        }
+        show(preempt);
+    }
+}
+
+/*************************************************************************************************/
+static void dwell_event_handler(void *arg)
+{
+    playlist_entry_t *entry = context.current;
+
+    if(stop_if_replaced() || entry == NULL)
+    {
+        return;
+    }
+
+    if(entry->message.repeat != 0 && --entry->remaining == 0)
+    {
+        // Keep the playlist packed, arrival order is kept in the entries themselves
+        const uint32_t order = entry->order;
+
+        *entry = entries[--context.count];
+        entry = find_next(order);
+    }
+    else
+    {
+        entry = find_next(entry->order);
+    }
+
+    if(entry != NULL)
+    {
+        show(entry);
+    }
+    else
+    {
+        playlist_stop();
+        restore_previous();
+    }
+}
+
+/*************************************************************************************************/
+static void clear_event_handler(void *arg)
+{
+    if(!stop_if_replaced() && context.current != NULL)
+    {
+        playlist_stop();
+        restore_previous();
+    }
+}
+
+/*************************************************************************************************/
+/*
+ * The entry to show after the one with the given arrival order: the first of the highest
+ * priority entries to have arrived after it, wrapping around to the earliest
+ */
+static playlist_entry_t* find_next(uint32_t order)
+{
+    playlist_entry_t *next = NULL;
+    playlist_entry_t *first = NULL;
+    uint8_t priority = 0;
+
+    for(uint8_t i = 0; i < context.count; ++i)
+    {
+        if(entries[i].message.priority > priority)
+        {
+            priority = entries[i].message.priority;
+        }
+    }
+
+    for(uint8_t i = 0; i < context.count; ++i)
+    {
+        playlist_entry_t *entry = &entries[i];
+
+        if(entry->message.priority != priority)
+        {
+            continue;
+        }
+        if(first == NULL || entry->order < first->order)
+        {
+            first = entry;
+        }
+        if(entry->order > order && (next == NULL || entry->order < next->order))
+        {
+            next = entry;
+        }
+    }
+
+    return (next != NULL) ? next : first;
+}
+
+/*************************************************************************************************/
+static void show(playlist_entry_t *entry)
+{
+    context.current = entry;
+    ++context.shown;
+
+    display_set_text(entry->message.text);
+    text_version = display_get_context()->modified.text;
+
+    // Replaces the running dwell timer, if any
+    zn_event_unregister(dwell_event_handler_counted, NULL);
+    zn_event_register_timed(dwell_event_handler_counted, NULL, entry->message.dwell, 0);
+}
+
+/*************************************************************************************************/
+/*
+ * Returns TRUE, having emptied the playlist, when something else changed the display text
+ */
+static zos_bool_t stop_if_replaced(void)
+{
+    if(context.current != NULL && display_get_context()->modified.text != text_version)
+    {
+        playlist_stop();
+        return ZOS_TRUE;
+    }
+
+    return ZOS_FALSE;
+}
+
+/*************************************************************************************************/
+static void save_previous(void)
+{
+    const display_context_t *display = display_get_context();
+
+    strcpy(previous.text, display->text);
+    strcpy(previous.file, display->file);
+}
+
+/*************************************************************************************************/
+static void restore_previous(void)
+{
+    if(previous.file[0] != 0)
+    {
+        display_set_file(previous.file);
+    }
+    else
+    {
+        display_set_text(previous.text);
+    }
+}
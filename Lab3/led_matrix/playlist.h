@@ -0,0 +1,46 @@
+/*
+ * Prioritised message playlist, fed from the HTTP server through a single-producer,
+ * single-consumer queue.
+ */
+#pragma once
+
+#include "zos.h"
+#include "display.h"
+
+
+#define PLAYLIST_QUEUE_SIZE         8       // messages in flight from the HTTP server, a power of 2
+#define PLAYLIST_MAX_ENTRIES        16
+#define PLAYLIST_DEFAULT_DWELL      10000   // ms
+#define PLAYLIST_MIN_DWELL          250     // ms
+
+typedef struct
+{
+    uint8_t priority;                       // higher priorities are shown first, equal ones take turns
+    uint8_t repeat;                         // times shown before it leaves the playlist, 0 for ever
+    uint32_t dwell;                         // ms on the display each time it is shown
+    char text[DISPLAY_MAX_TEXT_LENGTH];
+} playlist_message_t;
+
+typedef struct
+{
+    playlist_message_t message;
+    uint8_t remaining;                      // times still to be shown when message.repeat isn't 0
+    uint32_t order;                         // arrival order
+} playlist_entry_t;
+
+typedef struct
+{
+    uint8_t count;                          // entries in the playlist
+    playlist_entry_t *current;              // entry on the display, NULL when the playlist isn't running
+    uint32_t submitted;                     // messages queued by the HTTP server
+    uint32_t rejected;                      // messages refused as the queue was full
+    uint32_t dropped;                       // messages dequeued with the playlist full
+    uint32_t shown;                         // times an entry was put on the display
+} playlist_context_t;
+
+
+playlist_message_t* playlist_reserve(void);
+zos_result_t playlist_submit(void);
+void playlist_clear(void);
+void playlist_stop(void);
+const playlist_context_t* playlist_get_context(void);
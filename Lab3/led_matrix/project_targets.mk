@@ -0,0 +1,18 @@
+########################################
+#
+# Pre-build targets for led_matrix, listed in PRE_BUILD_TARGETS in led_matrix.mk
+#
+########################################
+
+LED_MATRIX_DIR := $(dir $(lastword $(MAKEFILE_LIST)))
+PYTHON ?= python3   # the tools need Python 3; override for a differently named interpreter
+
+.PHONY: compress_resources compile_animations
+
+# Minified, gzipped copies of the web resources the manifest flashes from build/resources/
+compress_resources:
+	$(PYTHON) $(LED_MATRIX_DIR)tools/compress_resources.py $(LED_MATRIX_DIR)
+
+# build/resources/*.anim frame files the manifest flashes, compiled from resources/animations/
+compile_animations:
+	$(PYTHON) $(LED_MATRIX_DIR)tools/compile_animations.py $(LED_MATRIX_DIR)
@@ -0,0 +1,373 @@
+/*
+ * Remote control of the display over MQTT.
+ *
+ * The panel subscribes to two command topics: its own, REMOTE_TOPIC_ROOT/<client id>/cmd,
+ * and the fleet's, REMOTE_TOPIC_ROOT/all/cmd, so a single publish to the broker reaches
+ * every panel at once. The broker pushes a command the moment it is published, where over
+ * HTTP every panel would have to be polled or sent a request of its own.
+ *
+ * A command is the query string of /led_matrix/update, percent-encoded the same way:
+ *
+ *   text=Hello%20there&brightness=8&blink=0&scroll=50
+ *
+ * Any mix of the fields, in any order. It is handed to the app as one display_update_t,
+ * the same path the HTTP update pages take, so it is committed, journalled and versioned
+ * alike. A command with an unknown field or a malformed value is refused as a whole. After
+ * every command, refused or empty ones included, the resulting state is published to
+ * REMOTE_TOPIC_ROOT/<client id>/status, and it is also published again on every
+ * (re)connect, so the broker's subscribers learn the panel's state without asking. The
+ * MQTT library has no retained publish, so a controller that subscribes later gets the
+ * next status only: an empty command is how it asks a panel for its state.
+ *
+ * The time from a command arriving to its status being handed to the MQTT library is
+ * counted as 'handling'. It is the panel's share of the push latency only: the network
+ * and the broker add theirs on either side.
+ *
+ * The MQTT library calls back on the app's event thread, as for every other network
+ * receive, so commands are applied straight from the callback. A lost connection is
+ * retried after REMOTE_RECONNECT_TIME, from a one-shot timer so a panel with no broker
+ * does not keep waking up while it waits.
+ */
+
+#include "zos.h"
+#include "remote.h"
+
+
+#define REMOTE_FLEET_TOPIC          REMOTE_TOPIC_ROOT "/" REMOTE_FLEET_ID "/cmd"
+
+
+static remote_context_t context;
+static remote_config_t config;
+static mqtt_connection_t connection;
+
+static struct
+{
+    char data[REMOTE_MAX_STATUS];
+    uint32_t length;
+} status;
+
+STATS_EVENT_HANDLER(reconnect_event_handler)
+
+
+/*************************************************************************************************/
+zos_result_t remote_start(const remote_config_t *remote_config)
+{
+    zos_result_t result;
+
+    remote_stop();
+
+    if(remote_config->host[0] == 0 || remote_config->client_id[0] == 0)
+    {
+        return ZOS_BADARG;
+    }
+
+    config = *remote_config;
+    memset(&context, 0, sizeof(context));
+    sprintf(context.command_topic, "%s/%s/cmd", REMOTE_TOPIC_ROOT, config.client_id);
+    sprintf(context.status_topic, "%s/%s/status", REMOTE_TOPIC_ROOT, config.client_id);
+
+    if(ZOS_FAILED(result, mqtt_init(&connection)))
+    {
+        return result;
+    }
+
+    context.running = ZOS_TRUE;
+    connect_broker();
+
+    // A broker that cannot be reached now is retried in the background
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+void remote_stop(void)
+{
+    if(!context.running)
+    {
+        return;
+    }
+
+    zn_event_unregister(reconnect_event_handler_counted, NULL);
+    if(connection.open)
+    {
+        mqtt_disconnect(&connection);
+    }
+    mqtt_deinit(&connection);
+    context.running = ZOS_FALSE;
+    context.connected = ZOS_FALSE;
+}
+
+/*************************************************************************************************/
+const remote_context_t* remote_get_context(void)
+{
+    return &context;
+}
+
+/*************************************************************************************************/
+static void connect_broker(void)
+{
+    zos_result_t result;
+    mqtt_pkt_connect_t conninfo;
+
+    if(connection.open)
+    {
+        mqtt_disconnect(&connection);
+    }
+
+    memset(&conninfo, 0, sizeof(conninfo));
+    conninfo.mqtt_version = MQTT_PROTOCOL_VER4;
+    conninfo.clean_session = 1;
+    conninfo.client_id = (uint8_t*)config.client_id;
+    conninfo.keep_alive = REMOTE_KEEPALIVE;
+
+    // The outcome of the CONNECT is reported to the callback
+    if(ZOS_FAILED(result, mqtt_open(&connection, config.host, config.port, ZOS_WLAN, connection_event_handler, ZOS_FALSE)) ||
+       ZOS_FAILED(result, mqtt_connect(&connection, &conninfo)))
+    {
+        ZOS_LOG("Failed to connect to MQTT broker %s:%u: %d", config.host, config.port, result);
+        ++context.errors;
+        schedule_reconnect();
+    }
+}
+
+/*************************************************************************************************/
+static void schedule_reconnect(void)
+{
+    if(context.running)
+    {
+        zn_event_register_timed(reconnect_event_handler_counted, NULL, REMOTE_RECONNECT_TIME, 0);
+    }
+}
+
+/*************************************************************************************************/
+static void reconnect_event_handler(void *arg)
+{
+    connect_broker();
+}
+
+/*************************************************************************************************/
+static zos_result_t connection_event_handler(mqtt_event_info_t *event)
+{
+    switch(event->type)
+    {
+        case MQTT_EVENT_TYPE_CONNECTED:
+            ZOS_LOG("Remote control on MQTT topic %s", context.command_topic);
+            context.connected = ZOS_TRUE;
+            ++context.connects;
+            subscribe(context.command_topic);
+            subscribe(REMOTE_FLEET_TOPIC);
+            publish_status();
+            break;
+
+        case MQTT_EVENT_TYPE_DISCONNECTED:
+            ZOS_LOG("Remote control disconnected from MQTT broker");
+            context.connected = ZOS_FALSE;
+            schedule_reconnect();
+            break;
+
+        case MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED:
+            receive_command(&event->data.pub_recvd);
+            break;
+
+        default:
+            break;
+    }
+
+    return ZOS_SUCCESS;
+}
+
+/*************************************************************************************************/
+static void subscribe(const char *topic)
+{
+    if(mqtt_subscribe(&connection, (const uint8_t*)topic, MQTT_QOS_DELIVER_AT_LEAST_ONCE) == 0)
+    {
+        ZOS_LOG("Failed to subscribe to MQTT topic %s", topic);
+        ++context.errors;
+    }
+}
+
+/*************************************************************************************************/
+static void receive_command(const mqtt_topic_msg_t *message)
+{
+    const uint32_t start = stats_time_us();
+    uint32_t elapsed;
+    char command[REMOTE_MAX_COMMAND];
+    display_update_t update = { .flags = 0 };
+
+    if(!topic_is(message, context.command_topic) && !topic_is(message, REMOTE_FLEET_TOPIC))
+    {
+        return;
+    }
+
+    if(message->data_len < sizeof(command))
+    {
+        memcpy(command, message->data, message->data_len);
+        command[message->data_len] = 0;
+    }
+
+    if(message->data_len >= sizeof(command) || !parse_command(command, &update))
+    {
+        ++context.invalid;
+    }
+    else
+    {
+        if(update.flags != 0)
+        {
+            config.apply(&update);
+        }
+        ++context.commands;
+    }
+
+    publish_status();
+
+    elapsed = stats_time_us() - start;
+    ++context.handling.samples;
+    context.handling.total_us += elapsed;
+    context.handling.max_us = MAX(context.handling.max_us, elapsed);
+}
+
+/*************************************************************************************************/
+static zos_bool_t topic_is(const mqtt_topic_msg_t *message, const char *topic)
+{
+    // Received topics are not null terminated
+    return message->topic_len == strlen(topic) && memcmp(message->topic, topic, message->topic_len) == 0;
+}
+
+/*************************************************************************************************/
+/*
+ * Parse 'command' in place into 'update'. Returns FALSE, leaving the update incomplete, if
+ * any of the fields is unknown or malformed.
+ */
+static zos_bool_t parse_command(char *command, display_update_t *update)
+{
+    char *field = command;
+
+    while(*field != 0)
+    {
+        char *next = field + strcspn(field, "&");
+        char *value = strchr(field, '=');
+
+        if(*next != 0)
+        {
+            *next++ = 0;
+        }
+
+        if(value == NULL)
+        {
+            return ZOS_FALSE;
+        }
+        *value++ = 0;
+        percent_decode(value);
+
+        if(strcmp(field, "text") == 0)
+        {
+            update->flags |= DISPLAY_UPDATE_TEXT;
+            update->text = value;
+        }
+        else if(!is_number(value))
+        {
+            return ZOS_FALSE;
+        }
+        else if(strcmp(field, "brightness") == 0)
+        {
+            update->flags |= DISPLAY_UPDATE_BRIGHTNESS;
+            update->brightness = str_to_uint32(value);
+        }
+        else if(strcmp(field, "blink") == 0)
+        {
+            update->flags |= DISPLAY_UPDATE_BLINK;
+            update->blink_rate = str_to_uint32(value);
+        }
+        else if(strcmp(field, "scroll") == 0)
+        {
+            update->flags |= DISPLAY_UPDATE_SCROLL;
+            update->scroll_rate = str_to_uint32(value);
+        }
+        else
+        {
+            return ZOS_FALSE;
+        }
+
+        field = next;
+    }
+
+    return ZOS_TRUE;
+}
+
+/*************************************************************************************************/
+static zos_bool_t is_number(const char *str)
+{
+    const size_t digits = strspn(str, "0123456789");
+
+    return digits > 0 && digits <= 5 && str[digits] == 0;
+}
+
+/*************************************************************************************************/
+static void percent_decode(char *str)
+{
+    char *out = str;
+
+    for(; *str != 0; ++str)
+    {
+        const int8_t high = (*str == '%') ? hex_value(str[1]) : -1;
+        const int8_t low = (high >= 0) ? hex_value(str[2]) : -1;
+
+        if(low >= 0)
+        {
+            *out++ = (char)((high << 4) | low);
+            str += 2;
+        }
+        else
+        {
+            *out++ = (*str == '+') ? ' ' : *str;
+        }
+    }
+    *out = 0;
+}
+
+/*************************************************************************************************/
+static int8_t hex_value(char c)
+{
+    return (c >= '0' && c <= '9') ? c - '0' :
+           (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+           (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+}
+
+/*************************************************************************************************/
+static void publish_status(void)
+{
+    writer_t writer;
+
+    if(!context.connected)
+    {
+        return;
+    }
+
+    status.length = 0;
+    writer_init(&writer, status_flush, NULL);
+    config.write_status(&writer);
+
+    if(writer_finish(&writer) != ZOS_SUCCESS ||
+       mqtt_publish(&connection, (const uint8_t*)context.status_topic, (const uint8_t*)status.data, status.length,
+                    MQTT_QOS_DELIVER_AT_MOST_ONCE) == 0)
+    {
+        ++context.errors;
+    }
+    else
+    {
+        ++context.statuses;
+    }
+}
+
+/*************************************************************************************************/
+static zos_result_t status_flush(void *arg, const char *data, uint32_t length, zos_bool_t is_final)
+{
+    if(status.length + length > sizeof(status.data))
+    {
+        return ZOS_BUFFER_OVERFLOW;
+    }
+
+    memcpy(&status.data[status.length], data, length);
+    status.length += length;
+
+    return ZOS_SUCCESS;
+}
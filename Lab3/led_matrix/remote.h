@@ -0,0 +1,49 @@
+/*
+ * Remote control of the display over MQTT: commands in on a topic, the resulting state out.
+ */
+#pragma once
+
+#include "zos.h"
+#include "mqtt_api.h"
+#include "display.h"
+#include "writer.h"
+#include "stats.h"
+
+
+#define REMOTE_TOPIC_ROOT           "led_matrix"
+#define REMOTE_FLEET_ID             "all"   // commands to REMOTE_TOPIC_ROOT/all/cmd reach every panel
+#define REMOTE_MAX_HOST             64
+#define REMOTE_MAX_CLIENT_ID        32
+#define REMOTE_MAX_TOPIC            (sizeof(REMOTE_TOPIC_ROOT) + REMOTE_MAX_CLIENT_ID + 8)
+#define REMOTE_MAX_COMMAND          (3 * DISPLAY_MAX_TEXT_LENGTH + 64)  // text, possibly percent-encoded, and the rest
+#define REMOTE_MAX_STATUS           (6 * (DISPLAY_MAX_TEXT_LENGTH - 1) + 96)    // every character \u escaped, and the settings
+#define REMOTE_KEEPALIVE            60      // s
+#define REMOTE_RECONNECT_TIME       5000    // ms after a failed or lost connection
+
+typedef struct
+{
+    char host[REMOTE_MAX_HOST];
+    uint16_t port;
+    char client_id[REMOTE_MAX_CLIENT_ID];   // also the panel's topic level, REMOTE_TOPIC_ROOT/<client_id>/cmd
+    void (*apply)(const display_update_t *update);      // applies a command the way the HTTP update pages do
+    void (*write_status)(writer_t *writer);             // the state published after each command
+} remote_config_t;
+
+typedef struct
+{
+    zos_bool_t running;
+    zos_bool_t connected;
+    char command_topic[REMOTE_MAX_TOPIC];
+    char status_topic[REMOTE_MAX_TOPIC];
+    uint32_t connects;                      // connections made to the broker
+    uint32_t commands;                      // commands applied
+    uint32_t invalid;                       // commands refused: too long, unknown field or bad value
+    uint32_t statuses;                      // status messages published
+    uint32_t errors;                        // failed opens, connects, subscribes and publishes
+    stats_timing_t handling;                // on the panel, from a command's arrival to its status being handed to the library
+} remote_context_t;
+
+
+zos_result_t remote_start(const remote_config_t *config);
+void remote_stop(void);
+const remote_context_t* remote_get_context(void);
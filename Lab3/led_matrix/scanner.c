@@ -0,0 +1,180 @@
+/*
+ * Background Wi-Fi scanner with a BSSID keyed result cache.
+ *
+ * zn_network_scan() blocks the event thread for as long as the radio dwells on the
+ * channels it is asked to scan, a couple of seconds for a full sweep. A sweep is therefore
+ * split into one single channel scan per event, with a short gap in between, so scrolling
+ * and HTTP requests keep being serviced while it runs.
+ *
+ * Results are merged into a fixed table that survives between sweeps: an access point
+ * keeps its slot (matched by BSSID) and only has its RSSI, channel and timestamp refreshed.
+ * Entries that go unseen for SCANNER_EXPIRE_TIME are dropped when their channel is next
+ * scanned, and when the table is full the stalest entry is replaced.
+ */
+
+#include "zos.h"
+#include "scanner.h"
+#include "stats.h"
+
+
+#define SCANNER_CHANNEL_GAP         20      // ms of event loop time between channel scans
+#define SCANNER_EXPIRE_TIME         60000   // ms
+
+
+static scanner_context_t context;
+static uint32_t sweep_start;
+static zos_event_handler_t sweep_complete_handler;
+
+STATS_EVENT_HANDLER(scan_channel_event_handler)
+
+
+/*************************************************************************************************/
+zos_result_t scanner_start(zos_event_handler_t complete_handler)
+{
+    zos_result_t result = ZOS_SUCCESS;
+
+    // Joining a sweep that is already running takes over its completion notification, but
+    // only with a handler of its own: a caller that wants none leaves the running one's
+    if(complete_handler != NULL || context.channel == 0)
+    {
+        sweep_complete_handler = complete_handler;
+    }
+
+    if(context.channel == 0)
+    {
+        sweep_start = zn_rtos_get_time();
+        context.channel = 1;
+        if(ZOS_FAILED(result, zn_event_issue(scan_channel_event_handler_counted, NULL, 0)))
+        {
+            context.channel = 0;
+        }
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+void scanner_stop(void)
+{
+    zn_event_unregister(scan_channel_event_handler_counted, NULL);
+    context.channel = 0;
+    sweep_complete_handler = NULL;
+}
+
+/*************************************************************************************************/
+const scanner_context_t* scanner_get_context(void)
+{
+    return &context;
+}
+
+/*************************************************************************************************/
+static void scan_channel_event_handler(void *arg)
+{
+    zos_scan_result_t *results;
+
+    if(context.channel == 0)
+    {
+        return;
+    }
+
+    if(zn_network_scan(&results, context.channel, NULL) == ZOS_SUCCESS)
+    {
+        merge_results(context.channel, results);
+        zn_network_scan_destroy_results();
+    }
+
+    if(++context.channel <= SCANNER_CHANNEL_COUNT)
+    {
+        zn_event_register_timed(scan_channel_event_handler_counted, NULL, SCANNER_CHANNEL_GAP, 0);
+    }
+    else
+    {
+        context.channel = 0;
+        context.sweep_time = zn_rtos_get_time() - sweep_start;
+        ++context.sweeps;
+
+        if(sweep_complete_handler != NULL)
+        {
+            zn_event_issue(sweep_complete_handler, NULL, 0);
+            sweep_complete_handler = NULL;
+        }
+    }
+}
+
+/*************************************************************************************************/
+static void merge_results(uint8_t channel, const zos_scan_result_t *results)
+{
+    const uint32_t now = zn_rtos_get_time();
+    uint8_t kept = 0;
+
+    for(const zos_scan_result_t *result = results; result != NULL; result = result->next)
+    {
+        scanner_record_t *record = find_record(&result->BSSID);
+
+        if(record == NULL)
+        {
+            record = allocate_record();
+            record->bssid = result->BSSID;
+        }
+        record->ssid = result->SSID;
+        record->rssi = result->signal_strength;
+        record->max_data_rate = result->max_data_rate;
+        record->bss_type = result->bss_type;
+        record->security = result->security;
+        record->channel = result->channel;
+        record->last_seen = now;
+    }
+
+    // Drop entries on this channel that have been missing for too long, keeping the order
+    // of the rest so paged readers see a stable list
+    for(uint8_t i = 0; i < context.count; ++i)
+    {
+        const scanner_record_t *record = &context.records[i];
+
+        if(record->channel == channel && now - record->last_seen > SCANNER_EXPIRE_TIME)
+        {
+            continue;
+        }
+        if(kept != i)
+        {
+            context.records[kept] = *record;
+        }
+        ++kept;
+    }
+    context.count = kept;
+}
+
+/*************************************************************************************************/
+static scanner_record_t* find_record(const zos_mac_t *bssid)
+{
+    for(scanner_record_t *record = context.records; record < &context.records[context.count]; ++record)
+    {
+        if(memcmp(&record->bssid, bssid, sizeof(zos_mac_t)) == 0)
+        {
+            return record;
+        }
+    }
+
+    return NULL;
+}
+
+/*************************************************************************************************/
+static scanner_record_t* allocate_record(void)
+{
+    scanner_record_t *stalest = context.records;
+
+    if(context.count < SCANNER_MAX_RECORDS)
+    {
+        return &context.records[context.count++];
+    }
+
+    for(scanner_record_t *record = context.records; record < &context.records[context.count]; ++record)
+    {
+        if((int32_t)(record->last_seen - stalest->last_seen) < 0)
+        {
+            stalest = record;
+        }
+    }
+
+    return stalest;
+}
@@ -0,0 +1,36 @@
+/*
+ * Background Wi-Fi scanner with a BSSID keyed result cache.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+#define SCANNER_MAX_RECORDS         32
+#define SCANNER_CHANNEL_COUNT       13      // 2.4GHz channels swept, 1 to 13 as in the module's full scan
+
+typedef struct
+{
+    zos_mac_t bssid;
+    zos_ssid_t ssid;
+    int16_t rssi;                           // as of last_seen
+    uint32_t max_data_rate;                 // kbps
+    zos_bss_type_t bss_type;
+    zos_security_t security;
+    uint8_t channel;
+    uint32_t last_seen;                     // zn_rtos_get_time() of the last sweep that saw it
+} scanner_record_t;
+
+typedef struct
+{
+    scanner_record_t records[SCANNER_MAX_RECORDS];
+    uint8_t count;
+    uint8_t channel;                        // channel being scanned, 0 when idle
+    uint32_t sweeps;                        // completed sweeps
+    uint32_t sweep_time;                    // ms taken by the last complete sweep
+} scanner_context_t;
+
+
+zos_result_t scanner_start(zos_event_handler_t complete_handler);
+void scanner_stop(void);
+const scanner_context_t* scanner_get_context(void);
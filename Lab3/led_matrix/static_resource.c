@@ -0,0 +1,160 @@
+/*
+ * Pre-compressed static resources served from flash with caching headers.
+ *
+ * The compress_resources build step (project_targets.mk) stores web resources minified and
+ * gzipped, and they are sent as is with Content-Encoding set: the flash read and the radio
+ * both carry the compressed size. The ETag is a hash of the stored file, so it only changes
+ * when a new build flashes a different file, and clients revalidate for an empty 304.
+ *
+ * There is no uncompressed copy to fall back on, so a client whose Accept-Encoding rules
+ * gzip out gets a 406. One that sends no Accept-Encoding at all accepts any coding (RFC
+ * 9110, 12.5.3). Every reply carries Vary: Accept-Encoding, so a cache between the two
+ * never hands a 406 to a client that takes gzip, nor the file to one that does not.
+ */
+
+#include "zos.h"
+#include "static_resource.h"
+
+
+/*************************************************************************************************/
+zos_result_t static_resource_write(const http_server_request_t *request, static_resource_t *resource)
+{
+    zos_result_t result;
+    uint32_t handle;
+    char buffer[256];
+    uint32_t bytes_read;
+    const char *if_none_match;
+
+    if(resource->etag[0] == 0 && ZOS_FAILED(result, compute_etag(resource)))
+    {
+        return zn_hs_write_reply_status(request, 404);
+    }
+
+    if(ZOS_FAILED(result, zn_hs_add_reply_header(request, "Vary", "Accept-Encoding")))
+    {
+        return result;
+    }
+    else if(!accepts_gzip(zn_hs_get_header(request, "Accept-Encoding")))
+    {
+        return zn_hs_write_reply_status(request, 406);
+    }
+
+    if_none_match = zn_hs_get_header(request, "If-None-Match");
+    if(if_none_match != NULL && strcmp(if_none_match, resource->etag) == 0)
+    {
+        if(!ZOS_FAILED(result, zn_hs_add_reply_header(request, "ETag", resource->etag)) &&
+           !ZOS_FAILED(result, zn_hs_add_reply_header(request, "Cache-Control", STATIC_RESOURCE_CACHE_CONTROL)))
+        {
+            result = zn_hs_write_reply_status(request, 304);
+        }
+        return result;
+    }
+
+    if(ZOS_FAILED(result, zn_file_open(resource->filename, &handle)))
+    {
+        return zn_hs_write_reply_status(request, 404);
+    }
+
+    if(ZOS_FAILED(result, zn_hs_add_reply_header(request, "ETag", resource->etag)))
+    {
+    }
+    else if(ZOS_FAILED(result, zn_hs_add_reply_header(request, "Cache-Control", STATIC_RESOURCE_CACHE_CONTROL)))
+    {
+    }
+    else if(ZOS_FAILED(result, zn_hs_add_reply_header(request, "Content-Encoding", "gzip")))
+    {
+    }
+    else if(ZOS_FAILED(result, zn_hs_write_reply_header(request, resource->content_type, -1, HTTP_SERVER_HEADER_NONE)))
+    {
+    }
+    else
+    {
+        while(!ZOS_FAILED(result, zn_file_read(handle, buffer, sizeof(buffer), &bytes_read)) && bytes_read > 0)
+        {
+            if(ZOS_FAILED(result, zn_hs_write_chunked_data(request, buffer, bytes_read, ZOS_FALSE)))
+            {
+                break;
+            }
+        }
+        if(result == ZOS_SUCCESS)
+        {
+            result = zn_hs_write_chunked_data(request, NULL, 0, ZOS_TRUE);
+        }
+    }
+
+    zn_file_close(handle);
+
+    return result;
+}
+
+/*************************************************************************************************/
+/*
+ * Whether an Accept-Encoding header lets gzip through, by name or by '*', and not with q=0
+ */
+static zos_bool_t accepts_gzip(const char *accept_encoding)
+{
+    const char *coding = accept_encoding;
+    int8_t gzip = -1, any = -1;             // -1 not listed, else whether accepted
+
+    if(accept_encoding == NULL)
+    {
+        return ZOS_TRUE;
+    }
+
+    while(*(coding += strspn(coding, " \t,")) != 0)
+    {
+        const size_t length = strcspn(coding, " \t;,");
+        const char *end = coding + strcspn(coding, ",");
+        const char *weight = coding + length;
+        zos_bool_t accepted = ZOS_TRUE;
+
+        // A weight of 0, 0. or 0.000 refuses the coding, any other allows it
+        weight += strspn(weight, " \t;");
+        if(weight < end && (weight[0] == 'q' || weight[0] == 'Q') && weight[1] == '=' && weight[2] == '0')
+        {
+            const char *digits = weight + 3 + strspn(weight + 3, ".0");
+            accepted = (digits < end && strchr(" \t;", *digits) == NULL);
+        }
+
+        if((length == 4 && strncasecmp(coding, "gzip", 4) == 0) || (length == 6 && strncasecmp(coding, "x-gzip", 6) == 0))
+        {
+            gzip = accepted;
+        }
+        else if(length == 1 && coding[0] == '*')
+        {
+            any = accepted;
+        }
+        coding = end;
+    }
+
+    return (gzip >= 0) ? gzip : (any > 0);
+}
+
+/*************************************************************************************************/
+static zos_result_t compute_etag(static_resource_t *resource)
+{
+    zos_result_t result;
+    uint32_t handle;
+    char buffer[256];
+    uint32_t bytes_read;
+    uint32_t hash = 2166136261UL;
+
+    if(ZOS_FAILED(result, zn_file_open(resource->filename, &handle)))
+    {
+        return result;
+    }
+
+    // FNV-1a, the same as the display state ETag
+    while(zn_file_read(handle, buffer, sizeof(buffer), &bytes_read) == ZOS_SUCCESS && bytes_read > 0)
+    {
+        for(uint32_t i = 0; i < bytes_read; ++i)
+        {
+            hash = (hash ^ (uint8_t)buffer[i]) * 16777619UL;
+        }
+    }
+    zn_file_close(handle);
+
+    sprintf(resource->etag, "\"%08lx\"", (unsigned long)hash);
+
+    return ZOS_SUCCESS;
+}
@@ -0,0 +1,19 @@
+/*
+ * Pre-compressed static resources served from flash with caching headers.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+#define STATIC_RESOURCE_CACHE_CONTROL   "max-age=300"   // then revalidated with If-None-Match
+
+typedef struct
+{
+    const char *filename;                   // gzipped file generated by the compress_resources build step
+    const char *content_type;
+    char etag[12];                          // hash of the file, computed on first request
+} static_resource_t;
+
+
+zos_result_t static_resource_write(const http_server_request_t *request, static_resource_t *resource);
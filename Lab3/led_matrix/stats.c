@@ -0,0 +1,537 @@
+/*
+ * Always-on runtime counters: HTTP pages, event handlers, event loop lag, scroll jitter, I2C
+ * and heap.
+ *
+ * Everything is a handful of integer adds per sample, so it stays enabled in production
+ * builds. Durations come from the core's cycle counter (DWT) on the module, the event
+ * loop lag and scroll jitter from zn_rtos_get_time() since they are scheduling delays
+ * measured in whole milliseconds anyway.
+ *
+ * The app is tickless, so nothing here runs on a timer of its own. Every HTTP request and
+ * every counted event handler (STATS_EVENT_HANDLER) is a wakeup, and the time it keeps the
+ * loop busy is what the CPU spends out of its idle state; their sum against the uptime is
+ * the app's duty cycle. Event loop lag is how late the display's timer runs against its
+ * deadline: it is the time any event waits behind whatever the loop is busy with, and is
+ * only sampled while the display has something scheduled.
+ *
+ * Heap usage is a periodic sample, not a high-water mark: it is read on the way out of a
+ * wakeup, at most every STATS_HEAP_PERIOD, as mallinfo() walks the heap and is too slow to
+ * call per allocation, so a peak that comes and goes between two samples is missed. It is
+ * also the C library's heap only; memory the OS hands out from its own pools is not in
+ * it. The stats report it as "max_sampled" along with the period.
+ *
+ * Pages are counted on the HTTP server's thread, everything else on the event thread, so
+ * every update and every read of the counters (and of the cycle counter's state) is made
+ * holding 'lock'. Nothing slow is done with it held: handlers and processors run outside
+ * it, and the reports copy what they print under it and write it out after.
+ */
+
+#include "zos.h"
+#include "stats.h"
+#include <malloc.h>
+#if !defined(__arm__)
+#include <time.h>
+#endif
+
+
+#define STATS_HEAP_PERIOD           100     // ms, at most one heap sample per period
+
+typedef struct
+{
+    uint32_t start_time;                    // ms, when counting last (re)started
+    stats_timing_t event_lag;
+    stats_timing_t scroll_jitter;
+    struct
+    {
+        uint32_t transactions;
+        uint32_t bytes;
+        uint32_t errors;
+        stats_timing_t time;
+    } i2c;
+    struct
+    {
+        uint32_t used;                      // at the last sample
+        uint32_t max_sampled;               // largest sample, peaks between samples are missed
+    } heap;
+} stats_t;
+
+
+static zos_semaphore_t lock;
+static stats_t stats;
+static stats_page_t *pages;
+static stats_event_t *events;
+static uint32_t heap_sample_time;
+static uint32_t scroll_tick_time;
+static uint16_t scroll_tick_period;
+
+#if defined(__arm__)
+#define DEMCR                       (*(volatile uint32_t*)0xE000EDFC)
+#define DEMCR_TRCENA                (1UL << 24)
+#define DWT_CTRL                    (*(volatile uint32_t*)0xE0001000)
+#define DWT_CTRL_CYCCNTENA          (1UL << 0)
+#define DWT_CYCCNT                  (*(volatile uint32_t*)0xE0001004)
+
+#define STATS_CYCLE_SPAN            20000   // ms the cycle counter is trusted to span without wrapping
+
+extern uint32_t SystemCoreClock;
+
+static struct
+{
+    uint32_t last_time;                     // ms, zn_rtos_get_time() at the last call
+    uint32_t last_cycles;
+    uint32_t cycles;                        // not yet converted to whole microseconds
+    uint32_t us;
+} clock;
+#endif
+
+
+/*************************************************************************************************/
+void stats_init(void)
+{
+    zn_rtos_semaphore_init(&lock);
+    zn_rtos_semaphore_set(&lock);
+
+#if defined(__arm__)
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+    clock.last_cycles = DWT_CYCCNT;
+    clock.last_time = zn_rtos_get_time();
+#endif
+
+    stats_reset();
+}
+
+/*************************************************************************************************/
+void stats_deinit(void)
+{
+    // Nothing is scheduled, the counters are only ever fed by the events being counted
+    zn_rtos_semaphore_deinit(&lock);
+}
+
+/*************************************************************************************************/
+void stats_reset(void)
+{
+    lock_stats();
+
+    memset(&stats, 0, sizeof(stats));
+    stats.start_time = zn_rtos_get_time();
+    scroll_tick_period = 0;
+
+    for(stats_page_t *page = pages; page != NULL; page = page->next)
+    {
+        page->requests = 0;
+        page->errors = 0;
+        memset(&page->latency, 0, sizeof(page->latency));
+        memset(page->histogram, 0, sizeof(page->histogram));
+    }
+
+    for(stats_event_t *event = events; event != NULL; event = event->next)
+    {
+        memset(&event->busy, 0, sizeof(event->busy));
+    }
+
+    sample_heap();
+
+    unlock_stats();
+}
+
+/*************************************************************************************************/
+uint32_t stats_time_us(void)
+{
+#if defined(__arm__)
+    // The cycle counter wraps every 2^32 cycles (~43s at 100MHz), so it is folded into a
+    // microsecond count that wraps at 2^32 like any other timestamp. Nothing calls this while
+    // the app idles, so a gap the counter may have wrapped in is bridged in milliseconds.
+    const uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    uint32_t now, time, us;
+
+    lock_stats();
+
+    now = DWT_CYCCNT;
+    time = zn_rtos_get_time();
+
+    if(time - clock.last_time > STATS_CYCLE_SPAN)
+    {
+        clock.us += (time - clock.last_time) * 1000;
+        clock.cycles = 0;
+    }
+    else
+    {
+        clock.cycles += now - clock.last_cycles;
+        clock.us += clock.cycles / cycles_per_us;
+        clock.cycles %= cycles_per_us;
+    }
+    clock.last_cycles = now;
+    clock.last_time = time;
+    us = clock.us;
+
+    unlock_stats();
+
+    return us;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+#endif
+}
+
+/*************************************************************************************************/
+zos_result_t stats_run_processor(stats_page_t *page, http_server_processor_t processor, const http_server_request_t *request, const char *arg)
+{
+    const uint32_t start = stats_time_us();
+    const zos_result_t result = processor(request, arg);
+    const uint32_t elapsed = stats_time_us() - start;
+    uint8_t bucket = 0;
+
+    lock_stats();
+
+    if(page->requests == 0 && !is_page_listed(page))
+    {
+        page->next = pages;
+        pages = page;
+    }
+
+    ++page->requests;
+    if(result != ZOS_SUCCESS)
+    {
+        ++page->errors;
+    }
+    add_timing(&page->latency, elapsed);
+
+    while(bucket < STATS_LATENCY_BUCKETS - 1 && elapsed >= (64UL << bucket))
+    {
+        ++bucket;
+    }
+    ++page->histogram[bucket];
+
+    sample_heap_if_due();
+
+    unlock_stats();
+
+    return result;
+}
+
+/*************************************************************************************************/
+void stats_run_event(stats_event_t *event, zos_event_handler_t handler, void *arg)
+{
+    const uint32_t start = stats_time_us();
+    uint32_t elapsed;
+
+    handler(arg);
+    elapsed = stats_time_us() - start;
+
+    lock_stats();
+
+    add_timing(&event->busy, elapsed);
+
+    if(event->busy.samples == 1 && !is_event_listed(event))
+    {
+        event->next = events;
+        events = event;
+    }
+
+    sample_heap_if_due();
+
+    unlock_stats();
+}
+
+/*************************************************************************************************/
+/*
+ * Record how late a timed event ran, 'due' being the zn_rtos_get_time() it was scheduled for
+ */
+void stats_record_lag(uint32_t due)
+{
+    const int32_t lag = (int32_t)(zn_rtos_get_time() - due);
+
+    lock_stats();
+    add_timing(&stats.event_lag, (lag > 0) ? (uint32_t)lag * 1000 : 0);
+    unlock_stats();
+}
+
+/*************************************************************************************************/
+void stats_record_i2c(uint16_t bytes, uint32_t elapsed_us, zos_result_t result)
+{
+    lock_stats();
+
+    ++stats.i2c.transactions;
+    stats.i2c.bytes += bytes;
+    if(result != ZOS_SUCCESS)
+    {
+        ++stats.i2c.errors;
+    }
+    add_timing(&stats.i2c.time, elapsed_us);
+
+    unlock_stats();
+}
+
+/*************************************************************************************************/
+void stats_record_scroll_tick(uint16_t period_ms)
+{
+    const uint32_t now = zn_rtos_get_time();
+
+    lock_stats();
+
+    // The first tick after a rate change has nothing to be compared against
+    if(period_ms == scroll_tick_period)
+    {
+        const int32_t deviation = (int32_t)(now - scroll_tick_time) - period_ms;
+        add_timing(&stats.scroll_jitter, (uint32_t)((deviation < 0) ? -deviation : deviation) * 1000);
+    }
+
+    scroll_tick_time = now;
+    scroll_tick_period = period_ms;
+
+    unlock_stats();
+}
+
+/*************************************************************************************************/
+void stats_write_json(writer_t *writer)
+{
+    stats_t totals;
+    stats_page_t page;
+    stats_event_t event;
+    const stats_page_t *first_page;
+    const stats_event_t *first_event;
+    uint32_t wakeups, busy_us;
+
+    lock_stats();
+    sample_heap();
+    count_wakeups(&wakeups, &busy_us);
+    totals = stats;
+    first_page = pages;
+    first_event = events;
+    unlock_stats();
+
+    writer_str(writer, "{\"uptime\":");
+    writer_uint(writer, (zn_rtos_get_time() - totals.start_time) / 1000, 0);
+    writer_str(writer, ",\"wakeups\":");
+    writer_uint(writer, wakeups, 0);
+    writer_str(writer, ",\"busy_us\":");
+    writer_uint(writer, busy_us, 0);
+    writer_str(writer, ",\"pages\":[");
+    for(const stats_page_t *listed = first_page; listed != NULL; listed = page.next)
+    {
+        copy_page(&page, listed);
+        writer_str(writer, (listed != first_page) ? ",{\"name\":" : "{\"name\":");
+        writer_json_str(writer, page.name);
+        writer_str(writer, ",\"requests\":");
+        writer_uint(writer, page.requests, 0);
+        writer_str(writer, ",\"errors\":");
+        writer_uint(writer, page.errors, 0);
+        write_timing_json(writer, &page.latency);
+        writer_str(writer, ",\"histogram\":[");
+        for(uint8_t i = 0; i < STATS_LATENCY_BUCKETS; ++i)
+        {
+            if(i > 0)
+            {
+                writer_char(writer, ',');
+            }
+            writer_uint(writer, page.histogram[i], 0);
+        }
+        writer_str(writer, "]}");
+    }
+    writer_str(writer, "],\"events\":[");
+    for(const stats_event_t *listed = first_event; listed != NULL; listed = event.next)
+    {
+        copy_event(&event, listed);
+        writer_str(writer, (listed != first_event) ? ",{\"name\":" : "{\"name\":");
+        writer_json_str(writer, event.name);
+        writer_str(writer, ",\"runs\":");
+        writer_uint(writer, event.busy.samples, 0);
+        write_timing_json(writer, &event.busy);
+        writer_str(writer, ",\"busy_us\":");
+        writer_uint(writer, event.busy.total_us, 0);
+        writer_char(writer, '}');
+    }
+    writer_str(writer, "],\"event_lag\":{\"samples\":");
+    writer_uint(writer, totals.event_lag.samples, 0);
+    write_timing_json(writer, &totals.event_lag);
+    writer_str(writer, "},\"scroll_jitter\":{\"samples\":");
+    writer_uint(writer, totals.scroll_jitter.samples, 0);
+    write_timing_json(writer, &totals.scroll_jitter);
+    writer_str(writer, "},\"i2c\":{\"transactions\":");
+    writer_uint(writer, totals.i2c.transactions, 0);
+    writer_str(writer, ",\"bytes\":");
+    writer_uint(writer, totals.i2c.bytes, 0);
+    writer_str(writer, ",\"errors\":");
+    writer_uint(writer, totals.i2c.errors, 0);
+    write_timing_json(writer, &totals.i2c.time);
+    writer_str(writer, ",\"total_us\":");
+    writer_uint(writer, totals.i2c.time.total_us, 0);
+    writer_str(writer, "},\"heap\":{\"used\":");
+    writer_uint(writer, totals.heap.used, 0);
+    writer_str(writer, ",\"max_sampled\":");
+    writer_uint(writer, totals.heap.max_sampled, 0);
+    writer_str(writer, ",\"sample_period_ms\":");
+    writer_uint(writer, STATS_HEAP_PERIOD, 0);
+    writer_str(writer, "}}");
+}
+
+/*************************************************************************************************/
+void stats_print(void)
+{
+    stats_t totals;
+    stats_page_t page;
+    stats_event_t event;
+    const stats_page_t *first_page;
+    const stats_event_t *first_event;
+    uint32_t wakeups, busy_us;
+
+    lock_stats();
+    sample_heap();
+    count_wakeups(&wakeups, &busy_us);
+    totals = stats;
+    first_page = pages;
+    first_event = events;
+    unlock_stats();
+
+    ZOS_LOG("Uptime %lus, heap %lu bytes used, %lu the most seen in %ums samples", (unsigned long)(zn_rtos_get_time() - totals.start_time) / 1000,
+            (unsigned long)totals.heap.used, (unsigned long)totals.heap.max_sampled, STATS_HEAP_PERIOD);
+    ZOS_LOG("Wakeups %lu, busy %luus", (unsigned long)wakeups, (unsigned long)busy_us);
+    ZOS_LOG("Event loop lag   mean %5luus  max %7luus", timing_mean(&totals.event_lag), (unsigned long)totals.event_lag.max_us);
+    ZOS_LOG("Scroll jitter    mean %5luus  max %7luus", timing_mean(&totals.scroll_jitter), (unsigned long)totals.scroll_jitter.max_us);
+    ZOS_LOG("I2C              mean %5luus  max %7luus  %lu transactions, %lu bytes, %lu errors",
+            timing_mean(&totals.i2c.time), (unsigned long)totals.i2c.time.max_us, (unsigned long)totals.i2c.transactions,
+            (unsigned long)totals.i2c.bytes, (unsigned long)totals.i2c.errors);
+
+    for(const stats_page_t *listed = first_page; listed != NULL; listed = page.next)
+    {
+        copy_page(&page, listed);
+        ZOS_LOG("%-28s mean %5luus  max %7luus  %lu requests, %lu errors", page.name, timing_mean(&page.latency),
+                (unsigned long)page.latency.max_us, (unsigned long)page.requests, (unsigned long)page.errors);
+    }
+
+    for(const stats_event_t *listed = first_event; listed != NULL; listed = event.next)
+    {
+        copy_event(&event, listed);
+        ZOS_LOG("%-28s mean %5luus  max %7luus  %lu runs", event.name, timing_mean(&event.busy),
+                (unsigned long)event.busy.max_us, (unsigned long)event.busy.samples);
+    }
+}
+
+/*************************************************************************************************/
+static void lock_stats(void)
+{
+    zn_rtos_semaphore_get(&lock, ZOS_WAIT_FOREVER);
+}
+
+/*************************************************************************************************/
+static void unlock_stats(void)
+{
+    zn_rtos_semaphore_set(&lock);
+}
+
+/*************************************************************************************************/
+/*
+ * Pages and events are only ever added at the head of their list, so the copy's 'next' is
+ * safe to follow after the lock is let go
+ */
+static void copy_page(stats_page_t *copy, const stats_page_t *page)
+{
+    lock_stats();
+    *copy = *page;
+    unlock_stats();
+}
+
+/*************************************************************************************************/
+static void copy_event(stats_event_t *copy, const stats_event_t *event)
+{
+    lock_stats();
+    *copy = *event;
+    unlock_stats();
+}
+
+/*************************************************************************************************/
+static zos_bool_t is_page_listed(const stats_page_t *page)
+{
+    for(const stats_page_t *listed = pages; listed != NULL; listed = listed->next)
+    {
+        if(listed == page)
+        {
+            return ZOS_TRUE;
+        }
+    }
+
+    return ZOS_FALSE;
+}
+
+/*************************************************************************************************/
+static zos_bool_t is_event_listed(const stats_event_t *event)
+{
+    for(const stats_event_t *listed = events; listed != NULL; listed = listed->next)
+    {
+        if(listed == event)
+        {
+            return ZOS_TRUE;
+        }
+    }
+
+    return ZOS_FALSE;
+}
+
+/*************************************************************************************************/
+static void count_wakeups(uint32_t *wakeups, uint32_t *busy_us)
+{
+    *wakeups = 0;
+    *busy_us = 0;
+
+    for(const stats_page_t *page = pages; page != NULL; page = page->next)
+    {
+        *wakeups += page->requests;
+        *busy_us += page->latency.total_us;
+    }
+
+    for(const stats_event_t *event = events; event != NULL; event = event->next)
+    {
+        *wakeups += event->busy.samples;
+        *busy_us += event->busy.total_us;
+    }
+}
+
+/*************************************************************************************************/
+static void sample_heap_if_due(void)
+{
+    const uint32_t now = zn_rtos_get_time();
+
+    if(now - heap_sample_time >= STATS_HEAP_PERIOD)
+    {
+        heap_sample_time = now;
+        sample_heap();
+    }
+}
+
+/*************************************************************************************************/
+static void sample_heap(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    const struct mallinfo2 info = mallinfo2();
+#else
+    const struct mallinfo info = mallinfo();
+#endif
+
+    stats.heap.used = (uint32_t)info.uordblks;
+    stats.heap.max_sampled = MAX(stats.heap.max_sampled, stats.heap.used);
+}
+
+/*************************************************************************************************/
+static void add_timing(stats_timing_t *timing, uint32_t us)
+{
+    ++timing->samples;
+    timing->total_us += us;
+    timing->max_us = MAX(timing->max_us, us);
+}
+
+/*************************************************************************************************/
+static unsigned long timing_mean(const stats_timing_t *timing)
+{
+    return (timing->samples > 0) ? timing->total_us / timing->samples : 0;
+}
+
+/*************************************************************************************************/
+static void write_timing_json(writer_t *writer, const stats_timing_t *timing)
+{
+    writer_str(writer, ",\"mean_us\":");
+    writer_uint(writer, timing_mean(timing), 0);
+    writer_str(writer, ",\"max_us\":");
+    writer_uint(writer, timing->max_us, 0);
+}
@@ -0,0 +1,73 @@
+/*
+ * Always-on runtime counters: HTTP pages, event handlers, event loop lag, scroll jitter, I2C
+ * and heap.
+ */
+#pragma once
+
+#include "zos.h"
+#include "writer.h"
+
+
+#define STATS_LATENCY_BUCKETS       12      // bucket i counts latencies below 64us << i, the last is open ended
+
+typedef struct
+{
+    uint32_t samples;
+    uint32_t total_us;
+    uint32_t max_us;
+} stats_timing_t;
+
+typedef struct stats_page
+{
+    const char *name;
+    struct stats_page *next;                // linked in on the first request
+    uint32_t requests;
+    uint32_t errors;                        // processor returned something other than ZOS_SUCCESS
+    stats_timing_t latency;
+    uint32_t histogram[STATS_LATENCY_BUCKETS];
+} stats_page_t;
+
+/*
+ * Defines processor##_counted, a drop-in for 'processor' in the dynamic page table that
+ * counts and times every request before handing it over
+ */
+#define STATS_HTTP_PAGE(processor) \
+    static stats_page_t processor##_stats = { #processor }; \
+    static zos_result_t processor##_counted(const http_server_request_t *request, const char *arg) \
+    { \
+        return stats_run_processor(&processor##_stats, processor, request, arg); \
+    }
+
+typedef struct stats_event
+{
+    const char *name;
+    struct stats_event *next;               // linked in on the first run
+    stats_timing_t busy;                    // one sample per run
+} stats_event_t;
+
+/*
+ * Defines handler##_counted, a drop-in for 'handler' wherever it is registered or issued
+ * (and unregistered), that counts every run as a wakeup and times how long it keeps the
+ * loop busy
+ */
+#define STATS_EVENT_HANDLER(handler) \
+    static stats_event_t handler##_stats = { #handler }; \
+    static void handler##_counted(void *arg) \
+    { \
+        stats_run_event(&handler##_stats, handler, arg); \
+    }
+
+
+void stats_init(void);
+void stats_deinit(void);
+void stats_reset(void);
+uint32_t stats_time_us(void);
+
+zos_result_t stats_run_processor(stats_page_t *page, http_server_processor_t processor, const http_server_request_t *request, const char *arg);
+void stats_run_event(stats_event_t *event, zos_event_handler_t handler, void *arg);
+void stats_record_lag(uint32_t due);
+void stats_record_i2c(uint16_t bytes, uint32_t elapsed_us, zos_result_t result);
+void stats_record_scroll_tick(uint16_t period_ms);
+
+void stats_write_json(writer_t *writer);
+void stats_print(void);
@@ -0,0 +1,203 @@
+/*
+ * Raw frame streaming over UDP, for driving the panel from a PC at video rate.
+ *
+ * Each datagram is one frame, little endian:
+ *
+ *   0  'L' 'F'
+ *   2  flags (STREAM_FLAG_*)
+ *   3  reserved, 0
+ *   4  sequence number, incremented by the sender for every frame
+ *   8  one byte per column, bit 0 the top row, left to right across the panels
+ *
+ * Frames go straight to display_draw(), centred or cropped like an animation frame, with no
+ * HTTP parsing on the way. UDP rather than TCP: a lost frame is better skipped than waited
+ * for, as TCP would hold back every newer frame until it is retransmitted.
+ *
+ * Only the newest frame reaches the panel. All datagrams waiting when the receive event
+ * runs are read, and only the one with the highest sequence number is drawn, so a backlog
+ * after a stall is skipped rather than played out late. A frame that is not newer than the
+ * one on the panel (reordered or duplicated on the way) is dropped.
+ *
+ * A stream starts with its first frame and ends after STREAM_IDLE_TIMEOUT without one, when
+ * the message comes back. Like an animation, it gives the panel up as soon as the display
+ * is given new text; frames are then ignored until the sender pauses and starts again.
+ */
+
+#include "zos.h"
+#include "stream.h"
+#include "animation.h"
+#include "stats.h"
+
+
+static stream_context_t context;
+static uint32_t text_version;               // display text version when the stream started
+static uint32_t last_interval;              // ms between the last two frames shown
+static zos_bool_t yielded;                  // new text took the panel back mid-stream
+
+STATS_EVENT_HANDLER(idle_event_handler)
+
+// Datagrams are read alternately into these, the newest one of a batch is kept
+static uint8_t buffers[2][STREAM_HEADER_SIZE + STREAM_MAX_COLUMNS];
+
+
+/*************************************************************************************************/
+zos_result_t stream_start(uint16_t port)
+{
+    zos_result_t result;
+
+    stream_stop();
+
+    if(ZOS_FAILED(result, zn_udp_server(port, &context.handle)))
+    {
+        context.handle = 0;
+    }
+    else if(ZOS_FAILED(result, zn_udp_register_receive_event_handler(context.handle, receive_handler)))
+    {
+        stream_stop();
+    }
+
+    return result;
+}
+
+/*************************************************************************************************/
+void stream_stop(void)
+{
+    zn_event_unregister(idle_event_handler_counted, NULL);
+    if(context.handle != 0)
+    {
+        zn_network_close(context.handle);
+    }
+    memset(&context, 0, sizeof(context));
+    yielded = ZOS_FALSE;
+}
+
+/*************************************************************************************************/
+const stream_context_t* stream_get_context(void)
+{
+    return &context;
+}
+
+/*************************************************************************************************/
+static void receive_handler(uint32_t handle)
+{
+    uint8_t next = 0;
+    int8_t newest = -1;
+    uint32_t newest_length = 0;
+    uint32_t newest_sequence = 0;
+    uint32_t bytes_read;
+
+    while(zn_network_read(handle, buffers[next], sizeof(buffers[next]), &bytes_read) == ZOS_SUCCESS && bytes_read > 0)
+    {
+        const uint8_t *frame = buffers[next];
+        const uint32_t sequence = frame[4] | (frame[5] << 8) | ((uint32_t)frame[6] << 16) | ((uint32_t)frame[7] << 24);
+        const zos_bool_t restart = (frame[2] & STREAM_FLAG_RESTART) != 0;
+
+        if(bytes_read <= STREAM_HEADER_SIZE || frame[0] != 'L' || frame[1] != 'F')
+        {
+            ++context.invalid;
+            continue;
+        }
+
+        // Sequence numbers are compared modulo 2^32, so they can wrap around
+        if(!restart && context.active && (int32_t)(sequence - context.sequence) <= 0)
+        {
+            ++context.late;
+            continue;
+        }
+        if(newest >= 0)
+        {
+            // Either this frame or the newest one so far is never shown
+            ++context.skipped;
+            if(!restart && (int32_t)(sequence - newest_sequence) <= 0)
+            {
+                continue;
+            }
+        }
+
+        newest = next;
+        newest_length = bytes_read;
+        newest_sequence = sequence;
+        next ^= 1;
+    }
+
+    if(newest >= 0)
+    {
+        show(buffers[newest], newest_length, newest_sequence);
+    }
+}
+
+/*************************************************************************************************/
+static void show(const uint8_t *frame, uint32_t length, uint32_t sequence)
+{
+    const uint32_t now = zn_rtos_get_time();
+
+    if(!context.active)
+    {
+        if(yielded)
+        {
+            // The display was given new text mid-stream, wait for the sender to pause
+            ++context.ignored;
+            context.last_frame_time = now;
+            return;
+        }
+
+        animation_stop();
+        text_version = display_get_context()->modified.text;
+        last_interval = 0;
+        context.active = ZOS_TRUE;
+        ++context.sessions;
+        zn_event_register_periodic(idle_event_handler_counted, NULL, STREAM_IDLE_TIMEOUT / 4, 0);
+    }
+    else if(display_get_context()->modified.text != text_version)
+    {
+        context.active = ZOS_FALSE;
+        yielded = ZOS_TRUE;
+        ++context.ignored;
+        context.last_frame_time = now;
+        return;
+    }
+    else
+    {
+        const uint32_t interval = now - context.last_frame_time;
+
+        if(last_interval > 0)
+        {
+            context.max_jitter = MAX(context.max_jitter, (interval > last_interval) ? interval - last_interval : last_interval - interval);
+        }
+        last_interval = interval;
+    }
+
+    context.sequence = sequence;
+    context.last_frame_time = now;
+    ++context.frames;
+
+    display_draw(&frame[STREAM_HEADER_SIZE], MIN(length - STREAM_HEADER_SIZE, STREAM_MAX_COLUMNS));
+}
+
+/*************************************************************************************************/
+static void idle_event_handler(void *arg)
+{
+    const display_context_t *display = display_get_context();
+
+    if(zn_rtos_get_time() - context.last_frame_time < STREAM_IDLE_TIMEOUT)
+    {
+        return;
+    }
+
+    zn_event_unregister(idle_event_handler_counted, NULL);
+    yielded = ZOS_FALSE;
+
+    if(context.active && display->modified.text == text_version)
+    {
+        // Nothing else took the panel back, show the message again
+        if(display->file[0] != 0)
+        {
+            display_set_file(display->file);
+        }
+        else
+        {
+            display_set_text(display->text);
+        }
+    }
+    context.active = ZOS_FALSE;
+}
@@ -0,0 +1,34 @@
+/*
+ * Raw frame streaming over UDP, for driving the panel from a PC at video rate.
+ */
+#pragma once
+
+#include "zos.h"
+#include "display.h"
+
+
+#define STREAM_UDP_PORT             7777
+#define STREAM_HEADER_SIZE          8
+#define STREAM_MAX_COLUMNS          (DISPLAY_MAX_PANELS * DISPLAY_PANEL_WIDTH)
+#define STREAM_IDLE_TIMEOUT         2000    // ms without a frame before the message comes back
+#define STREAM_FLAG_RESTART         (1 << 0)    // accept this frame whatever its sequence number
+
+typedef struct
+{
+    uint32_t handle;                        // UDP server, 0 when stopped
+    zos_bool_t active;                      // frames are on the panel
+    uint32_t sequence;                      // of the frame on the panel
+    uint32_t last_frame_time;               // ms, when it was shown
+    uint32_t max_jitter;                    // ms, largest change between consecutive frame intervals
+    uint32_t frames;                        // frames shown
+    uint32_t late;                          // dropped, not newer than the frame on the panel
+    uint32_t skipped;                       // dropped, a newer frame arrived in the same batch
+    uint32_t ignored;                       // dropped, the display was given new text mid-stream
+    uint32_t invalid;                       // malformed datagrams
+    uint32_t sessions;                      // streams started
+} stream_context_t;
+
+
+zos_result_t stream_start(uint16_t port);
+void stream_stop(void);
+const stream_context_t* stream_get_context(void);
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+"""
+Pre-build step for the led_matrix app (see PRE_BUILD_TARGETS in led_matrix.mk).
+
+Every manifest entry whose local_path is a .anim file under build/resources/ is compiled
+here from resources/animations/<name>.txt or <name>.png into the frame format played back
+by animation.c.
+
+Sources
+-------
+.txt    ASCII art: '#' (or any of '#*@Xx1') is a lit pixel, anything else is dark.
+        Frames are 8 rows each, separated by blank lines. Optional header lines before the
+        first frame: 'fps <n>', 'loop <0|1>'. Lines starting with ';' are comments.
+.png    Sprite sheet: a horizontal strip of 8 pixel high frames. Frames are square unless
+        the file is named <name>.<width>.png. A pixel is lit when its luminance is above
+        half. Plays at 10 fps, looped.
+
+Format (little endian)
+------
+header  'LMA1', u16 width, u8 height, u8 flags (bit 0: loop), u16 frame_count,
+        u16 frame_time (ms), u32 reserved
+frame   u8 type, u16 length, then 'length' bytes of payload:
+        0 key:    the frame's columns (one byte per column, bit 0 the top row), PackBits
+                  compressed: control n < 128 copies n+1 literal bytes, n >= 128 repeats
+                  the next byte n-125 times
+        1 delta:  runs of changed columns against the previous frame: u8 columns skipped
+                  since the end of the last run, u8 count, then 'count' column bytes
+        2 repeat: no payload, the previous frame is shown again
+Each frame is stored in whichever form is smallest; the first frame is always a key frame.
+
+    python3 tools/compile_animations.py [project_dir]
+"""
+
+import json
+import os
+import struct
+import sys
+import zlib
+
+
+GENERATED_DIR = 'build/resources/'
+HEIGHT = 8
+LIT = '#*@Xx1'
+DEFAULT_FPS = 10
+
+FRAME_KEY = 0
+FRAME_DELTA = 1
+FRAME_REPEAT = 2
+
+
+def columns_from_rows(rows, width):
+    """ rows: HEIGHT strings/lists of booleans -> list of column bytes """
+    return [sum(1 << y for y in range(HEIGHT) if rows[y][x]) for x in range(width)]
+
+
+def load_txt(path):
+    fps, loop, frames, rows = DEFAULT_FPS, True, [], []
+
+    def end_frame():
+        if rows:
+            if len(rows) != HEIGHT:
+                raise ValueError('%s: frame %d has %d rows, expected %d' % (path, len(frames), len(rows), HEIGHT))
+            width = max(len(r) for r in rows)
+            frames.append(columns_from_rows([[x < len(r) and r[x] in LIT for x in range(width)] for r in rows], width))
+            del rows[:]
+
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip('\r\n')
+            if line.startswith(';'):
+                continue
+            words = line.split()
+            if not frames and not rows and len(words) == 2 and words[0] in ('fps', 'loop'):
+                if words[0] == 'fps':
+                    fps = int(words[1])
+                else:
+                    loop = words[1] != '0'
+            elif not line.strip():
+                end_frame()
+            else:
+                rows.append(line)
+    end_frame()
+
+    return frames, fps, loop
+
+
+def load_png(path):
+    """ Minimal PNG reader: 8 bit depth, non-interlaced, any colour type """
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError('%s: not a PNG file' % path)
+
+    pos, idat, palette = 8, b'', None
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b'IHDR':
+            width, height, depth, colour, _, _, interlace = struct.unpack('>IIBBBBB', chunk)
+        elif kind == b'PLTE':
+            palette = [chunk[i:i + 3] for i in range(0, len(chunk), 3)]
+        elif kind == b'IDAT':
+            idat += chunk
+    if depth != 8 or interlace != 0:
+        raise ValueError('%s: only 8 bit, non-interlaced PNGs are supported' % path)
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[colour]
+    stride = width * channels
+    raw = zlib.decompress(idat)
+    pixels, prev = [], bytearray(stride)
+    for y in range(height):
+        kind, line = raw[y * (stride + 1)], bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for i in range(stride):
+            a = line[i - channels] if i >= channels else 0
+            b = prev[i]
+            c = prev[i - channels] if i >= channels else 0
+            if kind == 1:
+                line[i] = (line[i] + a) & 0xFF
+            elif kind == 2:
+                line[i] = (line[i] + b) & 0xFF
+            elif kind == 3:
+                line[i] = (line[i] + ((a + b) >> 1)) & 0xFF
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                line[i] = (line[i] + (a if pa <= pb and pa <= pc else b if pb <= pc else c)) & 0xFF
+        prev = line
+        row = []
+        for x in range(width):
+            px = line[x * channels:(x + 1) * channels]
+            if colour == 3:
+                px = palette[px[0]]
+            luma = px[0] if channels <= 2 else (299 * px[0] + 587 * px[1] + 114 * px[2]) // 1000
+            alpha = px[-1] if colour in (4, 6) else 255
+            row.append(luma * alpha // 255 > 127)
+        pixels.append(row)
+
+    if height != HEIGHT:
+        raise ValueError('%s: sheet is %d pixels high, expected %d' % (path, height, HEIGHT))
+    stem = os.path.basename(path)[:-len('.png')]
+    frame_width = int(stem.rsplit('.', 1)[1]) if '.' in stem else HEIGHT
+    if width % frame_width:
+        raise ValueError('%s: width %d is not a multiple of the frame width %d' % (path, width, frame_width))
+
+    frames = [columns_from_rows([r[i:i + frame_width] for r in pixels], frame_width) for i in range(0, width, frame_width)]
+    return frames, DEFAULT_FPS, True
+
+
+def packbits(columns):
+    out, i = bytearray(), 0
+    while i < len(columns):
+        run = 1
+        while i + run < len(columns) and columns[i + run] == columns[i] and run < 130:
+            run += 1
+        if run >= 3:
+            out += bytes((run + 125, columns[i]))
+            i += run
+            continue
+        start = i
+        while i < len(columns) and i - start < 128:
+            if i + 2 < len(columns) and columns[i] == columns[i + 1] == columns[i + 2]:
+                break
+            i += 1
+        out.append(i - start - 1)
+        out += bytes(columns[start:i])
+    return bytes(out)
+
+
+def delta(previous, columns):
+    out, x, end = bytearray(), 0, 0
+    while x < len(columns):
+        if columns[x] == previous[x]:
+            x += 1
+            continue
+        start = x
+        while x < len(columns) and columns[x] != previous[x] and x - start < 255:
+            x += 1
+        skip = start - end
+        while skip > 255:
+            out += bytes((255, 0))
+            skip -= 255
+        out += bytes((skip, x - start)) + bytes(columns[start:x])
+        end = x
+    return bytes(out)
+
+
+def encode(frames, fps, loop):
+    width = len(frames[0])
+    if any(len(f) != width for f in frames) or not 0 < width <= 255:
+        raise ValueError('frames must all be the same width, 1 to 255 columns')
+
+    out = bytearray(struct.pack('<4sHBBHHI', b'LMA1', width, HEIGHT, 1 if loop else 0, len(frames), 1000 // fps, 0))
+    previous = None
+    for columns in frames:
+        if previous is not None and columns == previous:
+            kind, payload = FRAME_REPEAT, b''
+        else:
+            kind, payload = FRAME_KEY, packbits(columns)
+            if previous is not None:
+                changes = delta(previous, columns)
+                if len(changes) < len(payload):
+                    kind, payload = FRAME_DELTA, changes
+        out += struct.pack('<BH', kind, len(payload)) + payload
+        previous = columns
+    return bytes(out)
+
+
+def compile_animation(project_dir, local_path):
+    name = os.path.basename(local_path)[:-len('.anim')]
+    source_dir = os.path.join(project_dir, 'resources', 'animations')
+    candidates = [f for f in sorted(os.listdir(source_dir)) if f == name + '.txt' or (f.startswith(name + '.') and f.endswith('.png'))]
+    if not candidates:
+        raise ValueError('no source for %s in %s' % (local_path, source_dir))
+    source_path = os.path.join(source_dir, candidates[0])
+
+    frames, fps, loop = (load_png if source_path.endswith('.png') else load_txt)(source_path)
+    compiled = encode(frames, fps, loop)
+
+    target_path = os.path.join(project_dir, local_path)
+    if os.path.exists(target_path):
+        with open(target_path, 'rb') as f:
+            if f.read() == compiled:
+                return
+    else:
+        os.makedirs(os.path.dirname(target_path), exist_ok=True)
+
+    with open(target_path, 'wb') as f:
+        f.write(compiled)
+    print('%s: %d frames, %d bytes' % (local_path, len(frames), len(compiled)))
+
+
+def main():
+    project_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+    with open(os.path.join(project_dir, 'resources', 'manifest.json')) as f:
+        manifest = json.load(f)
+
+    for entry in manifest['files']:
+        local_path = entry['local_path']
+        if local_path.startswith(GENERATED_DIR) and local_path.endswith('.anim'):
+            compile_animation(project_dir, local_path)
+
+
+if __name__ == '__main__':
+    main()
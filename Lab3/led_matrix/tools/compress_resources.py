@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""
+Pre-build step for the led_matrix app (see PRE_BUILD_TARGETS in led_matrix.mk).
+
+Every manifest entry whose local_path is a .gz file under build/resources/ is generated
+here from the resource of the same name without .gz, e.g. build/resources/index.html.gz
+from resources/index.html. Text web resources are minified conservatively (comments,
+indentation and blank lines only, so scripts keep their line structure) and then gzipped
+deterministically, so an unchanged resource gives a byte-identical file and the module's
+ETag for it does not change between builds.
+
+    python3 tools/compress_resources.py [project_dir]
+"""
+
+import gzip
+import json
+import os
+import re
+import sys
+
+
+GENERATED_DIR = 'build/resources/'
+MINIFIED_EXTENSIONS = ('.html', '.htm', '.js', '.css')
+
+
+def minify(name, data):
+    if not name.endswith(MINIFIED_EXTENSIONS):
+        return data
+
+    text = data.decode('utf-8')
+    if name.endswith(('.html', '.htm')):
+        text = re.sub(r'<!--(?!\[if).*?-->', '', text, flags=re.DOTALL)
+    if name.endswith('.css'):
+        text = re.sub(r'/\*.*?\*/', '', text, flags=re.DOTALL)
+
+    lines = (line.strip() for line in text.splitlines())
+    return '\n'.join(line for line in lines if line).encode('utf-8')
+
+
+def compress(project_dir, local_path):
+    source_path = os.path.join(project_dir, 'resources', os.path.basename(local_path)[:-len('.gz')])
+    target_path = os.path.join(project_dir, local_path)
+
+    with open(source_path, 'rb') as f:
+        source = f.read()
+    compressed = gzip.compress(minify(source_path, source), compresslevel=9, mtime=0)
+
+    if os.path.exists(target_path):
+        with open(target_path, 'rb') as f:
+            if f.read() == compressed:
+                return
+    else:
+        os.makedirs(os.path.dirname(target_path), exist_ok=True)
+
+    with open(target_path, 'wb') as f:
+        f.write(compressed)
+    print('%s: %d -> %d bytes' % (local_path, len(source), len(compressed)))
+
+
+def main():
+    project_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+    with open(os.path.join(project_dir, 'resources', 'manifest.json')) as f:
+        manifest = json.load(f)
+
+    for entry in manifest['files']:
+        local_path = entry['local_path']
+        if local_path.startswith(GENERATED_DIR) and local_path.endswith('.gz'):
+            compress(project_dir, local_path)
+
+
+if __name__ == '__main__':
+    main()
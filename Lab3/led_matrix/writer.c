@@ -0,0 +1,252 @@
+/*
+ * Buffered text/JSON writer for HTTP replies and console output.
+ *
+ * Values are formatted straight into a small buffer that is handed to the flush callback
+ * (zn_hs_write_chunked_data() for HTTP replies) only when it fills up and once more at the
+ * end, so a typical reply goes out as a single chunk with no format string parsing. Without
+ * a flush callback the buffer holds one bounded line, e.g. for ZOS_LOG().
+ *
+ * The first error (a failed flush, or a full line buffer) is latched and turns every later
+ * call into a no-op, so callers can write a whole reply and check the result once.
+ */
+
+#include "zos.h"
+#include "writer.h"
+
+
+/*************************************************************************************************/
+void writer_init(writer_t *writer, writer_flush_t flush, void *arg)
+{
+    writer->length = 0;
+    writer->result = ZOS_SUCCESS;
+    writer->flush = flush;
+    writer->arg = arg;
+}
+
+/*************************************************************************************************/
+void writer_init_http(writer_t *writer, const http_server_request_t *request)
+{
+    writer_init(writer, http_flush, (void*)request);
+}
+
+/*************************************************************************************************/
+zos_result_t writer_finish(writer_t *writer)
+{
+    if(writer->result == ZOS_SUCCESS && writer->flush != NULL)
+    {
+        writer->result = writer->flush(writer->arg, writer->buffer, writer->length, ZOS_TRUE);
+        writer->length = 0;
+    }
+
+    return writer->result;
+}
+
+/*************************************************************************************************/
+const char* writer_line(writer_t *writer)
+{
+    // Unbuffered writers always leave room for the terminator, see writer_data()
+    writer->buffer[writer->length] = 0;
+    return writer->buffer;
+}
+
+/*************************************************************************************************/
+void writer_char(writer_t *writer, char c)
+{
+    writer_data(writer, &c, 1);
+}
+
+/*************************************************************************************************/
+void writer_data(writer_t *writer, const void *data, uint32_t length)
+{
+    const char *ptr = data;
+    const uint16_t capacity = (writer->flush != NULL) ? WRITER_BUFFER_SIZE : WRITER_BUFFER_SIZE - 1;
+
+    while(length > 0 && writer->result == ZOS_SUCCESS)
+    {
+        uint16_t n = capacity - writer->length;
+
+        if(n == 0)
+        {
+            if(writer->flush == NULL)
+            {
+                writer->result = ZOS_BUFFER_OVERFLOW;
+                break;
+            }
+            writer->result = writer->flush(writer->arg, writer->buffer, writer->length, ZOS_FALSE);
+            writer->length = 0;
+            continue;
+        }
+
+        n = MIN(n, length);
+        memcpy(&writer->buffer[writer->length], ptr, n);
+        writer->length += n;
+        ptr += n;
+        length -= n;
+    }
+}
+
+/*************************************************************************************************/
+void writer_str(writer_t *writer, const char *str)
+{
+    writer_data(writer, str, strlen(str));
+}
+
+/*************************************************************************************************/
+void writer_uint(writer_t *writer, uint32_t value, uint8_t width)
+{
+    // Right aligned in 'width' characters, 0 for no padding
+    char digits[10];
+    char *ptr = &digits[sizeof(digits)];
+
+    do
+    {
+        *--ptr = '0' + (value % 10);
+        value /= 10;
+    } while(value > 0);
+
+    write_spaces(writer, width - (&digits[sizeof(digits)] - ptr));
+    writer_data(writer, ptr, &digits[sizeof(digits)] - ptr);
+}
+
+/*************************************************************************************************/
+void writer_int(writer_t *writer, int32_t value, uint8_t width)
+{
+    if(value < 0)
+    {
+        const uint32_t magnitude = (uint32_t)0 - (uint32_t)value;
+        uint8_t digits = 1;
+
+        for(uint32_t v = magnitude; v >= 10; v /= 10)
+        {
+            ++digits;
+        }
+        write_spaces(writer, width - (digits + 1));
+        writer_char(writer, '-');
+        writer_uint(writer, magnitude, 0);
+    }
+    else
+    {
+        writer_uint(writer, (uint32_t)value, width);
+    }
+}
+
+/*************************************************************************************************/
+void writer_decimal(writer_t *writer, uint32_t value, uint8_t decimals)
+{
+    // value / 10^decimals with exactly 'decimals' fractional digits, e.g. 54000,3 -> "54.000"
+    uint32_t scale = 1;
+
+    for(uint8_t i = 0; i < decimals; ++i)
+    {
+        scale *= 10;
+    }
+
+    writer_uint(writer, value / scale, 0);
+    if(decimals > 0)
+    {
+        uint32_t fraction = value % scale;
+
+        writer_char(writer, '.');
+        for(scale /= 10; scale > 0; scale /= 10)
+        {
+            writer_char(writer, '0' + (fraction / scale));
+            fraction %= scale;
+        }
+    }
+}
+
+/*************************************************************************************************/
+void writer_hex(writer_t *writer, uint32_t value, uint8_t digits)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    while(digits-- > 0)
+    {
+        writer_char(writer, hex[(value >> (digits * 4)) & 0xF]);
+    }
+}
+
+/*************************************************************************************************/
+void writer_pad(writer_t *writer, uint16_t start, uint8_t width)
+{
+    // Left aligns whatever was written since writer->length was 'start'. Only meaningful
+    // while nothing has been flushed in between, i.e. within a line
+    if(writer->length >= start)
+    {
+        write_spaces(writer, width - (int)(writer->length - start));
+    }
+}
+
+/*************************************************************************************************/
+void writer_json_data(writer_t *writer, const void *data, uint32_t length)
+{
+    // Escapes byte by byte, so a string can be written in pieces (e.g. as read from a file).
+    // Bytes above 0x7F are passed through untouched, which keeps UTF-8 intact
+    const uint8_t *ptr = data;
+    const uint8_t *end = ptr + length;
+
+    while(ptr < end)
+    {
+        const uint8_t *run = ptr;
+
+        while(ptr < end && *ptr >= 0x20 && *ptr != '"' && *ptr != '\\')
+        {
+            ++ptr;
+        }
+        writer_data(writer, run, ptr - run);
+
+        if(ptr < end)
+        {
+            const uint8_t c = *ptr++;
+
+            writer_char(writer, '\\');
+            switch(c)
+            {
+            case '"':
+            case '\\':
+                writer_char(writer, c);
+                break;
+            case '\n':
+                writer_char(writer, 'n');
+                break;
+            case '\r':
+                writer_char(writer, 'r');
+                break;
+            case '\t':
+                writer_char(writer, 't');
+                break;
+            default:
+                writer_str(writer, "u00");
+                writer_hex(writer, c, 2);
+                break;
+            }
+        }
+    }
+}
+
+/*************************************************************************************************/
+void writer_json_str(writer_t *writer, const char *str)
+{
+    writer_char(writer, '"');
+    writer_json_data(writer, str, strlen(str));
+    writer_char(writer, '"');
+}
+
+/*************************************************************************************************/
+static void write_spaces(writer_t *writer, int count)
+{
+    static const char spaces[] = "                ";
+
+    while(count > 0)
+    {
+        const int n = MIN(count, (int)sizeof(spaces) - 1);
+        writer_data(writer, spaces, n);
+        count -= n;
+    }
+}
+
+/*************************************************************************************************/
+static zos_result_t http_flush(void *arg, const char *data, uint32_t length, zos_bool_t is_final)
+{
+    return zn_hs_write_chunked_data((const http_server_request_t*)arg, data, length, is_final);
+}
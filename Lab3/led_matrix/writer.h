@@ -0,0 +1,39 @@
+/*
+ * Buffered text/JSON writer for HTTP replies and console output.
+ */
+#pragma once
+
+#include "zos.h"
+
+
+#define WRITER_BUFFER_SIZE      128
+
+// Called with a full buffer, and once with is_final set by writer_finish()
+typedef zos_result_t (*writer_flush_t)(void *arg, const char *data, uint32_t length, zos_bool_t is_final);
+
+typedef struct
+{
+    char buffer[WRITER_BUFFER_SIZE];
+    uint16_t length;
+    zos_result_t result;                    // first error, every call after it is a no-op
+    writer_flush_t flush;                   // NULL to write into buffer only, see writer_line()
+    void *arg;
+} writer_t;
+
+
+void writer_init(writer_t *writer, writer_flush_t flush, void *arg);
+void writer_init_http(writer_t *writer, const http_server_request_t *request);
+zos_result_t writer_finish(writer_t *writer);
+const char* writer_line(writer_t *writer);
+
+void writer_char(writer_t *writer, char c);
+void writer_data(writer_t *writer, const void *data, uint32_t length);
+void writer_str(writer_t *writer, const char *str);
+void writer_uint(writer_t *writer, uint32_t value, uint8_t width);
+void writer_int(writer_t *writer, int32_t value, uint8_t width);
+void writer_decimal(writer_t *writer, uint32_t value, uint8_t decimals);
+void writer_hex(writer_t *writer, uint32_t value, uint8_t digits);
+void writer_pad(writer_t *writer, uint16_t start, uint8_t width);
+
+void writer_json_data(writer_t *writer, const void *data, uint32_t length);
+void writer_json_str(writer_t *writer, const char *str);